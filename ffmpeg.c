@@ -123,8 +123,6 @@ static int64_t getutime(void);
 static int64_t getmaxrss(void);
 
 static int run_as_daemon  = 0;
-static int nb_frames_dup = 0;
-static int nb_frames_drop = 0;
 static int64_t decode_error_stat[2];
 
 static int current_time;
@@ -160,6 +158,41 @@ static int restore_tty;
 #endif
 
 static void free_input_threads(void);
+static void free_output_threads(int drop);
+
+#if HAVE_PTHREADS
+/* Protects the state of the outputs shared between the main thread and the
+ * output threads: OutputStream.finished, frame_number and the other fields
+ * used while encoding and muxing, OutputFile.recording_time and the muxer
+ * contexts. Output threads hold it while processing a frame, except during
+ * the call to the encoder. */
+static pthread_mutex_t output_lock;
+static int output_lock_active;
+static pthread_t main_thread;
+static int main_thread_has_output_lock; /* only accessed by the main thread */
+#endif
+
+static void lock_output(void)
+{
+#if HAVE_PTHREADS
+    if (output_lock_active) {
+        pthread_mutex_lock(&output_lock);
+        if (pthread_equal(pthread_self(), main_thread))
+            main_thread_has_output_lock = 1;
+    }
+#endif
+}
+
+static void unlock_output(void)
+{
+#if HAVE_PTHREADS
+    if (output_lock_active) {
+        if (pthread_equal(pthread_self(), main_thread))
+            main_thread_has_output_lock = 0;
+        pthread_mutex_unlock(&output_lock);
+    }
+#endif
+}
 
 
 /* sub2video hack:
@@ -432,6 +465,10 @@ static void ffmpeg_cleanup(int ret)
 {
     int i, j;
 
+#if HAVE_PTHREADS
+    free_output_threads(1);
+#endif
+
     if (do_benchmark) {
         int maxrss = getmaxrss() / 1024;
         printf("bench: maxrss=%ikB\n", maxrss);
@@ -563,6 +600,23 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+/**
+ * Abort after a fatal error while encoding or muxing ost. In the output
+ * thread of ost, the error is only recorded: the thread drops the remaining
+ * frames and the main thread exits when it notices the error, as exiting
+ * would free everything the other threads are still using.
+ */
+static void exit_output_stream(OutputStream *ost)
+{
+#if HAVE_PTHREADS
+    if (ost->enc_fifo && pthread_equal(pthread_self(), ost->enc_thread)) {
+        ost->enc_thread_error = 1;
+        return;
+    }
+#endif
+    exit_program(1);
+}
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
 {
     AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
@@ -609,15 +663,21 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
             av_free_packet(pkt);
             new_pkt.buf = av_buffer_create(new_pkt.data, new_pkt.size,
                                            av_buffer_default_free, NULL, 0);
-            if (!new_pkt.buf)
-                exit_program(1);
+            if (!new_pkt.buf) {
+                exit_output_stream(ost);
+                av_free(new_pkt.data);
+                return;
+            }
         } else if (a < 0) {
             av_log(NULL, AV_LOG_ERROR, "Failed to open bitstream filter %s for stream %d with codec %s",
                    bsfc->filter->name, pkt->stream_index,
                    avctx->codec ? avctx->codec->name : "copy");
             print_error("", a);
-            if (exit_on_error)
-                exit_program(1);
+            if (exit_on_error) {
+                exit_output_stream(ost);
+                av_free_packet(pkt);
+                return;
+            }
         }
         *pkt = new_pkt;
 
@@ -636,7 +696,9 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, OutputStream *ost)
                ost->file_index, ost->st->index, ost->last_mux_dts, pkt->dts);
         if (exit_on_error) {
             av_log(NULL, AV_LOG_FATAL, "aborting.\n");
-            exit_program(1);
+            exit_output_stream(ost);
+            av_free_packet(pkt);
+            return;
         }
         av_log(s, loglevel, "changing to %"PRId64". This may result "
                "in incorrect timestamps in the output file.\n",
@@ -696,12 +758,26 @@ static int check_recording_time(OutputStream *ost)
     return 1;
 }
 
+/* Copy the encoder statistics shown by print_report() while the encoder
+ * belongs to the output thread of ost. */
+static void save_coded_frame_stats(OutputStream *ost)
+{
+#if HAVE_PTHREADS
+    AVCodecContext *enc = ost->st->codec;
+
+    if (ost->enc_fifo && enc->coded_frame) {
+        ost->coded_quality = enc->coded_frame->quality;
+        memcpy(ost->coded_error, enc->coded_frame->error, sizeof(ost->coded_error));
+    }
+#endif
+}
+
 static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                          AVFrame *frame)
 {
     AVCodecContext *enc = ost->st->codec;
     AVPacket pkt;
-    int got_packet = 0;
+    int got_packet = 0, ret;
 
     av_init_packet(&pkt);
     pkt.data = NULL;
@@ -725,10 +801,15 @@ static void do_audio_out(AVFormatContext *s, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
-    if (avcodec_encode_audio2(enc, &pkt, frame, &got_packet) < 0) {
+    unlock_output();
+    ret = avcodec_encode_audio2(enc, &pkt, frame, &got_packet);
+    lock_output();
+    if (ret < 0) {
         av_log(NULL, AV_LOG_FATAL, "Audio encoding failed (avcodec_encode_audio2)\n");
-        exit_program(1);
+        exit_output_stream(ost);
+        return;
     }
+    save_coded_frame_stats(ost);
     update_benchmark("encode_audio %d.%d", ost->file_index, ost->index);
 
     if (got_packet) {
@@ -897,7 +978,7 @@ static void do_video_out(AVFormatContext *s,
 
     nb_frames = FFMIN(nb_frames, ost->max_frames - ost->frame_number);
     if (nb_frames == 0) {
-        nb_frames_drop++;
+        ost->frames_drop++;
         av_log(NULL, AV_LOG_VERBOSE,
                "*** dropping frame %d from stream %d at ts %"PRId64"\n",
                ost->frame_number, ost->st->index, in_picture->pts);
@@ -905,10 +986,10 @@ static void do_video_out(AVFormatContext *s,
     } else if (nb_frames > 1) {
         if (nb_frames > dts_error_threshold * 30) {
             av_log(NULL, AV_LOG_ERROR, "%d frame duplication too large, skipping\n", nb_frames - 1);
-            nb_frames_drop++;
+            ost->frames_drop++;
             return;
         }
-        nb_frames_dup += nb_frames - 1;
+        ost->frames_dup += nb_frames - 1;
         av_log(NULL, AV_LOG_VERBOSE, "*** %d dup!\n", nb_frames - 1);
     }
 
@@ -1009,12 +1090,16 @@ static void do_video_out(AVFormatContext *s,
 
         ost->frames_encoded++;
 
+        unlock_output();
         ret = avcodec_encode_video2(enc, &pkt, in_picture, &got_packet);
+        lock_output();
         update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Video encoding failed\n");
-            exit_program(1);
+            exit_output_stream(ost);
+            return;
         }
+        save_coded_frame_stats(ost);
 
         if (got_packet) {
             if (debug_ts) {
@@ -1102,6 +1187,239 @@ static void do_video_stats(OutputStream *ost, int frame_size)
     }
 }
 
+/**
+ * Encode and mux a frame coming out of the filtergraph feeding ost, with its
+ * pts already in the encoder time base.
+ * Called from the main thread, or from the output thread of ost when
+ * -output_threads is enabled. The latter must not access the filtergraph,
+ * which the main thread can reconfigure at any time.
+ */
+static void do_filtered_frame_out(OutputStream *ost, AVFrame *filtered_frame)
+{
+    OutputFile    *of = output_files[ost->file_index];
+    AVCodecContext *enc = ost->st->codec;
+
+    switch (enc->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        if (!ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s time_base:%d/%d\n",
+                    av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
+                    enc->time_base.num, enc->time_base.den);
+        }
+
+        do_video_out(of->ctx, ost, filtered_frame);
+        break;
+    case AVMEDIA_TYPE_AUDIO:
+        if (!(enc->codec->capabilities & CODEC_CAP_PARAM_CHANGE) &&
+            enc->channels != av_frame_get_channels(filtered_frame)) {
+            av_log(NULL, AV_LOG_ERROR,
+                   "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
+            break;
+        }
+        do_audio_out(of->ctx, ost, filtered_frame);
+        break;
+    default:
+        // TODO support subtitle filters
+        av_assert0(0);
+    }
+}
+
+#if HAVE_PTHREADS
+static void *output_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVFrame *frame;
+    int drop;
+
+    while (1) {
+        pthread_mutex_lock(&ost->enc_lock);
+        while (!av_fifo_size(ost->enc_fifo) && !ost->enc_thread_eof)
+            pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+        if (!av_fifo_size(ost->enc_fifo)) {
+            pthread_mutex_unlock(&ost->enc_lock);
+            break;
+        }
+        av_fifo_generic_read(ost->enc_fifo, &frame, sizeof(frame), NULL);
+        drop = ost->enc_thread_abort;
+        ost->enc_thread_busy = 1;
+        pthread_cond_signal(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+
+        /* the main thread may have closed the stream while this frame was
+         * queued, e.g. on filtergraph EOF, so only skip it if nothing more
+         * can be written */
+        lock_output();
+        if (!drop && !ost->enc_thread_error &&
+            !(ost->finished & MUXER_FINISHED) && ost->frame_number < ost->max_frames)
+            do_filtered_frame_out(ost, frame);
+        unlock_output();
+        av_frame_free(&frame);
+
+        pthread_mutex_lock(&ost->enc_lock);
+        ost->enc_thread_busy = 0;
+        pthread_cond_signal(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+    }
+
+    return NULL;
+}
+
+/* Pass the frame to the output thread of ost, blocking while its queue is
+ * full. The reference is moved, leaving frame blank on success. */
+static int send_to_output_thread(OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *queued = av_frame_alloc();
+
+    if (!queued)
+        return AVERROR(ENOMEM);
+    av_frame_move_ref(queued, frame);
+
+    pthread_mutex_lock(&ost->enc_lock);
+    while (!av_fifo_space(ost->enc_fifo))
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    av_fifo_generic_write(ost->enc_fifo, &queued, sizeof(queued), NULL);
+    pthread_cond_signal(&ost->enc_cond);
+    pthread_mutex_unlock(&ost->enc_lock);
+
+    return 0;
+}
+
+/* Wait until the output thread of ost has processed all the queued frames. */
+static void wait_output_thread(OutputStream *ost)
+{
+    pthread_mutex_lock(&ost->enc_lock);
+    while (av_fifo_size(ost->enc_fifo) || ost->enc_thread_busy)
+        pthread_cond_wait(&ost->enc_cond, &ost->enc_lock);
+    pthread_mutex_unlock(&ost->enc_lock);
+}
+
+/**
+ * Join the output threads, after letting them encode all queued frames, or
+ * dropping these frames if drop is set.
+ */
+static void free_output_threads(int drop)
+{
+    int i;
+
+    if (!output_lock_active)
+        return;
+
+    /* exit_program() may be called while the main thread holds the lock */
+    if (main_thread_has_output_lock)
+        unlock_output();
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->enc_fifo)
+            continue;
+
+        pthread_mutex_lock(&ost->enc_lock);
+        ost->enc_thread_eof   = 1;
+        ost->enc_thread_abort = drop;
+        pthread_cond_signal(&ost->enc_cond);
+        pthread_mutex_unlock(&ost->enc_lock);
+    }
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+        AVFrame *frame;
+
+        if (!ost->enc_fifo)
+            continue;
+
+        pthread_join(ost->enc_thread, NULL);
+
+        while (av_fifo_size(ost->enc_fifo)) {
+            av_fifo_generic_read(ost->enc_fifo, &frame, sizeof(frame), NULL);
+            av_frame_free(&frame);
+        }
+        av_fifo_free(ost->enc_fifo);
+        ost->enc_fifo = NULL;
+        pthread_mutex_destroy(&ost->enc_lock);
+        pthread_cond_destroy(&ost->enc_cond);
+    }
+
+    pthread_mutex_destroy(&output_lock);
+    output_lock_active = 0;
+}
+
+/* Return 1 if an output thread failed, after which the main thread must
+ * exit. */
+static int output_thread_failed(void)
+{
+    int i, failed = 0;
+
+    lock_output();
+    for (i = 0; i < nb_output_streams; i++)
+        failed |= output_streams[i]->enc_thread_error;
+    unlock_output();
+
+    return failed;
+}
+
+static int init_output_threads(void)
+{
+    int i, ret;
+
+    if (!output_threads)
+        return 0;
+
+    if (vstats_filename || do_benchmark_all) {
+        av_log(NULL, AV_LOG_WARNING, "-output_threads is not compatible with "
+               "-vstats and -benchmark_all, disabling it.\n");
+        output_threads = 0;
+        return 0;
+    }
+
+    if ((ret = pthread_mutex_init(&output_lock, NULL)))
+        return AVERROR(ret);
+    main_thread        = pthread_self();
+    output_lock_active = 1;
+
+    for (i = 0; i < nb_output_streams; i++) {
+        OutputStream *ost = output_streams[i];
+
+        if (!ost->filter)
+            continue;
+
+        if (!(ost->enc_fifo = av_fifo_alloc(8 * sizeof(AVFrame*))))
+            return AVERROR(ENOMEM);
+
+        pthread_mutex_init(&ost->enc_lock, NULL);
+        pthread_cond_init (&ost->enc_cond, NULL);
+
+        if ((ret = pthread_create(&ost->enc_thread, NULL, output_thread, ost))) {
+            av_fifo_free(ost->enc_fifo);
+            ost->enc_fifo = NULL;
+            pthread_mutex_destroy(&ost->enc_lock);
+            pthread_cond_destroy(&ost->enc_cond);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+#endif
+
+/**
+ * Close ost from the main thread. The frames already queued for the output
+ * thread of ost are processed first, so that -shortest cuts the other
+ * streams at the same point as without output threads.
+ */
+static void finish_output_stream(OutputStream *ost)
+{
+#if HAVE_PTHREADS
+    if (ost->enc_fifo)
+        wait_output_thread(ost);
+#endif
+    lock_output();
+    close_output_stream(ost);
+    unlock_output();
+}
+
 /**
  * Get and encode new output from any of the filtergraphs, without causing
  * activity.
@@ -1112,15 +1430,14 @@ static int reap_filters(void)
 {
     AVFrame *filtered_frame = NULL;
     int i;
-    int64_t frame_pts;
 
     /* Reap all buffers present in the buffer sinks */
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
         OutputFile    *of = output_files[ost->file_index];
-        AVFilterContext *filter;
         AVCodecContext *enc = ost->st->codec;
-        int ret = 0;
+        AVFilterContext *filter;
+        int ret = 0, finished;
 
         if (!ost->filter)
             continue;
@@ -1141,53 +1458,39 @@ static int reap_filters(void)
                 }
                 break;
             }
-            if (ost->finished) {
+            lock_output();
+            finished = ost->finished;
+            unlock_output();
+            if (finished) {
                 av_frame_unref(filtered_frame);
                 continue;
             }
-            frame_pts = AV_NOPTS_VALUE;
             if (filtered_frame->pts != AV_NOPTS_VALUE) {
                 int64_t start_time = (of->start_time == AV_NOPTS_VALUE) ? 0 : of->start_time;
-                filtered_frame->pts = frame_pts =
+                filtered_frame->pts =
                     av_rescale_q(filtered_frame->pts, filter->inputs[0]->time_base, enc->time_base) -
                     av_rescale_q(start_time, AV_TIME_BASE_Q, enc->time_base);
             }
             //if (ost->source_index >= 0)
             //    *filtered_frame= *input_streams[ost->source_index]->decoded_frame; //for me_threshold
 
-            switch (filter->inputs[0]->type) {
-            case AVMEDIA_TYPE_VIDEO:
-                filtered_frame->pts = frame_pts;
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
-                if (debug_ts) {
-                    av_log(NULL, AV_LOG_INFO, "filter -> pts:%s pts_time:%s time_base:%d/%d\n",
-                            av_ts2str(filtered_frame->pts), av_ts2timestr(filtered_frame->pts, &enc->time_base),
-                            enc->time_base.num, enc->time_base.den);
-                }
-
-                do_video_out(of->ctx, ost, filtered_frame);
-                break;
-            case AVMEDIA_TYPE_AUDIO:
-                filtered_frame->pts = frame_pts;
-                if (!(enc->codec->capabilities & CODEC_CAP_PARAM_CHANGE) &&
-                    enc->channels != av_frame_get_channels(filtered_frame)) {
-                    av_log(NULL, AV_LOG_ERROR,
-                           "Audio filter graph output is not normalized and encoder does not support parameter changes\n");
-                    break;
-                }
-                do_audio_out(of->ctx, ost, filtered_frame);
-                break;
-            default:
-                // TODO support subtitle filters
-                av_assert0(0);
+#if HAVE_PTHREADS
+            if (ost->enc_fifo) {
+                if ((ret = send_to_output_thread(ost, filtered_frame)) < 0)
+                    return ret;
+                continue;
             }
-
+#endif
+            do_filtered_frame_out(ost, filtered_frame);
             av_frame_unref(filtered_frame);
         }
     }
 
+#if HAVE_PTHREADS
+    if (output_thread_failed())
+        exit_program(1);
+#endif
+
     return 0;
 }
 
@@ -1309,6 +1612,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     int64_t total_size;
     AVCodecContext *enc;
     int frame_number, vid, i;
+    int nb_frames_dup = 0, nb_frames_drop = 0;
+    int coded_quality;
+    uint64_t *coded_error;
     double bitrate;
     int64_t pts = INT64_MIN;
     static int64_t last_time = -1;
@@ -1331,6 +1637,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 
     oc = output_files[0]->ctx;
 
+    lock_output();
     total_size = avio_size(oc->pb);
     if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
         total_size = avio_tell(oc->pb);
@@ -1342,8 +1649,18 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
         float q = -1;
         ost = output_streams[i];
         enc = ost->st->codec;
+        nb_frames_dup  += ost->frames_dup;
+        nb_frames_drop += ost->frames_drop;
+        coded_quality = enc->coded_frame ? enc->coded_frame->quality : 0;
+        coded_error   = enc->coded_frame ? enc->coded_frame->error   : NULL;
+#if HAVE_PTHREADS
+        if (ost->enc_fifo) {
+            coded_quality = ost->coded_quality;
+            coded_error   = ost->coded_error;
+        }
+#endif
         if (!ost->stream_copy && enc->coded_frame)
-            q = enc->coded_frame->quality / (float)FF_QP2LAMBDA;
+            q = coded_quality / (float)FF_QP2LAMBDA;
         if (vid && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "q=%2.1f ", q);
             av_bprintf(&buf_script, "stream_%d_%d_q=%.1f\n",
@@ -1370,7 +1687,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                 for (j = 0; j < 32; j++)
                     snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%X", (int)lrintf(log2(qp_histogram[j] + 1)));
             }
-            if ((enc->flags&CODEC_FLAG_PSNR) && (enc->coded_frame || is_last_report)) {
+            if ((enc->flags&CODEC_FLAG_PSNR) && (coded_error || is_last_report)) {
                 int j;
                 double error, error_sum = 0;
                 double scale, scale_sum = 0;
@@ -1382,7 +1699,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                         error = enc->error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0 * frame_number;
                     } else {
-                        error = enc->coded_frame->error[j];
+                        error = coded_error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0;
                     }
                     if (j)
@@ -1406,6 +1723,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             pts = FFMAX(pts, av_rescale_q(ost->st->pts.val,
                                           ost->st->time_base, AV_TIME_BASE_Q));
     }
+    unlock_output();
 
     secs = pts / AV_TIME_BASE;
     us = pts % AV_TIME_BASE;
@@ -1993,11 +2311,11 @@ static int transcode_subtitles(InputStream *ist, AVPacket *pkt, int *got_output)
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
 
-        if (!check_output_constraints(ist, ost) || !ost->encoding_needed
-            || ost->enc->type != AVMEDIA_TYPE_SUBTITLE)
-            continue;
-
-        do_subtitle_out(output_files[ost->file_index]->ctx, ost, ist, &subtitle);
+        lock_output();
+        if (check_output_constraints(ist, ost) && ost->encoding_needed &&
+            ost->enc->type == AVMEDIA_TYPE_SUBTITLE)
+            do_subtitle_out(output_files[ost->file_index]->ctx, ost, ist, &subtitle);
+        unlock_output();
     }
 
 out:
@@ -2137,10 +2455,10 @@ static int output_packet(InputStream *ist, const AVPacket *pkt)
     for (i = 0; pkt && i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
 
-        if (!check_output_constraints(ist, ost) || ost->encoding_needed)
-            continue;
-
-        do_streamcopy(ist, ost, pkt);
+        lock_output();
+        if (check_output_constraints(ist, ost) && !ost->encoding_needed)
+            do_streamcopy(ist, ost, pkt);
+        unlock_output();
     }
 
     return 0;
@@ -2805,6 +3123,37 @@ static int transcode_init(void)
     for (i = 0; i < nb_output_files; i++) {
         oc = output_files[i]->ctx;
         oc->interrupt_callback = int_cb;
+        /* without -t, give the mov muxer the expected duration from the
+         * inputs, so that it can reserve space for the moov atom. The output
+         * duration itself is left unset, since other muxers write it. */
+        if (oc->duration <= 0 &&
+            av_opt_find(oc, "expected_duration", NULL, 0, AV_OPT_SEARCH_CHILDREN)) {
+            int64_t expected_duration = 0;
+
+            for (j = 0; j < oc->nb_streams; j++) {
+                InputFile *ifile;
+                int64_t duration;
+
+                ost = output_streams[output_files[i]->ost_index + j];
+                if (ost->source_index < 0)
+                    continue;
+                ifile    = input_files[input_streams[ost->source_index]->file_index];
+                duration = ifile->ctx->duration;
+                if (duration == AV_NOPTS_VALUE || duration <= 0)
+                    continue;
+                if (ifile->start_time != AV_NOPTS_VALUE)
+                    duration -= ifile->start_time;
+                if (ifile->recording_time != INT64_MAX)
+                    duration = FFMIN(duration, ifile->recording_time);
+                if (output_files[i]->start_time != AV_NOPTS_VALUE)
+                    duration -= output_files[i]->start_time;
+                expected_duration = FFMAX(expected_duration, duration);
+            }
+            if (expected_duration > 0 &&
+                !av_dict_get(output_files[i]->opts, "expected_duration", NULL, 0))
+                av_opt_set_int(oc, "expected_duration", expected_duration,
+                               AV_OPT_SEARCH_CHILDREN);
+        }
         if ((ret = avformat_write_header(oc, &output_files[i]->opts)) < 0) {
             snprintf(error, sizeof(error),
                      "Could not write header for output file #%d "
@@ -2905,14 +3254,20 @@ static int need_output(void)
         OutputStream *ost    = output_streams[i];
         OutputFile *of       = output_files[ost->file_index];
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
+        int finished, max_frames_reached;
+
+        lock_output();
+        finished = ost->finished ||
+                   (os->pb && avio_tell(os->pb) >= of->limit_filesize);
+        max_frames_reached = ost->frame_number >= ost->max_frames;
+        unlock_output();
 
-        if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+        if (finished)
             continue;
-        if (ost->frame_number >= ost->max_frames) {
+        if (max_frames_reached) {
             int j;
             for (j = 0; j < of->ctx->nb_streams; j++)
-                close_output_stream(output_streams[of->ost_index + j]);
+                finish_output_stream(output_streams[of->ost_index + j]);
             continue;
         }
 
@@ -2933,6 +3288,7 @@ static OutputStream *choose_output(void)
     int64_t opts_min = INT64_MAX;
     OutputStream *ost_min = NULL;
 
+    lock_output();
     for (i = 0; i < nb_output_streams; i++) {
         OutputStream *ost = output_streams[i];
         int64_t opts = av_rescale_q(ost->st->cur_dts, ost->st->time_base,
@@ -2942,6 +3298,7 @@ static OutputStream *choose_output(void)
             ost_min  = ost;
         }
     }
+    unlock_output();
     return ost_min;
 }
 
@@ -3247,7 +3604,7 @@ static int process_input(int file_index)
 
                 if (ost->source_index == ifile->ist_index + i &&
                     (ost->stream_copy || ost->enc->type == AVMEDIA_TYPE_SUBTITLE))
-                    close_output_stream(ost);
+                    finish_output_stream(ost);
             }
         }
 
@@ -3452,7 +3809,7 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     if (ret == AVERROR_EOF) {
         ret = reap_filters();
         for (i = 0; i < graph->nb_outputs; i++)
-            close_output_stream(graph->outputs[i]->ost);
+            finish_output_stream(graph->outputs[i]->ost);
         return ret;
     }
     if (ret != AVERROR(EAGAIN))
@@ -3546,6 +3903,8 @@ static int transcode(void)
 #if HAVE_PTHREADS
     if ((ret = init_input_threads()) < 0)
         goto fail;
+    if ((ret = init_output_threads()) < 0)
+        goto fail;
 #endif
 
     while (!received_sigterm) {
@@ -3585,6 +3944,11 @@ static int transcode(void)
             output_packet(ist, NULL);
         }
     }
+#if HAVE_PTHREADS
+    free_output_threads(0);
+    if (output_thread_failed())
+        exit_program(1);
+#endif
     flush_encoders();
 
     term_exit();
@@ -3623,6 +3987,7 @@ static int transcode(void)
  fail:
 #if HAVE_PTHREADS
     free_input_threads();
+    free_output_threads(1);
 #endif
 
     if (output_streams) {
@@ -433,6 +433,24 @@ typedef struct OutputStream {
     // number of frames/samples sent to the encoder
     uint64_t frames_encoded;
     uint64_t samples_encoded;
+    // number of frames duplicated/dropped by the video sync code
+    int frames_dup;
+    int frames_drop;
+
+#if HAVE_PTHREADS
+    pthread_t enc_thread;       /* thread encoding and muxing the filtered frames */
+    int enc_thread_eof;         /* no more frames will be sent to the thread */
+    int enc_thread_busy;        /* the thread is processing a frame */
+    int enc_thread_abort;       /* the thread must drop the queued frames */
+    int enc_thread_error;       /* fatal error in the thread, the main thread exits */
+    pthread_mutex_t enc_lock;   /* lock for access to enc_fifo */
+    pthread_cond_t  enc_cond;   /* signaled whenever a frame is added to or removed from enc_fifo */
+    AVFifoBuffer *enc_fifo;     /* filtered frames waiting to be encoded; freed by the main thread */
+    /* copy of coded_frame->quality and error[] made by the thread after each
+     * encoded frame, for print_report() */
+    int      coded_quality;
+    uint64_t coded_error[4];
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -483,6 +501,9 @@ extern int stdin_interaction;
 extern int frame_bits_per_raw_sample;
 extern AVIOContext *progress_avio;
 extern float max_error_rate;
+extern int output_threads;
+extern int filter_branch_threads;
+extern int filter_nbthreads;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -847,6 +847,10 @@ int configure_filtergraph(FilterGraph *fg)
     avfilter_graph_free(&fg->graph);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    if (filter_branch_threads)
+        fg->graph->thread_type |= AVFILTER_THREAD_BRANCH;
+    if (filter_nbthreads)
+        av_opt_set_int(fg->graph, "threads", filter_nbthreads, 0);
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -96,6 +96,9 @@ int qp_hist           = 0;
 int stdin_interaction = 1;
 int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
+int output_threads    = 0;
+int filter_branch_threads = 0;
+int filter_nbthreads  = 0;
 
 
 static int intra_only         = 0;
@@ -2818,6 +2821,10 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
         "read complex filtergraph description from a file", "filename" },
+    { "filter_branch_threads", OPT_BOOL | OPT_EXPERT,                { &filter_branch_threads },
+        "process independent filtergraph branches in parallel" },
+    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT,              { &filter_nbthreads },
+        "number of threads used by the filters of each filtergraph", "n" },
     { "stats",          OPT_BOOL,                                    { &print_stats },
         "print progress report during encoding", },
     { "attach",         HAS_ARG | OPT_PERFILE | OPT_EXPERT |
@@ -2830,6 +2837,8 @@ const OptionDef options[] = {
         "print timestamp debugging info" },
     { "max_error_rate",  HAS_ARG | OPT_FLOAT,                        { &max_error_rate },
         "maximum error rate", "ratio of errors (0.0: no errors, 1.0: 100% errors) above which ffmpeg returns an error instead of success." },
+    { "output_threads", OPT_BOOL | OPT_EXPERT,                       { &output_threads },
+        "encode and mux each filtered output stream in its own thread" },
 
     /* video options */
     { "vframes",      OPT_VIDEO | HAS_ARG  | OPT_PERFILE | OPT_OUTPUT,           { .func_arg = opt_video_frames },
@@ -0,0 +1,127 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Check the optimized Dirac inverse wavelet transforms against the C versions.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/internal.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "dirac_dwt.h"
+
+#undef printf
+
+#define MAX_WIDTH  256
+#define MAX_HEIGHT 64
+#define MAX_DEPTH  4
+#define NB_ITS     200
+
+static const struct {
+    const char *name;
+    enum dwt_type type;
+} wavelets[] = {
+    { "dd9_7",     DWT_DIRAC_DD9_7     },
+    { "legall5_3", DWT_DIRAC_LEGALL5_3 },
+    { "dd13_7",    DWT_DIRAC_DD13_7    },
+    { "haar0",     DWT_DIRAC_HAAR0     },
+    { "haar1",     DWT_DIRAC_HAAR1     },
+};
+
+/* the cpu flags to clear, to also check the older instruction sets */
+static const int cpu_flags_off[] = {
+    0,
+    AV_CPU_FLAG_AVX | AV_CPU_FLAG_AVX2 | AV_CPU_FLAG_XOP |
+    AV_CPU_FLAG_FMA3 | AV_CPU_FLAG_FMA4,
+};
+
+static AVLFG prng;
+
+static DECLARE_ALIGNED(32, IDWTELEM, coeffs)[MAX_WIDTH * MAX_HEIGHT];
+static DECLARE_ALIGNED(32, IDWTELEM, buf_ref)[MAX_WIDTH * MAX_HEIGHT];
+static DECLARE_ALIGNED(32, IDWTELEM, buf_new)[MAX_WIDTH * MAX_HEIGHT];
+static DECLARE_ALIGNED(32, IDWTELEM, tmp)[2 * (MAX_WIDTH + 16)];
+
+static int idwt(IDWTELEM *buf, int width, int height, int stride,
+                enum dwt_type type, int depth)
+{
+    DWTContext d;
+    int y;
+
+    memcpy(buf, coeffs, sizeof(coeffs));
+    if (ff_spatial_idwt_init2(&d, buf, width, height, stride, type, depth, tmp))
+        return -1;
+    for (y = 0; y < height; y += 16)
+        ff_spatial_idwt_slice2(&d, y + 16);
+    return 0;
+}
+
+static int test(int i, int flags)
+{
+    int it, x, y;
+
+    for (it = 0; it < NB_ITS; it++) {
+        /* the C horizontal 13/7 filter reads outside of levels narrower
+         * than 4 coefficients */
+        int depth  = 1 + av_lfg_get(&prng) % MAX_DEPTH;
+        int width  = (4 + av_lfg_get(&prng) % ((MAX_WIDTH  >> depth) - 3)) << depth;
+        int height = (4 + av_lfg_get(&prng) % ((MAX_HEIGHT >> depth) - 3)) << depth;
+        int stride = FFALIGN(width, 8);
+
+        /* coefficients in the range of 8-bit video */
+        for (y = 0; y < height; y++)
+            for (x = 0; x < width; x++)
+                coeffs[y * stride + x] = (int)(av_lfg_get(&prng) % 1024) - 512;
+
+        av_force_cpu_flags(0);
+        if (idwt(buf_ref, width, height, stride, wavelets[i].type, depth) < 0) {
+            printf("%s: init failed\n", wavelets[i].name);
+            return 1;
+        }
+        av_force_cpu_flags(flags);
+        idwt(buf_new, width, height, stride, wavelets[i].type, depth);
+
+        if (memcmp(buf_ref, buf_new, sizeof(buf_ref))) {
+            printf("%s: mismatch for %dx%d depth %d with cpu flags 0x%x "
+                   "in iteration %d\n", wavelets[i].name, width, height,
+                   depth, flags, it);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int cpu_flags = av_get_cpu_flags();
+    int i, j, ret = 0;
+
+    av_lfg_init(&prng, 1);
+
+    for (j = 0; j < FF_ARRAY_ELEMS(cpu_flags_off); j++)
+        for (i = 0; i < FF_ARRAY_ELEMS(wavelets); i++)
+            ret |= test(i, cpu_flags & ~cpu_flags_off[j]);
+
+    return ret;
+}
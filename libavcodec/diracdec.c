@@ -618,19 +618,22 @@ static int decode_subband_golomb(AVCodecContext *avctx, void *arg)
 /**
  * Dirac Specification ->
  * [DIRAC_STD] 13.4.1 core_transform_data()
+ *
+ * Golomb coded subbands are only added to bands, to be decoded together
+ * with the ones of the other components.
  */
-static void decode_component(DiracContext *s, int comp)
+static void decode_component(DiracContext *s, int comp, SubBand **bands,
+                             int *num_bands)
 {
     AVCodecContext *avctx = s->avctx;
-    SubBand *bands[3*MAX_DWT_LEVELS+1];
     enum dirac_subband orientation;
-    int level, num_bands = 0;
+    int level;
 
     /* Unpack all subbands at all levels. */
     for (level = 0; level < s->wavelet_depth; level++) {
         for (orientation = !!level; orientation < 4; orientation++) {
             SubBand *b = &s->plane[comp].band[level][orientation];
-            bands[num_bands++] = b;
+            bands[(*num_bands)++] = b;
 
             align_get_bits(&s->gb);
             /* [DIRAC_STD] 13.4.2 subband() */
@@ -648,9 +651,6 @@ static void decode_component(DiracContext *s, int comp)
             avctx->execute(avctx, decode_subband_arith, &s->plane[comp].band[level][!!level],
                            NULL, 4-!!level, sizeof(SubBand));
     }
-    /* golomb coding has no inter-level dependencies, so we can execute all subbands in parallel */
-    if (!s->is_arith)
-        avctx->execute(avctx, decode_subband_golomb, bands, NULL, num_bands, sizeof(SubBand*));
 }
 
 /* [DIRAC_STD] 13.5.5.2 Luma slice subband data. luma_slice_band(level,orient,sx,sy) --> if b2 == NULL */
@@ -1560,6 +1560,30 @@ static void interpolate_refplane(DiracContext *s, DiracFrame *ref, int plane, in
  * Dirac Specification ->
  * 13.0 Transform data syntax. transform_data()
  */
+/**
+ * IDWT of an intra plane, the planes are independent and transformed in
+ * parallel.
+ */
+static int idwt_intra_plane(AVCodecContext *avctx, void *arg, int comp, int threadnr)
+{
+    DiracContext *s = avctx->priv_data;
+    Plane *p        = &s->plane[comp];
+    uint8_t *frame  = s->current_picture->avframe->data[comp];
+    DWTContext d;
+    int y;
+
+    if (ff_spatial_idwt_init2(&d, p->idwt_buf, p->idwt_width, p->idwt_height, p->idwt_stride,
+                              s->wavelet_idx+2, s->wavelet_depth, p->idwt_tmp))
+        return -1;
+
+    for (y = 0; y < p->height; y += 16) {
+        ff_spatial_idwt_slice2(&d, y+16); /* decode */
+        s->diracdsp.put_signed_rect_clamped(frame + y*p->stride, p->stride,
+                                            p->idwt_buf + y*p->idwt_stride, p->idwt_stride, p->width, 16);
+    }
+    return 0;
+}
+
 static int dirac_decode_frame_internal(DiracContext *s)
 {
     DWTContext d;
@@ -1573,67 +1597,74 @@ static int dirac_decode_frame_internal(DiracContext *s)
         }
         if (!s->zero_res)
             decode_lowdelay(s);
+    } else if (!s->zero_res) {
+        SubBand *bands[3*(3*MAX_DWT_LEVELS+1)];
+        int num_bands = 0;
+
+        for (comp = 0; comp < 3; comp++) {
+            Plane *p = &s->plane[comp];
+            memset(p->idwt_buf, 0, p->idwt_stride * p->idwt_height * sizeof(IDWTELEM));
+            decode_component(s, comp, bands, &num_bands); /* [DIRAC_STD] 13.4.1 core_transform_data() */
+        }
+        /* golomb coding has no inter-level dependencies, so we can execute all subbands in parallel */
+        if (!s->is_arith)
+            s->avctx->execute(s->avctx, decode_subband_golomb, bands, NULL, num_bands, sizeof(SubBand*));
+    }
+
+    if (!s->num_refs) { /* intra */
+        int ret[3];
+
+        s->avctx->execute2(s->avctx, idwt_intra_plane, NULL, ret, 3);
+        if (ret[0] < 0 || ret[1] < 0 || ret[2] < 0)
+            return -1;
+        return 0;
     }
 
     for (comp = 0; comp < 3; comp++) {
         Plane *p       = &s->plane[comp];
         uint8_t *frame = s->current_picture->avframe->data[comp];
+        int rowheight  = p->ybsep*p->stride;
 
         /* FIXME: small resolutions */
         for (i = 0; i < 4; i++)
             s->edge_emu_buffer[i] = s->edge_emu_buffer_base + i*FFALIGN(p->width, 16);
 
-        if (!s->zero_res && !s->low_delay)
-        {
-            memset(p->idwt_buf, 0, p->idwt_stride * p->idwt_height * sizeof(IDWTELEM));
-            decode_component(s, comp); /* [DIRAC_STD] 13.4.1 core_transform_data() */
-        }
         if (ff_spatial_idwt_init2(&d, p->idwt_buf, p->idwt_width, p->idwt_height, p->idwt_stride,
                                   s->wavelet_idx+2, s->wavelet_depth, p->idwt_tmp))
             return -1;
 
-        if (!s->num_refs) { /* intra */
-            for (y = 0; y < p->height; y += 16) {
-                ff_spatial_idwt_slice2(&d, y+16); /* decode */
-                s->diracdsp.put_signed_rect_clamped(frame + y*p->stride, p->stride,
-                                                    p->idwt_buf + y*p->idwt_stride, p->idwt_stride, p->width, 16);
-            }
-        } else { /* inter */
-            int rowheight = p->ybsep*p->stride;
-
-            select_dsp_funcs(s, p->width, p->height, p->xblen, p->yblen);
+        select_dsp_funcs(s, p->width, p->height, p->xblen, p->yblen);
 
-            for (i = 0; i < s->num_refs; i++)
-                interpolate_refplane(s, s->ref_pics[i], comp, p->width, p->height);
+        for (i = 0; i < s->num_refs; i++)
+            interpolate_refplane(s, s->ref_pics[i], comp, p->width, p->height);
 
-            memset(s->mctmp, 0, 4*p->yoffset*p->stride);
+        memset(s->mctmp, 0, 4*p->yoffset*p->stride);
 
-            dsty = -p->yoffset;
-            for (y = 0; y < s->blheight; y++) {
-                int h     = 0,
-                    start = FFMAX(dsty, 0);
-                uint16_t *mctmp    = s->mctmp + y*rowheight;
-                DiracBlock *blocks = s->blmotion + y*s->blwidth;
+        dsty = -p->yoffset;
+        for (y = 0; y < s->blheight; y++) {
+            int h     = 0,
+                start = FFMAX(dsty, 0);
+            uint16_t *mctmp    = s->mctmp + y*rowheight;
+            DiracBlock *blocks = s->blmotion + y*s->blwidth;
 
-                init_obmc_weights(s, p, y);
+            init_obmc_weights(s, p, y);
 
-                if (y == s->blheight-1 || start+p->ybsep > p->height)
-                    h = p->height - start;
-                else
-                    h = p->ybsep - (start - dsty);
-                if (h < 0)
-                    break;
+            if (y == s->blheight-1 || start+p->ybsep > p->height)
+                h = p->height - start;
+            else
+                h = p->ybsep - (start - dsty);
+            if (h < 0)
+                break;
 
-                memset(mctmp+2*p->yoffset*p->stride, 0, 2*rowheight);
-                mc_row(s, blocks, mctmp, comp, dsty);
+            memset(mctmp+2*p->yoffset*p->stride, 0, 2*rowheight);
+            mc_row(s, blocks, mctmp, comp, dsty);
 
-                mctmp += (start - dsty)*p->stride + p->xoffset;
-                ff_spatial_idwt_slice2(&d, start + h); /* decode */
-                s->diracdsp.add_rect_clamped(frame + start*p->stride, mctmp, p->stride,
-                                             p->idwt_buf + start*p->idwt_stride, p->idwt_stride, p->width, h);
+            mctmp += (start - dsty)*p->stride + p->xoffset;
+            ff_spatial_idwt_slice2(&d, start + h); /* decode */
+            s->diracdsp.add_rect_clamped(frame + start*p->stride, mctmp, p->stride,
+                                         p->idwt_buf + start*p->idwt_stride, p->idwt_stride, p->width, h);
 
-                dsty += p->ybsep;
-            }
+            dsty += p->ybsep;
         }
     }
 
@@ -1969,6 +2000,6 @@ AVCodec ff_dirac_decoder = {
     .init           = dirac_decode_init,
     .close          = dirac_decode_end,
     .decode         = dirac_decode_frame,
-    .capabilities   = CODEC_CAP_DELAY,
+    .capabilities   = CODEC_CAP_DELAY | CODEC_CAP_SLICE_THREADS,
     .flush          = dirac_decode_flush,
 };
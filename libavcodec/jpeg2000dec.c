@@ -62,6 +62,16 @@ typedef struct Jpeg2000Tile {
     uint16_t tp_idx;                    // Tile-part index
 } Jpeg2000Tile;
 
+/* Tier-1 decoding and dequantization of one code-block, the code-blocks of
+ * all the tiles and components are independent and decoded in parallel. */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component   *comp;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000Band        *band;
+    Jpeg2000Cblk        *cblk;
+    int                 bandpos;
+} Jpeg2000CblkJob;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -93,6 +103,9 @@ typedef struct Jpeg2000DecoderContext {
 
     Jpeg2000Tile    *tile;
 
+    Jpeg2000CblkJob *cblk_jobs;
+    int             nb_cblk_jobs;
+
     /*options parameters*/
     int             reduction_factor;
 } Jpeg2000DecoderContext;
@@ -1212,79 +1225,110 @@ static void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
     }
 }
 
-static int jpeg2000_decode_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
-                                AVFrame *picture)
+/* Fill jobs with the code-blocks of all the tiles if it is not NULL,
+ * return the number of code-blocks. */
+static int get_cblk_jobs(Jpeg2000DecoderContext *s, Jpeg2000CblkJob *jobs)
 {
-    const AVPixFmtDescriptor *pixdesc = av_pix_fmt_desc_get(s->avctx->pix_fmt);
-    int compno, reslevelno, bandno;
-    int x, y;
-    int planar    = !!(pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR);
-    int pixelsize = planar ? 1 : pixdesc->nb_components;
+    int tileno, compno, reslevelno, bandno, precno, cblkno, nb_jobs = 0;
 
-    uint8_t *line;
+    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+        Jpeg2000Tile *tile = s->tile + tileno;
+
+        /* Loop on tile components */
+        for (compno = 0; compno < s->ncomponents; compno++) {
+            Jpeg2000Component *comp     = tile->comp + compno;
+            Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+
+            /* Loop on resolution levels */
+            for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
+                Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+                int nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
+                /* Loop on bands */
+                for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+                    Jpeg2000Band *band = rlevel->band + bandno;
+
+                    if (band->coord[0][0] == band->coord[0][1] ||
+                        band->coord[1][0] == band->coord[1][1])
+                        continue;
+
+                    /* Loop on precincts */
+                    for (precno = 0; precno < nb_precincts; precno++) {
+                        Jpeg2000Prec *prec = band->prec + precno;
+                        int nb_cblks = prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+
+                        if (!jobs) {
+                            nb_jobs += nb_cblks;
+                            continue;
+                        }
+                        /* Loop on codeblocks */
+                        for (cblkno = 0; cblkno < nb_cblks; cblkno++) {
+                            Jpeg2000CblkJob *job = jobs + nb_jobs++;
+                            job->comp    = comp;
+                            job->codsty  = codsty;
+                            job->band    = band;
+                            job->cblk    = prec->cblk + cblkno;
+                            job->bandpos = bandno + (reslevelno > 0);
+                        }
+                    } /*end prec */
+                } /* end band */
+            } /* end reslevel */
+        } /*end comp */
+    }
+    return nb_jobs;
+}
+
+static int decode_cblk_job(AVCodecContext *avctx, void *arg,
+                           int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000CblkJob *job      = s->cblk_jobs + jobnr;
+    Jpeg2000Cblk *cblk        = job->cblk;
     Jpeg2000T1Context t1;
+    int x = cblk->coord[0][0];
+    int y = cblk->coord[1][0];
 
-    /* Loop on tile components */
-    for (compno = 0; compno < s->ncomponents; compno++) {
-        Jpeg2000Component *comp     = tile->comp + compno;
-        Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+    decode_cblk(s, job->codsty, &t1, cblk,
+                cblk->coord[0][1] - cblk->coord[0][0],
+                cblk->coord[1][1] - cblk->coord[1][0],
+                job->bandpos);
 
-        /* Loop on resolution levels */
-        for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
-            Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
-            /* Loop on bands */
-            for (bandno = 0; bandno < rlevel->nbands; bandno++) {
-                int nb_precincts, precno;
-                Jpeg2000Band *band = rlevel->band + bandno;
-                int cblkno = 0, bandpos;
+    if (job->codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, job->comp, &t1, job->band);
+    else
+        dequantization_int(x, y, cblk, job->comp, &t1, job->band);
+    return 0;
+}
 
-                bandpos = bandno + (reslevelno > 0);
+/* inverse DWT of one component of one tile */
+static int dwt_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s   = avctx->priv_data;
+    Jpeg2000Tile *tile          = s->tile + jobnr / s->ncomponents;
+    Jpeg2000Component *comp     = tile->comp   + jobnr % s->ncomponents;
+    Jpeg2000CodingStyle *codsty = tile->codsty + jobnr % s->ncomponents;
 
-                if (band->coord[0][0] == band->coord[0][1] ||
-                    band->coord[1][0] == band->coord[1][1])
-                    continue;
+    ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
+    return 0;
+}
 
-                nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
-                /* Loop on precincts */
-                for (precno = 0; precno < nb_precincts; precno++) {
-                    Jpeg2000Prec *prec = band->prec + precno;
-
-                    /* Loop on codeblocks */
-                    for (cblkno = 0; cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height; cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos);
-
-                        x = cblk->coord[0][0];
-                        y = cblk->coord[1][0];
-
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
-                   } /* end cblk */
-                } /*end prec */
-            } /* end band */
-        } /* end reslevel */
+static int jpeg2000_decode_tile(AVCodecContext *avctx, void *arg,
+                                int tileno, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000Tile *tile        = s->tile + tileno;
+    AVFrame *picture          = arg;
+    const AVPixFmtDescriptor *pixdesc = av_pix_fmt_desc_get(s->avctx->pix_fmt);
+    int compno;
+    int x, y;
+    int planar    = !!(pixdesc->flags & AV_PIX_FMT_FLAG_PLANAR);
+    int pixelsize = planar ? 1 : pixdesc->nb_components;
 
-        /* inverse DWT */
-        ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
-    } /*end comp */
+    uint8_t *line;
 
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
 
-    if (s->cdef[0] < 0) {
-        for (x = 0; x < s->ncomponents; x++)
-            s->cdef[x] = x + 1;
-        if ((s->ncomponents & 1) == 0)
-            s->cdef[s->ncomponents-1] = 0;
-    }
-
     if (s->precision <= 8) {
         for (compno = 0; compno < s->ncomponents; compno++) {
             Jpeg2000Component *comp = tile->comp + compno;
@@ -1394,6 +1438,7 @@ static void jpeg2000_dec_cleanup(Jpeg2000DecoderContext *s)
         }
     }
     av_freep(&s->tile);
+    av_freep(&s->cblk_jobs);
     memset(s->codsty, 0, sizeof(s->codsty));
     memset(s->qntsty, 0, sizeof(s->qntsty));
     s->numXtiles = s->numYtiles = 0;
@@ -1626,7 +1671,7 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     Jpeg2000DecoderContext *s = avctx->priv_data;
     ThreadFrame frame = { .f = data };
     AVFrame *picture = data;
-    int tileno, ret;
+    int i, ret;
 
     s->avctx     = avctx;
     bytestream2_init(&s->g, avpkt->data, avpkt->size);
@@ -1673,9 +1718,27 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
 
-    for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
-        if (ret = jpeg2000_decode_tile(s, s->tile + tileno, picture))
-            goto end;
+    if (s->cdef[0] < 0) {
+        for (i = 0; i < s->ncomponents; i++)
+            s->cdef[i] = i + 1;
+        if ((s->ncomponents & 1) == 0)
+            s->cdef[s->ncomponents-1] = 0;
+    }
+
+    /* Tier-1 decoding of the code-blocks, inverse DWT of the components and
+     * output of the tiles are each run in parallel with slice threading. */
+    s->nb_cblk_jobs = get_cblk_jobs(s, NULL);
+    s->cblk_jobs    = av_malloc_array(s->nb_cblk_jobs, sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    get_cblk_jobs(s, s->cblk_jobs);
+    avctx->execute2(avctx, decode_cblk_job, NULL, NULL, s->nb_cblk_jobs);
+    avctx->execute2(avctx, dwt_job, NULL, NULL,
+                    s->numXtiles * s->numYtiles * s->ncomponents);
+    avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL,
+                    s->numXtiles * s->numYtiles);
 
     jpeg2000_dec_cleanup(s);
 
@@ -1727,7 +1790,7 @@ AVCodec ff_jpeg2000_decoder = {
     .long_name        = NULL_IF_CONFIG_SMALL("JPEG 2000"),
     .type             = AVMEDIA_TYPE_VIDEO,
     .id               = AV_CODEC_ID_JPEG2000,
-    .capabilities     = CODEC_CAP_FRAME_THREADS,
+    .capabilities     = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .priv_data_size   = sizeof(Jpeg2000DecoderContext),
     .init_static_data = jpeg2000_init_static_data,
     .decode           = jpeg2000_decode_frame,
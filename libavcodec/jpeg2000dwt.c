@@ -25,6 +25,7 @@
  * Discrete wavelet transform
  */
 
+#include "config.h"
 #include "libavutil/common.h"
 #include "libavutil/mem.h"
 #include "jpeg2000dwt.h"
@@ -286,19 +287,76 @@ static void dwt_encode97_int(DWTContext *s, int *t)
     }
 }
 
-static void sr_1d53(int *p, int i0, int i1)
+/* The decoder transforms FF_DWT_STRIP lines (horizontal pass) or columns
+ * (vertical pass) at once: the line buffer holds FF_DWT_STRIP interleaved
+ * coefficients per position, so that each lifting step works on contiguous
+ * memory and the vertical pass reads whole cache lines. */
+#define LINE(p, i) ((p) + (i) * FF_DWT_STRIP)
+
+static void copy_line(void *dst, const void *src)
+{
+    memcpy(dst, src, FF_DWT_STRIP * 4);
+}
+
+static void extend53_lines(int32_t *p, int i0, int i1)
+{
+    copy_line(LINE(p, i0 - 1), LINE(p, i0 + 1));
+    copy_line(LINE(p, i1),     LINE(p, i1 - 2));
+    copy_line(LINE(p, i0 - 2), LINE(p, i0 + 2));
+    copy_line(LINE(p, i1 + 1), LINE(p, i1 - 3));
+}
+
+static void extend97_lines(void *p, int i0, int i1)
+{
+    int32_t *l = p;
+    int i;
+
+    for (i = 1; i <= 4; i++) {
+        copy_line(LINE(l, i0 - i),     LINE(l, i0 + i));
+        copy_line(LINE(l, i1 + i - 1), LINE(l, i1 - i - 1));
+    }
+}
+
+static void lift_float_c(float *dst, const float *src0, const float *src1,
+                         float coef)
+{
+    int i;
+
+    for (i = 0; i < FF_DWT_STRIP; i++)
+        dst[i] += coef * (src0[i] + src1[i]);
+}
+
+static void lift53_even_c(int32_t *dst, const int32_t *src0,
+                          const int32_t *src1)
+{
+    int i;
+
+    for (i = 0; i < FF_DWT_STRIP; i++)
+        dst[i] -= (src0[i] + src1[i] + 2) >> 2;
+}
+
+static void lift53_odd_c(int32_t *dst, const int32_t *src0,
+                         const int32_t *src1)
+{
+    int i;
+
+    for (i = 0; i < FF_DWT_STRIP; i++)
+        dst[i] += (src0[i] + src1[i]) >> 1;
+}
+
+static void sr_1d53(DWTContext *s, int32_t *p, int i0, int i1)
 {
     int i;
 
     if (i1 == i0 + 1)
         return;
 
-    extend53(p, i0, i1);
+    extend53_lines(p, i0, i1);
 
     for (i = i0 / 2; i < i1 / 2 + 1; i++)
-        p[2 * i] -= (p[2 * i - 1] + p[2 * i + 1] + 2) >> 2;
+        s->lift53_even(LINE(p, 2 * i), LINE(p, 2 * i - 1), LINE(p, 2 * i + 1));
     for (i = i0 / 2; i < i1 / 2; i++)
-        p[2 * i + 1] += (p[2 * i] + p[2 * i + 2]) >> 1;
+        s->lift53_odd(LINE(p, 2 * i + 1), LINE(p, 2 * i), LINE(p, 2 * i + 2));
 }
 
 static void dwt_decode53(DWTContext *s, int *t)
@@ -306,7 +364,7 @@ static void dwt_decode53(DWTContext *s, int *t)
     int lev;
     int w     = s->linelen[s->ndeclevels - 1][0];
     int32_t *line = s->i_linebuf;
-    line += 3;
+    line += 3 * FF_DWT_STRIP;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
         int lh = s->linelen[lev][0],
@@ -317,59 +375,70 @@ static void dwt_decode53(DWTContext *s, int *t)
         int *l;
 
         // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
+        l = LINE(line, mh);
+        for (lp = 0; lp < lv; lp += FF_DWT_STRIP) {
+            int i, j, k, n = FFMIN(FF_DWT_STRIP, lv - lp);
             // copy with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = t[w * lp + j];
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = t[w * lp + j];
-
-            sr_1d53(line, mh, mh + lh);
-
-            for (i = 0; i < lh; i++)
-                t[w * lp + i] = l[i];
+            for (k = 0; k < n; k++) {
+                int *src = t + w * (lp + k);
+                for (i = mh, j = 0; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = src[j];
+                for (i = 1 - mh; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = src[j];
+            }
+
+            sr_1d53(s, line, mh, mh + lh);
+
+            for (k = 0; k < n; k++) {
+                int *dst = t + w * (lp + k);
+                for (i = 0; i < lh; i++)
+                    dst[i] = l[i * FF_DWT_STRIP + k];
+            }
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = LINE(line, mv);
+        for (lp = 0; lp < lh; lp += FF_DWT_STRIP) {
+            int i, j = 0, k, n = FFMIN(FF_DWT_STRIP, lh - lp);
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = t[w * j + lp + k];
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = t[w * j + lp];
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = t[w * j + lp + k];
 
-            sr_1d53(line, mv, mv + lv);
+            sr_1d53(s, line, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                t[w * i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    t[w * i + lp + k] = LINE(l, i)[k];
         }
     }
 }
 
-static void sr_1d97_float(float *p, int i0, int i1)
+static void sr_1d97_float(DWTContext *s, float *p, int i0, int i1)
 {
     int i;
 
     if (i1 == i0 + 1)
         return;
 
-    extend97_float(p, i0, i1);
+    extend97_lines(p, i0, i1);
 
+    /* The subtractions are done as additions of the negated coefficients,
+     * which gives exactly the same results. */
     for (i = i0 / 2 - 1; i < i1 / 2 + 2; i++)
-        p[2 * i]     -= F_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]);
+        s->lift_float(LINE(p, 2 * i),     LINE(p, 2 * i - 1), LINE(p, 2 * i + 1), -F_LFTG_DELTA);
     /* step 4 */
     for (i = i0 / 2 - 1; i < i1 / 2 + 1; i++)
-        p[2 * i + 1] -= F_LFTG_GAMMA * (p[2 * i]     + p[2 * i + 2]);
+        s->lift_float(LINE(p, 2 * i + 1), LINE(p, 2 * i),     LINE(p, 2 * i + 2), -F_LFTG_GAMMA);
     /*step 5*/
     for (i = i0 / 2; i < i1 / 2 + 1; i++)
-        p[2 * i]     += F_LFTG_BETA  * (p[2 * i - 1] + p[2 * i + 1]);
+        s->lift_float(LINE(p, 2 * i),     LINE(p, 2 * i - 1), LINE(p, 2 * i + 1),  F_LFTG_BETA);
     /* step 6 */
     for (i = i0 / 2; i < i1 / 2; i++)
-        p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
+        s->lift_float(LINE(p, 2 * i + 1), LINE(p, 2 * i),     LINE(p, 2 * i + 2),  F_LFTG_ALPHA);
 }
 
 static void dwt_decode97_float(DWTContext *s, float *t)
@@ -379,7 +448,7 @@ static void dwt_decode97_float(DWTContext *s, float *t)
     float *line = s->f_linebuf;
     float *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    line += 5 * FF_DWT_STRIP;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
         int lh = s->linelen[lev][0],
@@ -389,39 +458,57 @@ static void dwt_decode97_float(DWTContext *s, float *t)
             lp;
         float *l;
         // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
+        l = LINE(line, mh);
+        for (lp = 0; lp < lv; lp += FF_DWT_STRIP) {
+            int i, j, k, n = FFMIN(FF_DWT_STRIP, lv - lp);
             // copy with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = data[w * lp + j] * F_LFTG_K;
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = data[w * lp + j] * F_LFTG_X;
-
-            sr_1d97_float(line, mh, mh + lh);
-
-            for (i = 0; i < lh; i++)
-                data[w * lp + i] = l[i];
+            for (k = 0; k < n; k++) {
+                float *src = data + w * (lp + k);
+                for (i = mh, j = 0; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = src[j] * F_LFTG_K;
+                for (i = 1 - mh; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = src[j] * F_LFTG_X;
+            }
+
+            sr_1d97_float(s, line, mh, mh + lh);
+
+            for (k = 0; k < n; k++) {
+                float *dst = data + w * (lp + k);
+                for (i = 0; i < lh; i++)
+                    dst[i] = l[i * FF_DWT_STRIP + k];
+            }
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = LINE(line, mv);
+        for (lp = 0; lp < lh; lp += FF_DWT_STRIP) {
+            int i, j = 0, k, n = FFMIN(FF_DWT_STRIP, lh - lp);
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp] * F_LFTG_K;
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = data[w * j + lp + k] * F_LFTG_K;
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = data[w * j + lp] * F_LFTG_X;
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = data[w * j + lp + k] * F_LFTG_X;
 
-            sr_1d97_float(line, mv, mv + lv);
+            sr_1d97_float(s, line, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    data[w * i + lp + k] = LINE(l, i)[k];
         }
     }
 }
 
+static void lift97_int(int32_t *dst, const int32_t *src0, const int32_t *src1,
+                       int coef, int sign)
+{
+    int i;
+
+    for (i = 0; i < FF_DWT_STRIP; i++)
+        dst[i] += sign * ((coef * (src0[i] + src1[i]) + (1 << 15)) >> 16);
+}
+
 static void sr_1d97_int(int32_t *p, int i0, int i1)
 {
     int i;
@@ -429,19 +516,19 @@ static void sr_1d97_int(int32_t *p, int i0, int i1)
     if (i1 == i0 + 1)
         return;
 
-    extend97_int(p, i0, i1);
+    extend97_lines(p, i0, i1);
 
     for (i = i0 / 2 - 1; i < i1 / 2 + 2; i++)
-        p[2 * i]     -= (I_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]) + (1 << 15)) >> 16;
+        lift97_int(LINE(p, 2 * i),     LINE(p, 2 * i - 1), LINE(p, 2 * i + 1), I_LFTG_DELTA, -1);
     /* step 4 */
     for (i = i0 / 2 - 1; i < i1 / 2 + 1; i++)
-        p[2 * i + 1] -= (I_LFTG_GAMMA * (p[2 * i]     + p[2 * i + 2]) + (1 << 15)) >> 16;
+        lift97_int(LINE(p, 2 * i + 1), LINE(p, 2 * i),     LINE(p, 2 * i + 2), I_LFTG_GAMMA, -1);
     /*step 5*/
     for (i = i0 / 2; i < i1 / 2 + 1; i++)
-        p[2 * i]     += (I_LFTG_BETA  * (p[2 * i - 1] + p[2 * i + 1]) + (1 << 15)) >> 16;
+        lift97_int(LINE(p, 2 * i),     LINE(p, 2 * i - 1), LINE(p, 2 * i + 1), I_LFTG_BETA,   1);
     /* step 6 */
     for (i = i0 / 2; i < i1 / 2; i++)
-        p[2 * i + 1] += (I_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]) + (1 << 15)) >> 16;
+        lift97_int(LINE(p, 2 * i + 1), LINE(p, 2 * i),     LINE(p, 2 * i + 2), I_LFTG_ALPHA,  1);
 }
 
 static void dwt_decode97_int(DWTContext *s, int32_t *t)
@@ -451,7 +538,7 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
     int32_t *line = s->i_linebuf;
     int32_t *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    line += 5 * FF_DWT_STRIP;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
         int lh = s->linelen[lev][0],
@@ -461,35 +548,44 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
             lp;
         int32_t *l;
         // HOR_SD
-        l = line + mh;
-        for (lp = 0; lp < lv; lp++) {
-            int i, j = 0;
+        l = LINE(line, mh);
+        for (lp = 0; lp < lv; lp += FF_DWT_STRIP) {
+            int i, j, k, n = FFMIN(FF_DWT_STRIP, lv - lp);
             // rescale with interleaving
-            for (i = mh; i < lh; i += 2, j++)
-                l[i] = ((data[w * lp + j] * I_LFTG_K) + (1 << 15)) >> 16;
-            for (i = 1 - mh; i < lh; i += 2, j++)
-                l[i] = ((data[w * lp + j] * I_LFTG_X) + (1 << 15)) >> 16;
+            for (k = 0; k < n; k++) {
+                int32_t *src = data + w * (lp + k);
+                for (i = mh, j = 0; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = ((src[j] * I_LFTG_K) + (1 << 15)) >> 16;
+                for (i = 1 - mh; i < lh; i += 2, j++)
+                    l[i * FF_DWT_STRIP + k] = ((src[j] * I_LFTG_X) + (1 << 15)) >> 16;
+            }
 
             sr_1d97_int(line, mh, mh + lh);
 
-            for (i = 0; i < lh; i++)
-                data[w * lp + i] = l[i];
+            for (k = 0; k < n; k++) {
+                int32_t *dst = data + w * (lp + k);
+                for (i = 0; i < lh; i++)
+                    dst[i] = l[i * FF_DWT_STRIP + k];
+            }
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
-            int i, j = 0;
+        l = LINE(line, mv);
+        for (lp = 0; lp < lh; lp += FF_DWT_STRIP) {
+            int i, j = 0, k, n = FFMIN(FF_DWT_STRIP, lh - lp);
             // rescale with interleaving
             for (i = mv; i < lv; i += 2, j++)
-                l[i] = ((data[w * j + lp] * I_LFTG_K) + (1 << 15)) >> 16;
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = ((data[w * j + lp + k] * I_LFTG_K) + (1 << 15)) >> 16;
             for (i = 1 - mv; i < lv; i += 2, j++)
-                l[i] = ((data[w * j + lp] * I_LFTG_X) + (1 << 15)) >> 16;
+                for (k = 0; k < n; k++)
+                    LINE(l, i)[k] = ((data[w * j + lp + k] * I_LFTG_X) + (1 << 15)) >> 16;
 
             sr_1d97_int(line, mv, mv + lv);
 
             for (i = 0; i < lv; i++)
-                data[w * i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    data[w * i + lp + k] = LINE(l, i)[k];
         }
     }
 }
@@ -516,25 +612,33 @@ int ff_jpeg2000_dwt_init(DWTContext *s, uint16_t border[2][2],
             for (j = 0; j < 2; j++)
                 b[i][j] = (b[i][j] + 1) >> 1;
         }
+    /* the decoder works on FF_DWT_STRIP lines at once */
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_mallocz_array((maxlen + 12) * FF_DWT_STRIP, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
      case FF_DWT97_INT:
-        s->i_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_mallocz_array((maxlen + 12) * FF_DWT_STRIP, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     case FF_DWT53:
-        s->i_linebuf = av_malloc_array((maxlen +  6), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_mallocz_array((maxlen +  6) * FF_DWT_STRIP, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     default:
         return -1;
     }
+
+    s->lift_float  = lift_float_c;
+    s->lift53_even = lift53_even_c;
+    s->lift53_odd  = lift53_odd_c;
+    if (ARCH_X86)
+        ff_jpeg2000dwt_init_x86(s);
+
     return 0;
 }
 
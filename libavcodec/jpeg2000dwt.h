@@ -30,6 +30,7 @@
 #include <stdint.h>
 
 #define FF_DWT_MAX_DECLVLS 32 ///< max number of decomposition levels
+#define FF_DWT_STRIP       16 ///< number of lines transformed together by the decoder
 
 enum DWTType {
     FF_DWT97,
@@ -45,6 +46,15 @@ typedef struct DWTContext {
     uint8_t type;                        ///< 0 for 9/7; 1 for 5/3
     int32_t *i_linebuf;                  ///< int buffer used by transform
     float   *f_linebuf;                  ///< float buffer used by transform
+
+    /* Lifting steps of the inverse transform. They update FF_DWT_STRIP
+     * consecutive coefficients of a line from its two neighbour lines. */
+    void (*lift_float)(float *dst, const float *src0, const float *src1,
+                       float coef);     ///< dst += coef * (src0 + src1)
+    void (*lift53_even)(int32_t *dst, const int32_t *src0,
+                        const int32_t *src1); ///< dst -= (src0 + src1 + 2) >> 2
+    void (*lift53_odd)(int32_t *dst, const int32_t *src0,
+                       const int32_t *src1);  ///< dst += (src0 + src1) >> 1
 } DWTContext;
 
 /**
@@ -62,4 +72,6 @@ int ff_dwt_decode(DWTContext *s, void *t);
 
 void ff_dwt_destroy(DWTContext *s);
 
+void ff_jpeg2000dwt_init_x86(DWTContext *s);
+
 #endif /* AVCODEC_JPEG2000DWT_H */
@@ -39,6 +39,7 @@
 #include "mjpeg.h"
 #include "mjpegdec.h"
 #include "jpeglsdec.h"
+#include "thread.h"
 #include "tiff.h"
 #include "exif.h"
 #include "bytestream.h"
@@ -67,20 +68,51 @@ static int build_vlc(VLC *vlc, const uint8_t *bits_table,
                               huff_code, 2, 2, huff_sym, 2, 2, use_static);
 }
 
+static void free_shared_vlc(MJpegDecodeContext *s, int class, int index)
+{
+    av_buffer_unref(&s->vlc_bufs[class][index]);
+    memset(&s->vlcs[class][index], 0, sizeof(s->vlcs[class][index]));
+}
+
+/**
+ * Replace a VLC table. The tables are shared read-only with the other frame
+ * threads, so a new table is built instead of modifying the current one.
+ */
+static int build_shared_vlc(MJpegDecodeContext *s, int class, int index,
+                            const uint8_t *bits_table,
+                            const uint8_t *val_table, int nb_codes, int is_ac)
+{
+    VLC *vlc = &s->vlcs[class][index];
+    int ret;
+
+    free_shared_vlc(s, class, index);
+    if ((ret = build_vlc(vlc, bits_table, val_table, nb_codes, 0, is_ac)) < 0)
+        return ret;
+
+    s->vlc_bufs[class][index] = av_buffer_create((uint8_t *)vlc->table,
+                                                 vlc->table_allocated * sizeof(*vlc->table),
+                                                 av_buffer_default_free, NULL, 0);
+    if (!s->vlc_bufs[class][index]) {
+        ff_free_vlc(vlc);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
 static void build_basic_mjpeg_vlc(MJpegDecodeContext *s)
 {
-    build_vlc(&s->vlcs[0][0], avpriv_mjpeg_bits_dc_luminance,
-              avpriv_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[0][1], avpriv_mjpeg_bits_dc_chrominance,
-              avpriv_mjpeg_val_dc, 12, 0, 0);
-    build_vlc(&s->vlcs[1][0], avpriv_mjpeg_bits_ac_luminance,
-              avpriv_mjpeg_val_ac_luminance, 251, 0, 1);
-    build_vlc(&s->vlcs[1][1], avpriv_mjpeg_bits_ac_chrominance,
-              avpriv_mjpeg_val_ac_chrominance, 251, 0, 1);
-    build_vlc(&s->vlcs[2][0], avpriv_mjpeg_bits_ac_luminance,
-              avpriv_mjpeg_val_ac_luminance, 251, 0, 0);
-    build_vlc(&s->vlcs[2][1], avpriv_mjpeg_bits_ac_chrominance,
-              avpriv_mjpeg_val_ac_chrominance, 251, 0, 0);
+    build_shared_vlc(s, 0, 0, avpriv_mjpeg_bits_dc_luminance,
+                     avpriv_mjpeg_val_dc, 12, 0);
+    build_shared_vlc(s, 0, 1, avpriv_mjpeg_bits_dc_chrominance,
+                     avpriv_mjpeg_val_dc, 12, 0);
+    build_shared_vlc(s, 1, 0, avpriv_mjpeg_bits_ac_luminance,
+                     avpriv_mjpeg_val_ac_luminance, 251, 1);
+    build_shared_vlc(s, 1, 1, avpriv_mjpeg_bits_ac_chrominance,
+                     avpriv_mjpeg_val_ac_chrominance, 251, 1);
+    build_shared_vlc(s, 2, 0, avpriv_mjpeg_bits_ac_luminance,
+                     avpriv_mjpeg_val_ac_luminance, 251, 0);
+    build_shared_vlc(s, 2, 1, avpriv_mjpeg_bits_ac_chrominance,
+                     avpriv_mjpeg_val_ac_chrominance, 251, 0);
 }
 
 static void parse_avid(MJpegDecodeContext *s, uint8_t *buf, int len)
@@ -220,17 +252,15 @@ int ff_mjpeg_decode_dht(MJpegDecodeContext *s)
         len -= n;
 
         /* build VLC and flush previous vlc if present */
-        ff_free_vlc(&s->vlcs[class][index]);
         av_log(s->avctx, AV_LOG_DEBUG, "class=%d index=%d nb_codes=%d\n",
                class, index, code_max + 1);
-        if ((ret = build_vlc(&s->vlcs[class][index], bits_table, val_table,
-                             code_max + 1, 0, class > 0)) < 0)
+        if ((ret = build_shared_vlc(s, class, index, bits_table, val_table,
+                                    code_max + 1, class > 0)) < 0)
             return ret;
 
         if (class > 0) {
-            ff_free_vlc(&s->vlcs[2][index]);
-            if ((ret = build_vlc(&s->vlcs[2][index], bits_table, val_table,
-                                 code_max + 1, 0, 0)) < 0)
+            if ((ret = build_shared_vlc(s, 2, index, bits_table, val_table,
+                                        code_max + 1, 0)) < 0)
                 return ret;
         }
     }
@@ -242,6 +272,7 @@ int ff_mjpeg_decode_sof(MJpegDecodeContext *s)
     int len, nb_components, i, width, height, pix_fmt_id, ret;
     int h_count[MAX_COMPONENTS];
     int v_count[MAX_COMPONENTS];
+    ThreadFrame frame = { .f = s->picture_ptr };
 
     s->cur_scan = 0;
     s->upscale_h = s->upscale_v = 0;
@@ -532,7 +563,7 @@ unk_pixfmt:
     }
 
     av_frame_unref(s->picture_ptr);
-    if (ff_get_buffer(s->avctx, s->picture_ptr, AV_GET_BUFFER_FLAG_REF) < 0)
+    if (ff_thread_get_buffer(s->avctx, &frame, AV_GET_BUFFER_FLAG_REF) < 0)
         return -1;
     s->picture_ptr->pict_type = AV_PICTURE_TYPE_I;
     s->picture_ptr->key_frame = 1;
@@ -573,10 +604,11 @@ unk_pixfmt:
     return 0;
 }
 
-static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
+static inline int mjpeg_decode_dc(MJpegDecodeContext *s, GetBitContext *gb,
+                                  int dc_index)
 {
     int code;
-    code = get_vlc2(&s->gb, s->vlcs[0][dc_index].table, 9, 2);
+    code = get_vlc2(gb, s->vlcs[0][dc_index].table, 9, 2);
     if (code < 0 || code > 16) {
         av_log(s->avctx, AV_LOG_WARNING,
                "mjpeg_decode_dc: bad vlc: %d:%d (%p)\n",
@@ -585,46 +617,47 @@ static inline int mjpeg_decode_dc(MJpegDecodeContext *s, int dc_index)
     }
 
     if (code)
-        return get_xbits(&s->gb, code);
+        return get_xbits(gb, code);
     else
         return 0;
 }
 
 /* decode block and dequantize */
-static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
+static int decode_block(MJpegDecodeContext *s, GetBitContext *gb, int *last_dc,
+                        int16_t *block, int component,
                         int dc_index, int ac_index, int16_t *quant_matrix)
 {
     int code, i, j, level, val;
 
     /* DC coef */
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
     }
-    val = val * quant_matrix[0] + s->last_dc[component];
-    s->last_dc[component] = val;
+    val = val * quant_matrix[0] + last_dc[component];
+    last_dc[component] = val;
     block[0] = val;
     /* AC coefs */
     i = 0;
-    {OPEN_READER(re, &s->gb);
+    {OPEN_READER(re, gb);
     do {
-        UPDATE_CACHE(re, &s->gb);
-        GET_VLC(code, re, &s->gb, s->vlcs[1][ac_index].table, 9, 2);
+        UPDATE_CACHE(re, gb);
+        GET_VLC(code, re, gb, s->vlcs[1][ac_index].table, 9, 2);
 
         i += ((unsigned)code) >> 4;
             code &= 0xf;
         if (code) {
             if (code > MIN_CACHE_BITS - 16)
-                UPDATE_CACHE(re, &s->gb);
+                UPDATE_CACHE(re, gb);
 
             {
-                int cache = GET_CACHE(re, &s->gb);
+                int cache = GET_CACHE(re, gb);
                 int sign  = (~cache) >> 31;
                 level     = (NEG_USR32(sign ^ cache,code) ^ sign) - sign;
             }
 
-            LAST_SKIP_BITS(re, &s->gb, code);
+            LAST_SKIP_BITS(re, gb, code);
 
             if (i > 63) {
                 av_log(s->avctx, AV_LOG_ERROR, "error count: %d\n", i);
@@ -634,7 +667,7 @@ static int decode_block(MJpegDecodeContext *s, int16_t *block, int component,
             block[j] = level * quant_matrix[j];
         }
     } while (i < 63);
-    CLOSE_READER(re, &s->gb);}
+    CLOSE_READER(re, gb);}
 
     return 0;
 }
@@ -645,7 +678,7 @@ static int decode_dc_progressive(MJpegDecodeContext *s, int16_t *block,
 {
     int val;
     s->dsp.clear_block(block);
-    val = mjpeg_decode_dc(s, dc_index);
+    val = mjpeg_decode_dc(s, &s->gb, dc_index);
     if (val == 0xfffff) {
         av_log(s->avctx, AV_LOG_ERROR, "error dc\n");
         return AVERROR_INVALIDDATA;
@@ -909,7 +942,7 @@ static int ljpeg_decode_rgb_scan(MJpegDecodeContext *s, int nb_components, int p
 
                 PREDICT(pred, topleft[i], top[i], left[i], modified_predictor);
 
-                dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                 if(dc == 0xFFFFF)
                     return -1;
 
@@ -1010,7 +1043,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for(j=0; j<n; j++) {
                         int pred, dc;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if(bits<=8){
@@ -1078,7 +1111,7 @@ static int ljpeg_decode_yuv_scan(MJpegDecodeContext *s, int predictor,
                     for (j = 0; j < n; j++) {
                         int pred;
 
-                        dc = mjpeg_decode_dc(s, s->dc_index[i]);
+                        dc = mjpeg_decode_dc(s, &s->gb, s->dc_index[i]);
                         if(dc == 0xFFFFF)
                             return -1;
                         if(bits<=8){
@@ -1144,6 +1177,92 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
+/* decode, dequantize and output one block of a sequential scan */
+static int decode_block_put(MJpegDecodeContext *s, GetBitContext *gb,
+                            int *last_dc, int16_t *block, int i,
+                            uint8_t *ptr, int linesize)
+{
+    s->dsp.clear_block(block);
+    if (decode_block(s, gb, last_dc, block, i,
+                     s->dc_index[i], s->ac_index[i],
+                     s->quant_matrixes[s->quant_sindex[i]]) < 0)
+        return AVERROR_INVALIDDATA;
+    s->dsp.idct_put(ptr, linesize, block);
+    if (s->bits & 7)
+        shift_output(s, ptr, linesize);
+    return 0;
+}
+
+/**
+ * Decode one restart interval of a sequential scan.
+ * Every interval starts with reset DC predictors at a byte position
+ * recorded while unescaping the scan, so the intervals can be decoded
+ * independently of each other.
+ */
+static int mjpeg_decode_scan_interval(AVCodecContext *avctx, void *arg,
+                                      int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+    const int nb_components   = *(int *)arg;
+    const int bytes_per_pixel = 1 + (s->bits > 8);
+    const int nb_mbs  = s->mb_width * s->mb_height;
+    const int mb_end  = FFMIN((jobnr + 1) * s->restart_interval, nb_mbs);
+    const uint8_t *buf_end = s->gb.buffer_end;
+    const uint8_t *buf;
+    int last_dc[MAX_COMPONENTS];
+    GetBitContext gb;
+    int i, mb;
+    LOCAL_ALIGNED_16(int16_t, block, [64]);
+
+    if (jobnr)
+        buf = s->gb.buffer + s->restart_pos[jobnr - 1];
+    else
+        buf = s->gb.buffer + (get_bits_count(&s->gb) >> 3);
+    if (jobnr < s->nb_restart_pos)
+        buf_end = s->gb.buffer + s->restart_pos[jobnr];
+    init_get_bits8(&gb, buf, buf_end - buf);
+
+    for (i = 0; i < nb_components; i++)
+        last_dc[i] = 4 << s->bits;
+
+    for (mb = jobnr * s->restart_interval; mb < mb_end; mb++) {
+        int mb_x = mb % s->mb_width;
+        int mb_y = mb / s->mb_width;
+
+        if (get_bits_left(&gb) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "overread %d\n", -get_bits_left(&gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            int c = s->comp_index[i];
+            int h = s->h_scount[i];
+            int v = s->v_scount[i];
+            int x = 0, y = 0, j;
+
+            for (j = 0; j < s->nb_blocks[i]; j++) {
+                int block_offset = (((s->linesize[c] * (v * mb_y + y) * 8) +
+                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> avctx->lowres);
+                uint8_t *ptr;
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += s->linesize[c] >> 1;
+                ptr = s->picture_ptr->data[c] + block_offset;
+                if (decode_block_put(s, &gb, last_dc, block, i,
+                                     ptr, s->linesize[c]) < 0) {
+                    av_log(avctx, AV_LOG_ERROR,
+                           "error y=%d x=%d\n", mb_y, mb_x);
+                    return AVERROR_INVALIDDATA;
+                }
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
 static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                              int Al, const uint8_t *mb_bitmask,
                              int mb_bitmask_size,
@@ -1174,6 +1293,33 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         s->coefs_finished[c] |= 1;
     }
 
+    /* restart intervals of a baseline scan can be decoded in parallel
+     * if all of their restart markers were found, some encoders also
+     * terminate the last interval with one */
+    if (!s->progressive && !mb_bitmask && s->restart_interval &&
+        (s->avctx->active_thread_type & FF_THREAD_SLICE) &&
+        s->avctx->codec_id != AV_CODEC_ID_THP) {
+        int nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                           s->restart_interval;
+        if (nb_intervals > 1 &&
+            (s->nb_restart_pos == nb_intervals - 1 ||
+             s->nb_restart_pos == nb_intervals)) {
+            av_fast_malloc(&s->restart_ret, &s->restart_ret_size,
+                           nb_intervals * sizeof(*s->restart_ret));
+            if (!s->restart_ret)
+                return AVERROR(ENOMEM);
+            s->avctx->execute2(s->avctx, mjpeg_decode_scan_interval,
+                               &nb_components, s->restart_ret, nb_intervals);
+            /* let the marker search continue from the last interval */
+            skip_bits_long(&s->gb, s->restart_pos[nb_intervals - 2] * 8 -
+                                   get_bits_count(&s->gb));
+            for (i = 0; i < nb_intervals; i++)
+                if (s->restart_ret[i] < 0)
+                    return s->restart_ret[i];
+            return 0;
+        }
+    }
+
     for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
         for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
             const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
@@ -1208,18 +1354,11 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
                             mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
                                              linesize[c], s->avctx->lowres);
 
-                        else {
-                            s->dsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            s->dsp.idct_put(ptr, linesize[c], s->block);
-                            if (s->bits & 7)
-                                shift_output(s, ptr, linesize[c]);
+                        else if (decode_block_put(s, &s->gb, s->last_dc, s->block,
+                                                  i, ptr, linesize[c]) < 0) {
+                            av_log(s->avctx, AV_LOG_ERROR,
+                                   "error y=%d x=%d\n", mb_y, mb_x);
+                            return AVERROR_INVALIDDATA;
                         }
                     } else {
                         int block_idx  = s->block_stride[c] * (v * mb_y + y) +
@@ -1775,6 +1914,23 @@ found:
     return val;
 }
 
+/* remember where the entropy coded data after a RSTn marker starts */
+static int record_restart_pos(MJpegDecodeContext *s, int pos)
+{
+    if (s->nb_restart_pos >= s->restart_pos_size / sizeof(*s->restart_pos)) {
+        int *tmp;
+        if (s->nb_restart_pos >= INT_MAX / 2 / sizeof(*s->restart_pos))
+            return AVERROR(ENOMEM);
+        tmp = av_fast_realloc(s->restart_pos, &s->restart_pos_size,
+                              2 * (s->nb_restart_pos + 1) * sizeof(*s->restart_pos));
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        s->restart_pos = tmp;
+    }
+    s->restart_pos[s->nb_restart_pos++] = pos;
+    return 0;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -1792,6 +1948,7 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
         const uint8_t *src = *buf_ptr;
         uint8_t *dst = s->buffer;
 
+        s->nb_restart_pos = 0;
         while (src < buf_end) {
             uint8_t x = *(src++);
 
@@ -1801,9 +1958,11 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                     while (src < buf_end && x == 0xff)
                         x = *(src++);
 
-                    if (x >= 0xd0 && x <= 0xd7)
+                    if (x >= 0xd0 && x <= 0xd7) {
                         *(dst++) = x;
-                    else if (x)
+                        if (record_restart_pos(s, dst - s->buffer) < 0)
+                            return AVERROR(ENOMEM);
+                    } else if (x)
                         break;
                 }
             }
@@ -1861,6 +2020,27 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     return start_code;
 }
 
+/**
+ * Check whether only the entropy coded data of a scan, restart markers
+ * and EOI follow, i.e. nothing left in the packet can change the decoder
+ * state another frame thread copies from us.
+ */
+static int is_last_scan(const uint8_t *buf, const uint8_t *buf_end)
+{
+    /* skip the scan header */
+    if (buf_end - buf < 2 || (buf += AV_RB16(buf)) >= buf_end)
+        return 1;
+    while (buf_end - buf > 1) {
+        buf = memchr(buf, 0xff, buf_end - buf - 1);
+        if (!buf)
+            break;
+        buf++;
+        if (*buf != 0x00 && *buf != 0xff && (*buf & 0xf8) != 0xd0)
+            return *buf == EOI;
+    }
+    return 1;
+}
+
 int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
                           AVPacket *avpkt)
 {
@@ -1874,6 +2054,7 @@ int ff_mjpeg_decode_frame(AVCodecContext *avctx, void *data, int *got_frame,
     int unescaped_buf_size;
     int start_code;
     int i, index;
+    int setup_finished = 0;
     int ret = 0;
 
     av_dict_free(&s->exif_metadata);
@@ -2015,6 +2196,11 @@ eoi_parser:
             goto the_end;
         case SOS:
             s->cur_scan++;
+            if (!s->interlaced && !setup_finished &&
+                is_last_scan(buf_ptr, buf_end)) {
+                ff_thread_finish_setup(avctx);
+                setup_finished = 1;
+            }
             if ((ret = ff_mjpeg_decode_sos(s, NULL, 0, NULL)) < 0 &&
                 (avctx->err_recognition & AV_EF_EXPLODE))
                 goto fail;
@@ -2203,13 +2389,17 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
         av_frame_unref(s->picture_ptr);
 
     av_freep(&s->buffer);
+    av_freep(&s->restart_pos);
+    s->restart_pos_size = 0;
+    av_freep(&s->restart_ret);
+    s->restart_ret_size = 0;
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
 
     for (i = 0; i < 3; i++) {
         for (j = 0; j < 4; j++)
-            ff_free_vlc(&s->vlcs[i][j]);
+            free_shared_vlc(s, i, j);
     }
     for (i = 0; i < MAX_COMPONENTS; i++) {
         av_freep(&s->blocks[i]);
@@ -2219,6 +2409,84 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int mjpeg_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    MJpegDecodeContext *s = avctx->priv_data;
+
+    /* the tables and the picture still belong to the first thread */
+    memset(s->vlcs,     0, sizeof(s->vlcs));
+    memset(s->vlc_bufs, 0, sizeof(s->vlc_bufs));
+    s->picture     =
+    s->picture_ptr = NULL;
+    s->restart_pos      = NULL;
+    s->restart_pos_size = 0;
+    s->restart_ret      = NULL;
+    s->restart_ret_size = 0;
+
+    return ff_mjpeg_decode_init(avctx);
+}
+
+static int mjpeg_decode_update_thread_context(AVCodecContext *dst,
+                                              const AVCodecContext *src)
+{
+    MJpegDecodeContext *s = dst->priv_data, *s1 = src->priv_data;
+    int i, j, ret;
+
+    if (dst == src)
+        return 0;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 4; j++) {
+            if (s->vlc_bufs[i][j] && s1->vlc_bufs[i][j] &&
+                s->vlc_bufs[i][j]->buffer == s1->vlc_bufs[i][j]->buffer)
+                continue;
+            free_shared_vlc(s, i, j);
+            if (!s1->vlc_bufs[i][j])
+                continue;
+            s->vlc_bufs[i][j] = av_buffer_ref(s1->vlc_bufs[i][j]);
+            if (!s->vlc_bufs[i][j])
+                return AVERROR(ENOMEM);
+            s->vlcs[i][j] = s1->vlcs[i][j];
+        }
+    }
+    memcpy(s->quant_matrixes, s1->quant_matrixes, sizeof(s->quant_matrixes));
+    memcpy(s->qscale,         s1->qscale,         sizeof(s->qscale));
+
+    s->first_picture      = s1->first_picture;
+    s->width              = s1->width;
+    s->height             = s1->height;
+    memcpy(s->h_count, s1->h_count, sizeof(s->h_count));
+    memcpy(s->v_count, s1->v_count, sizeof(s->v_count));
+    s->nb_components      = s1->nb_components;
+    s->interlaced         = s1->interlaced;
+    s->bottom_field       = s1->bottom_field;
+    s->interlace_polarity = s1->interlace_polarity;
+
+    s->buggy_avid         = s1->buggy_avid;
+    s->cs_itu601          = s1->cs_itu601;
+    s->pegasus_rct        = s1->pegasus_rct;
+    s->rct                = s1->rct;
+    s->colr               = s1->colr;
+    s->xfrm               = s1->xfrm;
+    s->palette_index      = s1->palette_index;
+
+    /* the second field of an interlaced picture is coded in the next
+     * packet and has to be decoded into the picture of the first one */
+    av_frame_unref(s->picture_ptr);
+    s->got_picture = 0;
+    if (s1->interlaced && s1->got_picture &&
+        s1->bottom_field == !s1->interlace_polarity) {
+        if ((ret = av_frame_ref(s->picture_ptr, s1->picture_ptr)) < 0)
+            return ret;
+        memcpy(s->linesize, s1->linesize, sizeof(s->linesize));
+        s->pix_desc    = s1->pix_desc;
+        s->rgb         = s1->rgb;
+        s->got_picture = 1;
+    }
+
+    return 0;
+}
+
 static void decode_flush(AVCodecContext *avctx)
 {
     MJpegDecodeContext *s = avctx->priv_data;
@@ -2251,7 +2519,10 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = CODEC_CAP_DR1,
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(mjpeg_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(mjpeg_decode_update_thread_context),
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_FRAME_THREADS |
+                      CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
 };
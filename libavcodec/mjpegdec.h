@@ -51,6 +51,7 @@ typedef struct MJpegDecodeContext {
 
     int16_t quant_matrixes[4][64];
     VLC vlcs[3][4];
+    AVBufferRef *vlc_bufs[3][4]; ///< owners of the vlcs tables, shared with other frame threads
     int qscale[4];      ///< quantizer scale calculated from quant_matrixes
 
     int org_height;  /* size given at codec init */
@@ -109,6 +110,11 @@ typedef struct MJpegDecodeContext {
 
     int restart_interval;
     int restart_count;
+    int *restart_pos;       ///< offsets of the data following each RSTn in the unescaped scan
+    int nb_restart_pos;
+    unsigned int restart_pos_size;
+    int *restart_ret;       ///< results of the restart intervals decoded in parallel
+    unsigned int restart_ret_size;
 
     int buggy_avid;
     int cs_itu601;
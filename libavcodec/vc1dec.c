@@ -37,6 +37,7 @@
 #include "vc1data.h"
 #include "vc1acdata.h"
 #include "msmpeg4data.h"
+#include "thread.h"
 #include "unary.h"
 #include "mathops.h"
 #include "vdpau_internal.h"
@@ -4743,6 +4744,47 @@ static int vc1_decode_b_mb_intfr(VC1Context *v)
     return 0;
 }
 
+/** Report to other frame threads that all MB rows of the current picture
+ * up to and including mb_y are final.
+ * Field pictures are only reported as a whole by ff_MPV_frame_end().
+ */
+static void vc1_report_progress(VC1Context *v, int mb_y)
+{
+    MpegEncContext *s = &v->s;
+
+    if (HAVE_THREADS && (s->avctx->active_thread_type & FF_THREAD_FRAME) &&
+        !v->field_mode && s->pict_type != AV_PICTURE_TYPE_B &&
+        !s->er.error_occurred && mb_y >= 0)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, mb_y, 0);
+}
+
+/** Wait until the reference pictures are decoded far enough to do motion
+ * compensation for the current MB row, taking the MV range into account.
+ */
+static void vc1_await_references(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+    int mb_y;
+
+    if (!HAVE_THREADS || !(s->avctx->active_thread_type & FF_THREAD_FRAME))
+        return;
+
+    if (v->field_mode) {
+        mb_y = INT_MAX;
+    } else {
+        /* field MVs of interlaced frames are in field lines; 31 accounts
+         * for the MB itself, the bicubic filter taps and rounding */
+        int range = (v->range_y >> 2) << (v->fcm == ILACE_FRAME);
+        mb_y = FFMIN(s->mb_y + (range + 31 >> 4), s->mb_height - 1);
+    }
+
+    if (s->last_picture_ptr && s->last_picture_ptr->f->buf[0])
+        ff_thread_await_progress(&s->last_picture_ptr->tf, mb_y, 0);
+    if (s->pict_type == AV_PICTURE_TYPE_B &&
+        s->next_picture_ptr && s->next_picture_ptr->f->buf[0])
+        ff_thread_await_progress(&s->next_picture_ptr->tf, mb_y, 0);
+}
+
 /** Decode blocks of I-frame
  */
 static void vc1_decode_i_blocks(VC1Context *v)
@@ -4872,11 +4914,15 @@ static void vc1_decode_i_blocks(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+        /* overlap smoothing and the loop filter alter the bottom lines of the
+         * previous row */
+        vc1_report_progress(v, s->mb_y - 1);
 
         s->first_slice_line = 0;
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
+    vc1_report_progress(v, s->end_mb_y - 1);
 
     /* This is intentionally mb_height and not end_mb_y - unlike in advanced
      * profile, these only differ are when decoding MSS2 rectangles. */
@@ -5000,6 +5046,8 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
             ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_mpeg_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        /* pixels are put one row and loop filtered two rows behind */
+        vc1_report_progress(v, s->mb_y - 1 - !!v->s.loop_filter);
         s->first_slice_line = 0;
     }
 
@@ -5015,6 +5063,7 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
     }
     if (v->s.loop_filter)
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y-1)*16, 16);
+    vc1_report_progress(v, s->end_mb_y - 1);
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
 }
@@ -5056,6 +5105,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
         s->mb_x = 0;
         init_block_index(v);
+        vc1_await_references(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
             ff_update_block_index(s);
 
@@ -5078,7 +5128,10 @@ static void vc1_decode_p_blocks(VC1Context *v)
         memmove(v->ttblk_base,    v->ttblk,    sizeof(v->ttblk_base[0])    * s->mb_stride);
         memmove(v->is_intra_base, v->is_intra, sizeof(v->is_intra_base[0]) * s->mb_stride);
         memmove(v->luma_mv_base,  v->luma_mv,  sizeof(v->luma_mv_base[0])  * s->mb_stride);
-        if (s->mb_y != s->start_mb_y) ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+        if (s->mb_y != s->start_mb_y) {
+            ff_mpeg_draw_horiz_band(s, (s->mb_y - 1) * 16, 16);
+            vc1_report_progress(v, s->mb_y - 1);
+        }
         s->first_slice_line = 0;
     }
     if (apply_loop_filter) {
@@ -5089,8 +5142,10 @@ static void vc1_decode_p_blocks(VC1Context *v)
             vc1_apply_p_loop_filter(v);
         }
     }
-    if (s->end_mb_y >= s->start_mb_y)
+    if (s->end_mb_y >= s->start_mb_y) {
         ff_mpeg_draw_horiz_band(s, (s->end_mb_y - 1) * 16, 16);
+        vc1_report_progress(v, s->end_mb_y - 1);
+    }
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
 }
@@ -5128,6 +5183,7 @@ static void vc1_decode_b_blocks(VC1Context *v)
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
         s->mb_x = 0;
         init_block_index(v);
+        vc1_await_references(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
             ff_update_block_index(s);
 
@@ -5171,10 +5227,12 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         s->mb_x = 0;
         init_block_index(v);
         ff_update_block_index(s);
+        vc1_await_references(v);
         memcpy(s->dest[0], s->last_picture.f->data[0] + s->mb_y * 16 * s->linesize,   s->linesize   * 16);
         memcpy(s->dest[1], s->last_picture.f->data[1] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         memcpy(s->dest[2], s->last_picture.f->data[2] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         ff_mpeg_draw_horiz_band(s, s->mb_y * 16, 16);
+        vc1_report_progress(v, s->mb_y);
         s->first_slice_line = 0;
     }
     s->pict_type = AV_PICTURE_TYPE_P;
@@ -5626,6 +5684,8 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
 
     ff_h264chroma_init(&v->h264chroma, 8);
 
+    avctx->internal->allocate_progress = 1;
+
     if (avctx->codec_id == AV_CODEC_ID_WMV3 || avctx->codec_id == AV_CODEC_ID_WMV3IMAGE) {
         int count = 0;
 
@@ -5736,21 +5796,12 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
-/** Close a VC1/WMV3 decoder
- * @warning Initial try at using MpegEncContext stuff
- */
-av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
+static av_cold void vc1_decode_free_tables(VC1Context *v)
 {
-    VC1Context *v = avctx->priv_data;
     int i;
 
-    av_frame_free(&v->sprite_output_frame);
-
     for (i = 0; i < 4; i++)
         av_freep(&v->sr_rows[i >> 1][i & 1]);
-    av_freep(&v->hrd_rate);
-    av_freep(&v->hrd_buffer);
-    ff_MPV_common_end(&v->s);
     av_freep(&v->mv_type_mb_plane);
     av_freep(&v->direct_mb_plane);
     av_freep(&v->forward_mb_plane);
@@ -5767,6 +5818,104 @@ av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
     av_freep(&v->is_intra_base); // FIXME use v->mb_type[]
     av_freep(&v->luma_mv_base);
     ff_intrax8_common_end(&v->x8);
+}
+
+/** Close a VC1/WMV3 decoder
+ * @warning Initial try at using MpegEncContext stuff
+ */
+av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+
+    av_frame_free(&v->sprite_output_frame);
+
+    av_freep(&v->hrd_rate);
+    av_freep(&v->hrd_buffer);
+    ff_MPV_common_end(&v->s);
+    vc1_decode_free_tables(v);
+    return 0;
+}
+
+static av_cold int vc1_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+
+    v->s.avctx = avctx;
+
+    /* the tables and the MpegEncContext are set up on the first
+     * update_thread_context() or decode call */
+    v->sprite_output_frame = av_frame_alloc();
+    if (!v->sprite_output_frame)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static int vc1_update_thread_context(AVCodecContext *dst,
+                                     const AVCodecContext *src)
+{
+    VC1Context *v = dst->priv_data, *v1 = src->priv_data;
+    MpegEncContext *s = &v->s, *s1 = &v1->s;
+    int realloc_tables, ret;
+
+    if (dst == src || !s1->context_initialized)
+        return 0;
+
+    realloc_tables = !s->context_initialized ||
+                     s->width != s1->width || s->height != s1->height;
+
+    if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+        return ret;
+
+    if (realloc_tables) {
+        vc1_decode_free_tables(v);
+        if ((ret = ff_vc1_decode_init_alloc_tables(v)) < 0)
+            return ret;
+    }
+
+    s->h_edge_pos  = s1->h_edge_pos;
+    s->v_edge_pos  = s1->v_edge_pos;
+    s->loop_filter = s1->loop_filter;
+
+    /* entry point header, may be repeated in-band */
+    v->broken_link      = v1->broken_link;
+    v->closed_entry     = v1->closed_entry;
+    v->panscanflag      = v1->panscanflag;
+    v->refdist_flag     = v1->refdist_flag;
+    v->fastuvmc         = v1->fastuvmc;
+    v->extended_mv      = v1->extended_mv;
+    v->extended_dmv     = v1->extended_dmv;
+    v->dquant           = v1->dquant;
+    v->vstransform      = v1->vstransform;
+    v->overlap          = v1->overlap;
+    v->quantizer_mode   = v1->quantizer_mode;
+    v->range_mapy_flag  = v1->range_mapy_flag;
+    v->range_mapy       = v1->range_mapy;
+    v->range_mapuv_flag = v1->range_mapuv_flag;
+    v->range_mapuv      = v1->range_mapuv;
+
+    /* intensity compensation of the reference pictures */
+    v->last_use_ic = v1->last_use_ic;
+    v->next_use_ic = v1->next_use_ic;
+    v->aux_use_ic  = v1->aux_use_ic;
+    memcpy(v->last_luty,  v1->last_luty,  sizeof(v->last_luty));
+    memcpy(v->last_lutuv, v1->last_lutuv, sizeof(v->last_lutuv));
+    memcpy(v->next_luty,  v1->next_luty,  sizeof(v->next_luty));
+    memcpy(v->next_lutuv, v1->next_lutuv, sizeof(v->next_lutuv));
+    memcpy(v->aux_luty,   v1->aux_luty,   sizeof(v->aux_luty));
+    memcpy(v->aux_lutuv,  v1->aux_lutuv,  sizeof(v->aux_lutuv));
+
+    /* field MV flags of the next anchor, used by field B pictures; field
+     * pictures only finish setup once decoding is done, so these are final */
+    v->refdist = v1->refdist;
+    if (v->interlace) {
+        int mb_height = FFALIGN(s->mb_height, 2);
+        int size      = 2 * (s->b8_stride * (mb_height * 2 + 1) +
+                             s->mb_stride * (mb_height + 1) * 2);
+        memcpy(v->mv_f_next[0] - s->b8_stride - 1,
+               v1->mv_f_next[0] - s1->b8_stride - 1, size);
+    }
+
     return 0;
 }
 
@@ -5784,7 +5933,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     AVFrame *pict = data;
     uint8_t *buf2 = NULL;
     const uint8_t *buf_start = buf, *buf_start_second_field = NULL;
-    int mb_height, n_slices1=-1;
+    int mb_height, n_slices1=-1, frame_started = 0;
     struct {
         uint8_t *buf;
         GetBitContext gb;
@@ -6020,6 +6169,7 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     v->s.current_picture_ptr->field_picture = v->field_mode;
     v->s.current_picture_ptr->f->interlaced_frame = (v->fcm != PROGRESSIVE);
     v->s.current_picture_ptr->f->top_field_first  = v->tff;
+    frame_started = 1;
 
     // process pulldown flags
     s->current_picture_ptr->f->repeat_pict = 0;
@@ -6036,6 +6186,12 @@ static int vc1_decode_frame(AVCodecContext *avctx, void *data,
     s->me.qpel_put = s->dsp.put_qpel_pixels_tab;
     s->me.qpel_avg = s->dsp.avg_qpel_pixels_tab;
 
+    /* field pictures update the MV flags and intensity compensation state
+     * used by the following pictures while decoding, so other frame threads
+     * may only start once they are done */
+    if (!v->field_mode && !avctx->hwaccel)
+        ff_thread_finish_setup(avctx);
+
     if ((CONFIG_VC1_VDPAU_DECODER)
         &&s->avctx->codec->capabilities&CODEC_CAP_HWACCEL_VDPAU) {
         if (v->field_mode && buf_start_second_field) {
@@ -6218,6 +6374,8 @@ end:
     return buf_size;
 
 err:
+    if (HAVE_THREADS && frame_started)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, INT_MAX, 0);
     av_free(buf2);
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
@@ -6258,9 +6416,11 @@ AVCodec ff_vc1_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
-    .profiles       = NULL_IF_CONFIG_SMALL(profiles)
+    .profiles       = NULL_IF_CONFIG_SMALL(profiles),
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
 };
 
 #if CONFIG_WMV3_DECODER
@@ -6274,9 +6434,11 @@ AVCodec ff_wmv3_decoder = {
     .close          = ff_vc1_decode_end,
     .decode         = vc1_decode_frame,
     .flush          = ff_mpeg_flush,
-    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    .capabilities   = CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     .pix_fmts       = vc1_hwaccel_pixfmt_list_420,
-    .profiles       = NULL_IF_CONFIG_SMALL(profiles)
+    .profiles       = NULL_IF_CONFIG_SMALL(profiles),
+    .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context),
 };
 #endif
 
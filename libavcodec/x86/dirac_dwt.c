@@ -20,7 +20,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/cpu.h"
 #include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
 #include "dsputil_x86.h"
 #include "dirac_dwt.h"
 
@@ -131,7 +133,350 @@ static void horizontal_compose_dd97i_ssse3(IDWTELEM *b, IDWTELEM *tmp, int w)
 }
 #endif
 
-void ff_spatial_idwt_init_mmx(DWTContext *d, enum dwt_type type)
+#if HAVE_SSE4_INLINE
+/*
+ * The SSE4 and AVX2 functions give the same results as the C code for any
+ * input: the sums that are shifted are computed without overflow, either in
+ * 32 bits or with (a + b) >> 1 == (a >> 1) + (b >> 1) + (a & b & 1), and the
+ * other operations wrap around like the final conversion to IDWTELEM does.
+ */
+
+DECLARE_ALIGNED(32, static const int16_t, pw_1)[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+DECLARE_ALIGNED(32, static const int16_t, pw_9)[16] = {
+    9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9
+};
+DECLARE_ALIGNED(32, static const int16_t, pw_m1)[16] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+DECLARE_ALIGNED(32, static const int32_t, pd_8)[8] = {
+    8, 8, 8, 8, 8, 8, 8, 8
+};
+DECLARE_ALIGNED(32, static const int32_t, pd_16)[8] = {
+    16, 16, 16, 16, 16, 16, 16, 16
+};
+
+static void vertical_compose53iL0_sse4(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                       int width)
+{
+    int i, width_align = width & ~7;
+
+    for (i = 0; i < width_align; i += 8)
+        __asm__ volatile(
+            "movdqu          (%0), %%xmm0               \n\t"
+            "movdqu          (%2), %%xmm1               \n\t"
+            "movdqa        %%xmm1, %%xmm2               \n\t"
+            "pand          %%xmm0, %%xmm2               \n\t"
+            "pand              %3, %%xmm2               \n\t"
+            "psraw             $1, %%xmm0               \n\t"
+            "psraw             $1, %%xmm1               \n\t"
+            "paddw         %%xmm1, %%xmm0               \n\t"
+            "paddw         %%xmm2, %%xmm0               \n\t" // (b0 + b2) >> 1
+            "movdqa        %%xmm0, %%xmm1               \n\t"
+            "pand              %3, %%xmm1               \n\t"
+            "psraw             $1, %%xmm0               \n\t"
+            "paddw         %%xmm1, %%xmm0               \n\t" // (b0 + b2 + 2) >> 2
+            "movdqu          (%1), %%xmm1               \n\t"
+            "psubw         %%xmm0, %%xmm1               \n\t"
+            "movdqu        %%xmm1, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+
+    for (i = width_align; i < width; i++)
+        b1[i] = COMPOSE_53iL0(b0[i], b1[i], b2[i]);
+}
+
+static void vertical_compose_dirac53iH0_sse4(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                             int width)
+{
+    int i, width_align = width & ~7;
+
+    for (i = 0; i < width_align; i += 8)
+        __asm__ volatile(
+            "movdqu          (%0), %%xmm0               \n\t"
+            "movdqu          (%2), %%xmm1               \n\t"
+            "movdqa        %%xmm1, %%xmm2               \n\t"
+            "por           %%xmm0, %%xmm2               \n\t"
+            "pand              %3, %%xmm2               \n\t"
+            "psraw             $1, %%xmm0               \n\t"
+            "psraw             $1, %%xmm1               \n\t"
+            "paddw         %%xmm1, %%xmm0               \n\t"
+            "paddw         %%xmm2, %%xmm0               \n\t" // (b0 + b2 + 1) >> 1
+            "movdqu          (%1), %%xmm1               \n\t"
+            "paddw         %%xmm1, %%xmm0               \n\t"
+            "movdqu        %%xmm0, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+
+    for (i = width_align; i < width; i++)
+        b1[i] = COMPOSE_DIRAC53iH0(b0[i], b1[i], b2[i]);
+}
+
+/*
+ * xmm0 = (-b0 + 9*b1 + 9*b3 - b4 + rnd) >> shift, as words
+ * pblendw clears the high half of each dword so that packusdw keeps
+ * the low 16 bits instead of saturating.
+ */
+#define COMPOSE_DD_SSE4(shift)                                          \
+    "movdqu          (%1), %%xmm0               \n\t"                   \
+    "movdqu          (%3), %%xmm1               \n\t"                   \
+    "movdqa        %%xmm0, %%xmm2               \n\t"                   \
+    "punpckhwd     %%xmm1, %%xmm2               \n\t"                   \
+    "punpcklwd     %%xmm1, %%xmm0               \n\t"                   \
+    "pmaddwd           %5, %%xmm0               \n\t"                   \
+    "pmaddwd           %5, %%xmm2               \n\t"                   \
+    "movdqu          (%0), %%xmm1               \n\t"                   \
+    "movdqu          (%4), %%xmm3               \n\t"                   \
+    "movdqa        %%xmm1, %%xmm4               \n\t"                   \
+    "punpckhwd     %%xmm3, %%xmm4               \n\t"                   \
+    "punpcklwd     %%xmm3, %%xmm1               \n\t"                   \
+    "pmaddwd           %6, %%xmm1               \n\t"                   \
+    "pmaddwd           %6, %%xmm4               \n\t"                   \
+    "paddd         %%xmm1, %%xmm0               \n\t"                   \
+    "paddd         %%xmm4, %%xmm2               \n\t"                   \
+    "paddd             %7, %%xmm0               \n\t"                   \
+    "paddd             %7, %%xmm2               \n\t"                   \
+    "psrad     $"#shift", %%xmm0               \n\t"                   \
+    "psrad     $"#shift", %%xmm2               \n\t"                   \
+    "pxor          %%xmm3, %%xmm3               \n\t"                   \
+    "pblendw        $0xaa, %%xmm3, %%xmm0       \n\t"                   \
+    "pblendw        $0xaa, %%xmm3, %%xmm2       \n\t"                   \
+    "packusdw      %%xmm2, %%xmm0               \n\t"
+
+static void vertical_compose_dd97iH0_sse4(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                          IDWTELEM *b3, IDWTELEM *b4, int width)
+{
+    int i, width_align = width & ~7;
+
+    for (i = 0; i < width_align; i += 8)
+        __asm__ volatile(
+            COMPOSE_DD_SSE4(4)
+            "movdqu          (%2), %%xmm1               \n\t"
+            "paddw         %%xmm1, %%xmm0               \n\t"
+            "movdqu        %%xmm0, (%2)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "r"(b3 + i), "r"(b4 + i),
+              "m"(*pw_9), "m"(*pw_m1), "m"(*pd_8)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",) "memory"
+        );
+
+    for (i = width_align; i < width; i++)
+        b2[i] = COMPOSE_DD97iH0(b0[i], b1[i], b2[i], b3[i], b4[i]);
+}
+
+static void vertical_compose_dd137iL0_sse4(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                           IDWTELEM *b3, IDWTELEM *b4, int width)
+{
+    int i, width_align = width & ~7;
+
+    for (i = 0; i < width_align; i += 8)
+        __asm__ volatile(
+            COMPOSE_DD_SSE4(5)
+            "movdqu          (%2), %%xmm1               \n\t"
+            "psubw         %%xmm0, %%xmm1               \n\t"
+            "movdqu        %%xmm1, (%2)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "r"(b3 + i), "r"(b4 + i),
+              "m"(*pw_9), "m"(*pw_m1), "m"(*pd_16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",) "memory"
+        );
+
+    for (i = width_align; i < width; i++)
+        b2[i] = COMPOSE_DD137iL0(b0[i], b1[i], b2[i], b3[i], b4[i]);
+}
+
+static void vertical_compose_haar_sse4(IDWTELEM *b0, IDWTELEM *b1, int width)
+{
+    int i, width_align = width & ~7;
+
+    for (i = 0; i < width_align; i += 8)
+        __asm__ volatile(
+            "movdqu          (%1), %%xmm1               \n\t"
+            "movdqa        %%xmm1, %%xmm0               \n\t"
+            "movdqa        %%xmm1, %%xmm2               \n\t"
+            "pand              %2, %%xmm2               \n\t"
+            "psraw             $1, %%xmm0               \n\t"
+            "paddw         %%xmm2, %%xmm0               \n\t" // (b1 + 1) >> 1
+            "movdqu          (%0), %%xmm2               \n\t"
+            "psubw         %%xmm0, %%xmm2               \n\t"
+            "paddw         %%xmm2, %%xmm1               \n\t"
+            "movdqu        %%xmm2, (%0)                 \n\t"
+            "movdqu        %%xmm1, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+
+    for (i = width_align; i < width; i++) {
+        b0[i] = COMPOSE_HAARiL0(b0[i], b1[i]);
+        b1[i] = COMPOSE_HAARiH0(b1[i], b0[i]);
+    }
+}
+#endif /* HAVE_SSE4_INLINE */
+
+#if HAVE_AVX2_INLINE
+static void vertical_compose53iL0_avx2(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                       int width)
+{
+    int i, width_align = width & ~15;
+
+    for (i = 0; i < width_align; i += 16)
+        __asm__ volatile(
+            "vmovdqu         (%0), %%ymm0               \n\t"
+            "vmovdqu         (%2), %%ymm1               \n\t"
+            "vpand         %%ymm0, %%ymm1, %%ymm2       \n\t"
+            "vpand             %3, %%ymm2, %%ymm2       \n\t"
+            "vpsraw            $1, %%ymm0, %%ymm0       \n\t"
+            "vpsraw            $1, %%ymm1, %%ymm1       \n\t"
+            "vpaddw        %%ymm1, %%ymm0, %%ymm0       \n\t"
+            "vpaddw        %%ymm2, %%ymm0, %%ymm0       \n\t" // (b0 + b2) >> 1
+            "vpand             %3, %%ymm0, %%ymm1       \n\t"
+            "vpsraw            $1, %%ymm0, %%ymm0       \n\t"
+            "vpaddw        %%ymm1, %%ymm0, %%ymm0       \n\t" // (b0 + b2 + 2) >> 2
+            "vmovdqu         (%1), %%ymm1               \n\t"
+            "vpsubw        %%ymm0, %%ymm1, %%ymm1       \n\t"
+            "vmovdqu       %%ymm1, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+    __asm__ volatile("vzeroupper" ::: "memory");
+
+    for (i = width_align; i < width; i++)
+        b1[i] = COMPOSE_53iL0(b0[i], b1[i], b2[i]);
+}
+
+static void vertical_compose_dirac53iH0_avx2(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                             int width)
+{
+    int i, width_align = width & ~15;
+
+    for (i = 0; i < width_align; i += 16)
+        __asm__ volatile(
+            "vmovdqu         (%0), %%ymm0               \n\t"
+            "vmovdqu         (%2), %%ymm1               \n\t"
+            "vpor          %%ymm0, %%ymm1, %%ymm2       \n\t"
+            "vpand             %3, %%ymm2, %%ymm2       \n\t"
+            "vpsraw            $1, %%ymm0, %%ymm0       \n\t"
+            "vpsraw            $1, %%ymm1, %%ymm1       \n\t"
+            "vpaddw        %%ymm1, %%ymm0, %%ymm0       \n\t"
+            "vpaddw        %%ymm2, %%ymm0, %%ymm0       \n\t" // (b0 + b2 + 1) >> 1
+            "vpaddw          (%1), %%ymm0, %%ymm0       \n\t"
+            "vmovdqu       %%ymm0, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+    __asm__ volatile("vzeroupper" ::: "memory");
+
+    for (i = width_align; i < width; i++)
+        b1[i] = COMPOSE_DIRAC53iH0(b0[i], b1[i], b2[i]);
+}
+
+/* ymm0/ymm2 = (-b0 + 9*b1 + 9*b3 - b4 + rnd) >> shift, as dwords */
+#define COMPOSE_DD_AVX2(shift)                                          \
+    "vmovdqu         (%1), %%ymm0               \n\t"                   \
+    "vmovdqu         (%3), %%ymm1               \n\t"                   \
+    "vpunpckhwd    %%ymm1, %%ymm0, %%ymm2       \n\t"                   \
+    "vpunpcklwd    %%ymm1, %%ymm0, %%ymm0       \n\t"                   \
+    "vpmaddwd          %5, %%ymm0, %%ymm0       \n\t"                   \
+    "vpmaddwd          %5, %%ymm2, %%ymm2       \n\t"                   \
+    "vmovdqu         (%0), %%ymm1               \n\t"                   \
+    "vmovdqu         (%4), %%ymm3               \n\t"                   \
+    "vpunpckhwd    %%ymm3, %%ymm1, %%ymm4       \n\t"                   \
+    "vpunpcklwd    %%ymm3, %%ymm1, %%ymm1       \n\t"                   \
+    "vpmaddwd          %6, %%ymm1, %%ymm1       \n\t"                   \
+    "vpmaddwd          %6, %%ymm4, %%ymm4       \n\t"                   \
+    "vpaddd        %%ymm1, %%ymm0, %%ymm0       \n\t"                   \
+    "vpaddd        %%ymm4, %%ymm2, %%ymm2       \n\t"                   \
+    "vpaddd            %7, %%ymm0, %%ymm0       \n\t"                   \
+    "vpaddd            %7, %%ymm2, %%ymm2       \n\t"                   \
+    "vpsrad   $"#shift", %%ymm0, %%ymm0       \n\t"                   \
+    "vpsrad   $"#shift", %%ymm2, %%ymm2       \n\t"                   \
+    /* keep the low 16 bits so that the pack does not saturate */      \
+    "vpslld           $16, %%ymm0, %%ymm0       \n\t"                   \
+    "vpslld           $16, %%ymm2, %%ymm2       \n\t"                   \
+    "vpsrad           $16, %%ymm0, %%ymm0       \n\t"                   \
+    "vpsrad           $16, %%ymm2, %%ymm2       \n\t"                   \
+    "vpackssdw     %%ymm2, %%ymm0, %%ymm0       \n\t"
+
+static void vertical_compose_dd97iH0_avx2(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                          IDWTELEM *b3, IDWTELEM *b4, int width)
+{
+    int i, width_align = width & ~15;
+
+    for (i = 0; i < width_align; i += 16)
+        __asm__ volatile(
+            COMPOSE_DD_AVX2(4)
+            "vpaddw          (%2), %%ymm0, %%ymm0       \n\t"
+            "vmovdqu       %%ymm0, (%2)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "r"(b3 + i), "r"(b4 + i),
+              "m"(*pw_9), "m"(*pw_m1), "m"(*pd_8)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",) "memory"
+        );
+    __asm__ volatile("vzeroupper" ::: "memory");
+
+    for (i = width_align; i < width; i++)
+        b2[i] = COMPOSE_DD97iH0(b0[i], b1[i], b2[i], b3[i], b4[i]);
+}
+
+static void vertical_compose_dd137iL0_avx2(IDWTELEM *b0, IDWTELEM *b1, IDWTELEM *b2,
+                                           IDWTELEM *b3, IDWTELEM *b4, int width)
+{
+    int i, width_align = width & ~15;
+
+    for (i = 0; i < width_align; i += 16)
+        __asm__ volatile(
+            COMPOSE_DD_AVX2(5)
+            "vmovdqu         (%2), %%ymm1               \n\t"
+            "vpsubw        %%ymm0, %%ymm1, %%ymm1       \n\t"
+            "vmovdqu       %%ymm1, (%2)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "r"(b2 + i), "r"(b3 + i), "r"(b4 + i),
+              "m"(*pw_9), "m"(*pw_m1), "m"(*pd_16)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",) "memory"
+        );
+    __asm__ volatile("vzeroupper" ::: "memory");
+
+    for (i = width_align; i < width; i++)
+        b2[i] = COMPOSE_DD137iL0(b0[i], b1[i], b2[i], b3[i], b4[i]);
+}
+
+static void vertical_compose_haar_avx2(IDWTELEM *b0, IDWTELEM *b1, int width)
+{
+    int i, width_align = width & ~15;
+
+    for (i = 0; i < width_align; i += 16)
+        __asm__ volatile(
+            "vmovdqu         (%1), %%ymm1               \n\t"
+            "vpand             %2, %%ymm1, %%ymm2       \n\t"
+            "vpsraw            $1, %%ymm1, %%ymm0       \n\t"
+            "vpaddw        %%ymm2, %%ymm0, %%ymm0       \n\t" // (b1 + 1) >> 1
+            "vmovdqu         (%0), %%ymm2               \n\t"
+            "vpsubw        %%ymm0, %%ymm2, %%ymm2       \n\t"
+            "vpaddw        %%ymm2, %%ymm1, %%ymm1       \n\t"
+            "vmovdqu       %%ymm2, (%0)                 \n\t"
+            "vmovdqu       %%ymm1, (%1)                 \n\t"
+            :
+            : "r"(b0 + i), "r"(b1 + i), "m"(*pw_1)
+            : XMM_CLOBBERS("xmm0", "xmm1", "xmm2",) "memory"
+        );
+    __asm__ volatile("vzeroupper" ::: "memory");
+
+    for (i = width_align; i < width; i++) {
+        b0[i] = COMPOSE_HAARiL0(b0[i], b1[i]);
+        b1[i] = COMPOSE_HAARiH0(b1[i], b0[i]);
+    }
+}
+#endif /* HAVE_AVX2_INLINE */
+
+static void spatial_idwt_init_yasm(DWTContext *d, enum dwt_type type)
 {
 #if HAVE_YASM
   int mm_flags = av_get_cpu_flags();
@@ -200,3 +545,39 @@ void ff_spatial_idwt_init_mmx(DWTContext *d, enum dwt_type type)
     }
 #endif // HAVE_YASM
 }
+
+#define VERTICAL_COMPOSE_INIT(ext)                                          \
+    switch (type) {                                                         \
+    case DWT_DIRAC_DD9_7:                                                   \
+        d->vertical_compose_l0 = (void*)vertical_compose53iL0##ext;         \
+        d->vertical_compose_h0 = (void*)vertical_compose_dd97iH0##ext;      \
+        break;                                                              \
+    case DWT_DIRAC_LEGALL5_3:                                               \
+        d->vertical_compose_l0 = (void*)vertical_compose53iL0##ext;         \
+        d->vertical_compose_h0 = (void*)vertical_compose_dirac53iH0##ext;   \
+        break;                                                              \
+    case DWT_DIRAC_DD13_7:                                                  \
+        d->vertical_compose_l0 = (void*)vertical_compose_dd137iL0##ext;     \
+        d->vertical_compose_h0 = (void*)vertical_compose_dd97iH0##ext;      \
+        break;                                                              \
+    case DWT_DIRAC_HAAR0:                                                   \
+    case DWT_DIRAC_HAAR1:                                                   \
+        d->vertical_compose   = (void*)vertical_compose_haar##ext;          \
+        break;                                                              \
+    }
+
+void ff_spatial_idwt_init_mmx(DWTContext *d, enum dwt_type type)
+{
+    int av_unused cpu_flags = av_get_cpu_flags();
+
+    spatial_idwt_init_yasm(d, type);
+
+#if HAVE_SSE4_INLINE
+    if (INLINE_SSE4(cpu_flags))
+        VERTICAL_COMPOSE_INIT(_sse4);
+#endif
+#if HAVE_AVX2_INLINE
+    if (INLINE_AVX2(cpu_flags))
+        VERTICAL_COMPOSE_INIT(_avx2);
+#endif
+}
@@ -0,0 +1,154 @@
+/*
+ * SIMD lifting steps for the JPEG 2000 inverse discrete wavelet transform
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/jpeg2000dwt.h"
+
+/* All the functions process FF_DWT_STRIP (16) coefficients and do the same
+ * operations in the same order as the C code, so the output is identical. */
+
+#if HAVE_SSE_INLINE
+
+#define LIFT_FLOAT_SSE(off)                             \
+    "movups   "#off"(%1), %%xmm0            \n\t"       \
+    "movups   "#off"(%2), %%xmm1            \n\t"       \
+    "addps        %%xmm1, %%xmm0            \n\t"       \
+    "mulps        %%xmm4, %%xmm0            \n\t"       \
+    "movups   "#off"(%0), %%xmm1            \n\t"       \
+    "addps        %%xmm0, %%xmm1            \n\t"       \
+    "movups       %%xmm1, "#off"(%0)        \n\t"
+
+static void lift_float_sse(float *dst, const float *src0, const float *src1,
+                           float coef)
+{
+    __asm__ volatile(
+        "movss           %3, %%xmm4         \n\t"
+        "shufps  $0, %%xmm4, %%xmm4         \n\t"
+        LIFT_FLOAT_SSE(0)
+        LIFT_FLOAT_SSE(16)
+        LIFT_FLOAT_SSE(32)
+        LIFT_FLOAT_SSE(48)
+        :
+        : "r"(dst), "r"(src0), "r"(src1), "m"(coef)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm4",) "memory"
+    );
+}
+#endif /* HAVE_SSE_INLINE */
+
+#if HAVE_SSE2_INLINE
+
+/* xmm7 = 2 */
+#define LIFT53_EVEN_SSE2(off)                           \
+    "movdqu   "#off"(%1), %%xmm0            \n\t"       \
+    "movdqu   "#off"(%2), %%xmm1            \n\t"       \
+    "paddd        %%xmm1, %%xmm0            \n\t"       \
+    "paddd        %%xmm7, %%xmm0            \n\t"       \
+    "psrad            $2, %%xmm0            \n\t"       \
+    "movdqu   "#off"(%0), %%xmm1            \n\t"       \
+    "psubd        %%xmm0, %%xmm1            \n\t"       \
+    "movdqu       %%xmm1, "#off"(%0)        \n\t"
+
+#define LIFT53_ODD_SSE2(off)                            \
+    "movdqu   "#off"(%1), %%xmm0            \n\t"       \
+    "movdqu   "#off"(%2), %%xmm1            \n\t"       \
+    "paddd        %%xmm1, %%xmm0            \n\t"       \
+    "psrad            $1, %%xmm0            \n\t"       \
+    "movdqu   "#off"(%0), %%xmm1            \n\t"       \
+    "paddd        %%xmm0, %%xmm1            \n\t"       \
+    "movdqu       %%xmm1, "#off"(%0)        \n\t"
+
+static void lift53_even_sse2(int32_t *dst, const int32_t *src0,
+                             const int32_t *src1)
+{
+    __asm__ volatile(
+        "pcmpeqd     %%xmm7, %%xmm7         \n\t"
+        "psrld          $31, %%xmm7         \n\t"
+        "pslld           $1, %%xmm7         \n\t"
+        LIFT53_EVEN_SSE2(0)
+        LIFT53_EVEN_SSE2(16)
+        LIFT53_EVEN_SSE2(32)
+        LIFT53_EVEN_SSE2(48)
+        :
+        : "r"(dst), "r"(src0), "r"(src1)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm7",) "memory"
+    );
+}
+
+static void lift53_odd_sse2(int32_t *dst, const int32_t *src0,
+                            const int32_t *src1)
+{
+    __asm__ volatile(
+        LIFT53_ODD_SSE2(0)
+        LIFT53_ODD_SSE2(16)
+        LIFT53_ODD_SSE2(32)
+        LIFT53_ODD_SSE2(48)
+        :
+        : "r"(dst), "r"(src0), "r"(src1)
+        : XMM_CLOBBERS("xmm0", "xmm1",) "memory"
+    );
+}
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX_INLINE
+
+#define LIFT_FLOAT_AVX(off)                                     \
+    "vmovups  "#off"(%1), %%ymm0                    \n\t"       \
+    "vaddps   "#off"(%2), %%ymm0, %%ymm0            \n\t"       \
+    "vmulps       %%ymm4, %%ymm0, %%ymm0            \n\t"       \
+    "vaddps   "#off"(%0), %%ymm0, %%ymm0            \n\t"       \
+    "vmovups      %%ymm0, "#off"(%0)                \n\t"
+
+static void lift_float_avx(float *dst, const float *src0, const float *src1,
+                           float coef)
+{
+    __asm__ volatile(
+        "vbroadcastss    %3, %%ymm4         \n\t"
+        LIFT_FLOAT_AVX(0)
+        LIFT_FLOAT_AVX(32)
+        "vzeroupper                         \n\t"
+        :
+        : "r"(dst), "r"(src0), "r"(src1), "m"(coef)
+        : XMM_CLOBBERS("xmm0", "xmm4",) "memory"
+    );
+}
+#endif /* HAVE_AVX_INLINE */
+
+av_cold void ff_jpeg2000dwt_init_x86(DWTContext *s)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+#if HAVE_SSE_INLINE
+    if (INLINE_SSE(cpu_flags))
+        s->lift_float = lift_float_sse;
+#endif
+#if HAVE_SSE2_INLINE
+    if (INLINE_SSE2(cpu_flags)) {
+        s->lift53_even = lift53_even_sse2;
+        s->lift53_odd  = lift53_odd_sse2;
+    }
+#endif
+#if HAVE_AVX_INLINE
+    if (INLINE_AVX(cpu_flags))
+        s->lift_float = lift_float_avx;
+#endif
+}
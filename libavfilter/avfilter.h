@@ -440,6 +440,12 @@ enum AVMediaType avfilter_pad_get_type(const AVFilterPad *pads, int pad_idx);
  * and processing them concurrently.
  */
 #define AVFILTER_FLAG_SLICE_THREADS         (1 << 2)
+/**
+ * The filter passes its input on to several outputs, and can deliver a
+ * frame to all of them concurrently when the graph branches starting at
+ * those outputs never join again.
+ */
+#define AVFILTER_FLAG_BRANCH_THREADS        (1 << 3)
 /**
  * Some filters support a generic "enable" expression option that can be used
  * to enable or disable a filter in the timeline. Filters supporting this
@@ -626,6 +632,10 @@ typedef struct AVFilter {
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Process independent branches of the filtergraph concurrently.
+ */
+#define AVFILTER_THREAD_BRANCH (1 << 1)
 
 typedef struct AVFilterInternal AVFilterInternal;
 
@@ -670,6 +680,8 @@ struct AVFilterContext {
      *
      * After the filter is initialized, libavfilter sets this field to the
      * threading type that is actually used (0 for no multithreading).
+     * AVFILTER_THREAD_BRANCH is only kept once the graph is configured if the
+     * branches following the filter are independent.
      */
     int thread_type;
 
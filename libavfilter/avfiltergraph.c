@@ -43,6 +43,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "branch", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_BRANCH }, .flags = FLAGS, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, FLAGS },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -71,6 +72,14 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -1183,6 +1192,72 @@ static int graph_insert_fifos(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
+/**
+ * Mark all filters reachable from filter as belonging to branch.
+ *
+ * @return 1 if one of them already belongs to another branch, 0 otherwise
+ */
+static int mark_branch(AVFilterGraph *graph, AVFilterContext *filter,
+                       unsigned *branches, unsigned branch)
+{
+    unsigned i;
+
+    for (i = 0; i < graph->nb_filters; i++)
+        if (graph->filters[i] == filter)
+            break;
+    if (branches[i] == branch)
+        return 0;
+    if (branches[i])
+        return 1;
+    branches[i] = branch;
+
+    for (i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i] &&
+            mark_branch(graph, filter->outputs[i]->dst, branches, branch))
+            return 1;
+    return 0;
+}
+
+/**
+ * Keep branch threading only on the filters whose outputs lead to disjoint
+ * parts of the graph, so that the branches can run without sharing state.
+ */
+static int graph_config_branches(AVFilterGraph *graph, AVClass *log_ctx)
+{
+    unsigned *branches;
+    unsigned i, j;
+
+    if (!graph->internal->branch_execute)
+        return 0;
+
+    branches = av_malloc_array(graph->nb_filters, sizeof(*branches));
+    if (!branches)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!(f->thread_type & AVFILTER_THREAD_BRANCH))
+            continue;
+
+        memset(branches, 0, graph->nb_filters * sizeof(*branches));
+        for (j = 0; j < f->nb_outputs; j++)
+            if (mark_branch(graph, f->outputs[j]->dst, branches, j + 1))
+                break;
+
+        if (f->nb_outputs < 2 || j < f->nb_outputs) {
+            f->thread_type &= ~AVFILTER_THREAD_BRANCH;
+        } else {
+            av_log(log_ctx, AV_LOG_VERBOSE,
+                   "Processing the %d outputs of filter '%s' in parallel.\n",
+                   f->nb_outputs, f->name);
+        }
+    }
+
+    av_free(branches);
+    return 0;
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -1197,6 +1272,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = ff_avfilter_graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = graph_config_branches(graphctx, log_ctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -1300,8 +1377,10 @@ static void heap_bubble_down(AVFilterGraph *graph,
 
 void ff_avfilter_graph_update_heap(AVFilterGraph *graph, AVFilterLink *link)
 {
+    ff_graph_lock(graph);
     heap_bubble_up  (graph, link, link->age_index);
     heap_bubble_down(graph, link, link->age_index);
+    ff_graph_unlock(graph);
 }
 
 
@@ -32,12 +32,16 @@
 #include "version.h"
 #include "video.h"
 
-#define POOL_SIZE 32
+/**
+ * Buffer pools of the video frames allocated on a link by
+ * ff_default_get_video_buffer().
+ */
 typedef struct AVFilterPool {
-    AVFilterBufferRef *pic[POOL_SIZE];
-    int count;
-    int refcount;
-    int draining;
+    int width;
+    int height;
+    enum AVPixelFormat format;
+    int linesize[4];
+    AVBufferPool *pools[4];
 } AVFilterPool;
 
 typedef struct AVFilterCommand {
@@ -155,6 +159,8 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    void *branch_thread;
+    avfilter_execute_func *branch_execute;
 };
 
 struct AVFilterInternal {
@@ -60,6 +60,14 @@ typedef struct ThreadContext {
     int current_job;
     unsigned int current_execute;
     int done;
+
+    /* serializes callers of execute, which may run on different threads
+     * when graph branches are processed concurrently */
+    pthread_mutex_t execute_lock;
+    int busy;
+
+    /* protects the graph state shared between concurrent branches */
+    pthread_mutex_t graph_lock;
 } ThreadContext;
 
 static void* attribute_align_arg worker(void *v)
@@ -109,6 +117,8 @@ static void slice_thread_uninit(ThreadContext *c)
          pthread_join(c->workers[i], NULL);
 
     pthread_mutex_destroy(&c->current_job_lock);
+    pthread_mutex_destroy(&c->execute_lock);
+    pthread_mutex_destroy(&c->graph_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
     av_freep(&c->workers);
@@ -121,15 +131,12 @@ static void slice_thread_park_workers(ThreadContext *c)
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
-                          void *arg, int *ret, int nb_jobs)
+static int thread_execute_internal(ThreadContext *c, AVFilterContext *ctx,
+                                   avfilter_action_func *func,
+                                   void *arg, int *ret, int nb_jobs)
 {
-    ThreadContext *c = ctx->graph->internal->thread;
     int dummy_ret;
 
-    if (nb_jobs <= 0)
-        return 0;
-
     pthread_mutex_lock(&c->current_job_lock);
 
     c->current_job = c->nb_threads;
@@ -153,6 +160,51 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
     return 0;
 }
 
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->thread;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    pthread_mutex_lock(&c->execute_lock);
+    thread_execute_internal(c, ctx, func, arg, ret, nb_jobs);
+    pthread_mutex_unlock(&c->execute_lock);
+
+    return 0;
+}
+
+/**
+ * Run one job per branch. Returns AVERROR(EBUSY) without running anything
+ * when called from within a branch, the caller then has to run the jobs
+ * itself.
+ */
+static int branch_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ThreadContext *c = ctx->graph->internal->branch_thread;
+    int busy;
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    pthread_mutex_lock(&c->execute_lock);
+    busy = c->busy;
+    c->busy = 1;
+    pthread_mutex_unlock(&c->execute_lock);
+    if (busy)
+        return AVERROR(EBUSY);
+
+    thread_execute_internal(c, ctx, func, arg, ret, nb_jobs);
+
+    pthread_mutex_lock(&c->execute_lock);
+    c->busy = 0;
+    pthread_mutex_unlock(&c->execute_lock);
+
+    return 0;
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     int i, ret;
@@ -181,6 +233,8 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     pthread_cond_init(&c->current_job_cond, NULL);
     pthread_cond_init(&c->last_job_cond,    NULL);
 
+    pthread_mutex_init(&c->execute_lock, NULL);
+    pthread_mutex_init(&c->graph_lock, NULL);
     pthread_mutex_init(&c->current_job_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
     for (i = 0; i < nb_threads; i++) {
@@ -226,6 +280,22 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_BRANCH) {
+        graph->internal->branch_thread = av_mallocz(sizeof(ThreadContext));
+        if (!graph->internal->branch_thread)
+            return AVERROR(ENOMEM);
+
+        ret = thread_init_internal(graph->internal->branch_thread,
+                                   graph->nb_threads);
+        if (ret <= 1) {
+            av_freep(&graph->internal->branch_thread);
+            graph->thread_type &= ~AVFILTER_THREAD_BRANCH;
+            return (ret < 0) ? ret : 0;
+        }
+
+        graph->internal->branch_execute = branch_execute;
+    }
+
     return 0;
 }
 
@@ -234,4 +304,23 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+    if (graph->internal->branch_thread)
+        slice_thread_uninit(graph->internal->branch_thread);
+    av_freep(&graph->internal->branch_thread);
+}
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->branch_thread;
+
+    if (c)
+        pthread_mutex_lock(&c->graph_lock);
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->branch_thread;
+
+    if (c)
+        pthread_mutex_unlock(&c->graph_lock);
 }
@@ -38,6 +38,8 @@
 typedef struct SplitContext {
     const AVClass *class;
     int nb_outputs;
+    AVFrame **frames;   ///< per-output frames, used with branch threading
+    int *rets;
 } SplitContext;
 
 static av_cold int split_init(AVFilterContext *ctx)
@@ -56,15 +58,77 @@ static av_cold int split_init(AVFilterContext *ctx)
         ff_insert_outpad(ctx, i, &pad);
     }
 
+    if (ctx->thread_type & AVFILTER_THREAD_BRANCH) {
+        s->frames = av_calloc(s->nb_outputs, sizeof(*s->frames));
+        s->rets   = av_calloc(s->nb_outputs, sizeof(*s->rets));
+        if (!s->frames || !s->rets)
+            return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
 static av_cold void split_uninit(AVFilterContext *ctx)
 {
+    SplitContext *s = ctx->priv;
     int i;
 
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
+    av_freep(&s->frames);
+    av_freep(&s->rets);
+}
+
+static int filter_branch(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AVFrame **frames = arg;
+
+    if (!frames[jobnr])
+        return AVERROR_EOF;
+    return ff_filter_frame(ctx->outputs[jobnr], frames[jobnr]);
+}
+
+/* The branches following the outputs never join again, so the frame can be
+ * pushed to all of them at once. */
+static int filter_frame_branches(AVFilterContext *ctx, AVFrame *frame)
+{
+    SplitContext *s = ctx->priv;
+    int i, ret = 0;
+
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        s->frames[i] = NULL;
+        if (ctx->outputs[i]->closed)
+            continue;
+        s->frames[i] = av_frame_clone(frame);
+        if (!s->frames[i]) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+    }
+    av_frame_free(&frame);
+    if (ret < 0) {
+        while (i--)
+            av_frame_free(&s->frames[i]);
+        return ret;
+    }
+
+    ret = ctx->graph->internal->branch_execute(ctx, filter_branch, s->frames,
+                                               s->rets, ctx->nb_outputs);
+    if (ret == AVERROR(EBUSY)) {
+        /* nested in another branch, the pool is taken */
+        for (i = 0; i < ctx->nb_outputs; i++)
+            s->rets[i] = filter_branch(ctx, s->frames, i, ctx->nb_outputs);
+    }
+
+    ret = AVERROR_EOF;
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        if (!s->frames[i])
+            continue;
+        ret = s->rets[i];
+        if (ret < 0)
+            break;
+    }
+    return ret;
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
@@ -72,6 +136,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     AVFilterContext *ctx = inlink->dst;
     int i, ret = AVERROR_EOF;
 
+    if (ctx->thread_type & AVFILTER_THREAD_BRANCH)
+        return filter_frame_branches(ctx, frame);
+
     for (i = 0; i < ctx->nb_outputs; i++) {
         AVFrame *buf_out;
 
@@ -122,7 +189,7 @@ AVFilter ff_vf_split = {
     .uninit      = split_uninit,
     .inputs      = avfilter_vf_split_inputs,
     .outputs     = NULL,
-    .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_BRANCH_THREADS,
 };
 
 static const AVFilterPad avfilter_af_asplit_inputs[] = {
@@ -143,5 +210,5 @@ AVFilter ff_af_asplit = {
     .uninit      = split_uninit,
     .inputs      = avfilter_af_asplit_inputs,
     .outputs     = NULL,
-    .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_BRANCH_THREADS,
 };
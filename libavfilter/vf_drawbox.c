@@ -196,13 +196,35 @@ fail:
     return ret;
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+/**
+ * Compute the part [*slice_start, *slice_end) of the lines [start, end)
+ * drawn by the job jobnr. The slices are aligned on the chroma lines, so
+ * that each chroma line is blended by a single job.
+ */
+static void get_slice(const DrawBoxContext *s, int start, int end,
+                      int jobnr, int nb_jobs, int *slice_start, int *slice_end)
+{
+    const int mask = (1 << s->vsub) - 1;
+    const int n    = FFMAX(end - start, 0);
+
+    *slice_start = !jobnr ? start :
+                   FFMAX(start, (start + n *  jobnr    / nb_jobs) & ~mask);
+    *slice_end   = jobnr + 1 == nb_jobs ? end :
+                   FFMAX(start, (start + n * (jobnr+1) / nb_jobs) & ~mask);
+}
+
+static int drawbox_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    DrawBoxContext *s = inlink->dst->priv;
+    DrawBoxContext *s = ctx->priv;
+    AVFrame *frame = arg;
     int plane, x, y, xb = s->x, yb = s->y;
+    int slice_start, slice_end;
     unsigned char *row[4];
 
-    for (y = FFMAX(yb, 0); y < frame->height && y < (yb + s->h); y++) {
+    get_slice(s, FFMAX(yb, 0), FFMIN(frame->height, yb + s->h),
+              jobnr, nb_jobs, &slice_start, &slice_end);
+
+    for (y = slice_start; y < slice_end; y++) {
         row[0] = frame->data[0] + y * frame->linesize[0];
 
         for (plane = 1; plane < 3; plane++)
@@ -228,7 +250,17 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         }
     }
 
-    return ff_filter_frame(inlink->dst->outputs[0], frame);
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+
+    ctx->internal->execute(ctx, drawbox_slice, frame, NULL,
+                           FFMIN(frame->height, ctx->graph->nb_threads));
+
+    return ff_filter_frame(ctx->outputs[0], frame);
 }
 
 #define OFFSET(x) offsetof(DrawBoxContext, x)
@@ -280,7 +312,7 @@ AVFilter ff_vf_drawbox = {
     .query_formats = query_formats,
     .inputs        = drawbox_inputs,
     .outputs       = drawbox_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif /* CONFIG_DRAWBOX_FILTER */
 
@@ -309,13 +341,18 @@ static av_pure av_always_inline int pixel_belongs_to_grid(DrawBoxContext *drawgr
         || y_modulo < drawgrid->thickness;  // Belongs to horizontal line
 }
 
-static int drawgrid_filter_frame(AVFilterLink *inlink, AVFrame *frame)
+static int drawgrid_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    DrawBoxContext *drawgrid = inlink->dst->priv;
+    DrawBoxContext *drawgrid = ctx->priv;
+    AVFrame *frame = arg;
     int plane, x, y;
+    int slice_start, slice_end;
     uint8_t *row[4];
 
-    for (y = 0; y < frame->height; y++) {
+    get_slice(drawgrid, 0, frame->height, jobnr, nb_jobs,
+              &slice_start, &slice_end);
+
+    for (y = slice_start; y < slice_end; y++) {
         row[0] = frame->data[0] + y * frame->linesize[0];
 
         for (plane = 1; plane < 3; plane++)
@@ -339,7 +376,17 @@ static int drawgrid_filter_frame(AVFilterLink *inlink, AVFrame *frame)
         }
     }
 
-    return ff_filter_frame(inlink->dst->outputs[0], frame);
+    return 0;
+}
+
+static int drawgrid_filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+
+    ctx->internal->execute(ctx, drawgrid_slice, frame, NULL,
+                           FFMIN(frame->height, ctx->graph->nb_threads));
+
+    return ff_filter_frame(ctx->outputs[0], frame);
 }
 
 static const AVOption drawgrid_options[] = {
@@ -386,7 +433,7 @@ AVFilter ff_vf_drawgrid = {
     .query_formats = query_formats,
     .inputs        = drawgrid_inputs,
     .outputs       = drawgrid_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
 
 #endif  /* CONFIG_DRAWGRID_FILTER */
@@ -150,12 +150,92 @@ static void denoise_depth(HQDN3DContext *s,
     emms_c();
 }
 
-#define denoise(...) \
+/* The spatial filter is recursive along the rows and along the columns, so
+ * when threaded it is split in a horizontal pass over bands of rows, which
+ * leaves its output in horiz, and a vertical and temporal pass over bands of
+ * columns. The arithmetic is the same as in denoise_spatial(). */
+av_always_inline
+static void denoise_rows(uint8_t *src, uint8_t *dst,
+                         uint16_t *horiz, uint16_t *frame_ant, int init,
+                         int w, int slice_start, int slice_end,
+                         int sstride, int dstride,
+                         int16_t *spatial, int16_t *temporal, int depth)
+{
+    long x, y;
+    uint32_t pixel_ant;
+    uint32_t tmp;
+    int do_spatial = spatial[0];
+
+    spatial  += 256 << LUT_BITS;
+    temporal += 256 << LUT_BITS;
+
+    src       += slice_start * sstride;
+    dst       += slice_start * dstride;
+    horiz     += slice_start * w;
+    frame_ant += slice_start * w;
+
+    for (y = slice_start; y < slice_end; y++) {
+        if (init)
+            for (x = 0; x < w; x++)
+                frame_ant[x] = LOAD(x);
+        if (do_spatial) {
+            /* the first line is also filtered against its first pixel */
+            pixel_ant = LOAD(0);
+            if (!y)
+                pixel_ant = lowpass(pixel_ant, pixel_ant, spatial, depth);
+            horiz[0] = pixel_ant;
+            for (x = 1; x < w; x++)
+                horiz[x] = pixel_ant = lowpass(pixel_ant, LOAD(x), spatial, depth);
+        } else {
+            for (x = 0; x < w; x++) {
+                frame_ant[x] = tmp = lowpass(frame_ant[x], LOAD(x), temporal, depth);
+                STORE(x, tmp);
+            }
+        }
+        src       += sstride;
+        dst       += dstride;
+        horiz     += w;
+        frame_ant += w;
+    }
+}
+
+av_always_inline
+static void denoise_columns(uint8_t *dst, uint16_t *horiz,
+                            uint16_t *line_ant, uint16_t *frame_ant,
+                            int w, int h, int slice_start, int slice_end,
+                            int dstride, int16_t *spatial, int16_t *temporal,
+                            int depth)
+{
+    long x, y;
+    uint32_t tmp;
+
+    spatial  += 256 << LUT_BITS;
+    temporal += 256 << LUT_BITS;
+
+    for (x = slice_start; x < slice_end; x++) {
+        line_ant[x]  = tmp = horiz[x];
+        frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+        STORE(x, tmp);
+    }
+
+    for (y = 1; y < h; y++) {
+        dst       += dstride;
+        horiz     += w;
+        frame_ant += w;
+        for (x = slice_start; x < slice_end; x++) {
+            line_ant[x]  = tmp = lowpass(line_ant[x], horiz[x], spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
+    }
+}
+
+#define denoise(func, ...) \
     switch (s->depth) {\
-        case  8: denoise_depth(__VA_ARGS__,  8); break;\
-        case  9: denoise_depth(__VA_ARGS__,  9); break;\
-        case 10: denoise_depth(__VA_ARGS__, 10); break;\
-        case 16: denoise_depth(__VA_ARGS__, 16); break;\
+        case  8: func(__VA_ARGS__,  8); break;\
+        case  9: func(__VA_ARGS__,  9); break;\
+        case 10: func(__VA_ARGS__, 10); break;\
+        case 16: func(__VA_ARGS__, 16); break;\
     }
 
 static int16_t *precalc_coefs(double dist25, int depth)
@@ -211,10 +291,15 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->coefs[1]);
     av_freep(&s->coefs[2]);
     av_freep(&s->coefs[3]);
-    av_freep(&s->line);
+    av_freep(&s->line[0]);
+    av_freep(&s->line[1]);
+    av_freep(&s->line[2]);
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
+    av_freep(&s->horiz[0]);
+    av_freep(&s->horiz[1]);
+    av_freep(&s->horiz[2]);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -259,9 +344,11 @@ static int config_input(AVFilterLink *inlink)
     s->vsub  = desc->log2_chroma_h;
     s->depth = desc->comp[0].depth_minus1+1;
 
-    s->line = av_malloc(inlink->w * sizeof(*s->line));
-    if (!s->line)
-        return AVERROR(ENOMEM);
+    for (i = 0; i < 3; i++) {
+        s->line[i] = av_malloc(inlink->w * sizeof(*s->line[i]));
+        if (!s->line[i])
+            return AVERROR(ENOMEM);
+    }
 
     for (i = 0; i < 4; i++) {
         s->coefs[i] = precalc_coefs(s->strength[i], s->depth);
@@ -275,6 +362,60 @@ static int config_input(AVFilterLink *inlink)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int init[3];
+} ThreadData;
+
+static int denoise_rows_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    int c;
+
+    for (c = 0; c < 3; c++) {
+        int w = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        int h = FF_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+
+        denoise(denoise_rows, in->data[c], out->data[c],
+                s->horiz[c], s->frame_prev[c], td->init[c], w,
+                h *  jobnr      / nb_jobs,
+                h * (jobnr + 1) / nb_jobs,
+                in->linesize[c], out->linesize[c],
+                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    }
+    return 0;
+}
+
+static int denoise_columns_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    int c;
+
+    for (c = 0; c < 3; c++) {
+        int w = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub));
+        int h = FF_CEIL_RSHIFT(in->height, (!!c * s->vsub));
+        /* keep the bands on separate cache lines */
+        int slice_start = (w *  jobnr      / nb_jobs) & ~31;
+        int slice_end   = jobnr + 1 == nb_jobs ? w :
+                          (w * (jobnr + 1) / nb_jobs) & ~31;
+
+        if (!s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL][0])
+            continue;
+        denoise(denoise_columns, out->data[c], s->horiz[c],
+                s->line[c], s->frame_prev[c], w, h, slice_start, slice_end,
+                out->linesize[c],
+                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    }
+    emms_c();
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx  = inlink->dst;
@@ -282,7 +423,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     AVFilterLink *outlink = ctx->outputs[0];
 
     AVFrame *out;
-    int direct, c;
+    ThreadData td;
+    int direct, c, nb_jobs;
 
     if (av_frame_is_writable(in) && !ctx->is_disabled) {
         direct = 1;
@@ -298,14 +440,42 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         av_frame_copy_props(out, in);
     }
 
-    for (c = 0; c < 3; c++) {
-        denoise(s, in->data[c], out->data[c],
-                s->line, &s->frame_prev[c],
-                FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
-                FF_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
-                in->linesize[c], out->linesize[c],
-                s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
-                s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+    nb_jobs = FFMIN(ctx->graph->nb_threads,
+                    FF_CEIL_RSHIFT(in->height, s->vsub));
+    if (nb_jobs > 1) {
+        for (c = 0; c < 3; c++) {
+            int size = FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub)) *
+                       FF_CEIL_RSHIFT(in->height, (!!c * s->vsub)) *
+                       sizeof(uint16_t);
+
+            td.init[c] = !s->frame_prev[c];
+            if (!s->frame_prev[c])
+                s->frame_prev[c] = av_malloc(size);
+            if (!s->horiz[c])
+                s->horiz[c] = av_malloc(size);
+            if (!s->frame_prev[c] || !s->horiz[c]) {
+                if (!direct)
+                    av_frame_free(&out);
+                av_frame_free(&in);
+                return AVERROR(ENOMEM);
+            }
+        }
+
+        td.in  = in;
+        td.out = out;
+        ctx->internal->execute(ctx, denoise_rows_slice, &td, NULL, nb_jobs);
+        if (s->coefs[LUMA_SPATIAL][0] || s->coefs[CHROMA_SPATIAL][0])
+            ctx->internal->execute(ctx, denoise_columns_slice, &td, NULL, nb_jobs);
+    } else {
+        for (c = 0; c < 3; c++) {
+            denoise(denoise_depth, s, in->data[c], out->data[c],
+                    s->line[c], &s->frame_prev[c],
+                    FF_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
+                    FF_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
+                    in->linesize[c], out->linesize[c],
+                    s->coefs[c ? CHROMA_SPATIAL : LUMA_SPATIAL],
+                    s->coefs[c ? CHROMA_TMP     : LUMA_TMP]);
+        }
     }
 
     if (ctx->is_disabled) {
@@ -360,5 +530,5 @@ AVFilter ff_vf_hqdn3d = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_hqdn3d_inputs,
     .outputs       = avfilter_vf_hqdn3d_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
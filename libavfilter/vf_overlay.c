@@ -38,6 +38,7 @@
 #include "dualinput.h"
 #include "drawutils.h"
 #include "video.h"
+#include "vf_overlay.h"
 
 static const char *const var_names[] = {
     "main_w",    "W", ///< width  of the main    video
@@ -117,6 +118,8 @@ typedef struct OverlayContext {
     enum EOFAction eof_action;  ///< action to take on EOF from source
 
     AVExpr *x_pexpr, *y_pexpr;
+
+    OverlayDSPContext dsp;
 } OverlayContext;
 
 static av_cold void uninit(AVFilterContext *ctx)
@@ -357,24 +360,64 @@ static int config_output(AVFilterLink *outlink)
 // ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)) is a faster version of: 255 * (x + y)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
+static int blend_row_c(uint8_t *d, const uint8_t *s, const uint8_t *a, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++)
+        d[k] = FAST_DIV255(d[k] * (255 - a[k]) + s[k] * a[k]);
+    return k;
+}
+
+static int blend_row_420_c(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                           ptrdiff_t alinesize, int w)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha = (a[2*k]             + a[2*k + 1] +
+                     a[2*k + alinesize] + a[2*k + alinesize + 1]) >> 2;
+        d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+    }
+    return k;
+}
+
+typedef struct ThreadData {
+    AVFrame *dst;
+    const AVFrame *src;
+    int x, y;
+} ThreadData;
+
 /**
- * Blend image in src to destination buffer dst at position (x, y).
+ * Restrict the rows range [*start, *end) to the part handled by job jobnr.
  */
-static void blend_image(AVFilterContext *ctx,
-                        AVFrame *dst, const AVFrame *src,
-                        int x, int y)
+static void slice_rows(int *start, int *end, int jobnr, int nb_jobs)
+{
+    const int n = FFMAX(*end - *start, 0);
+
+    *end   = *start + n * (jobnr+1) / nb_jobs;
+    *start = *start + n *  jobnr    / nb_jobs;
+}
+
+/**
+ * Blend a slice of the image in src to destination buffer dst at
+ * position (x, y).
+ */
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
+    const OverlayDSPContext *dsp = &s->dsp;
+    ThreadData *td = arg;
+    AVFrame *dst = td->dst;
+    const AVFrame *src = td->src;
+    const int x = td->x;
+    const int y = td->y;
     int i, imax, j, jmax, k, kmax;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
     const int dst_h = dst->height;
 
-    if (x >= dst_w || x+src_w < 0 ||
-        y >= dst_h || y+src_h < 0)
-        return; /* no intersection */
-
     if (s->main_is_packed_rgb) {
         uint8_t alpha;          ///< the amount of overlay to blend on to main
         const int dr = s->main_rgba_map[R];
@@ -390,11 +433,13 @@ static void blend_image(AVFilterContext *ctx,
         const int main_has_alpha = s->main_has_alpha;
         uint8_t *s, *sp, *d, *dp;
 
-        i = FFMAX(-y, 0);
+        i    = FFMAX(-y, 0);
+        imax = FFMIN(-y + dst_h, src_h);
+        slice_rows(&i, &imax, jobnr, nb_jobs);
         sp = src->data[0] + i     * src->linesize[0];
         dp = dst->data[0] + (y+i) * dst->linesize[0];
 
-        for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+        for (; i < imax; i++) {
             j = FFMAX(-x, 0);
             s = sp + j     * sstep;
             d = dp + (x+j) * dstep;
@@ -448,11 +493,13 @@ static void blend_image(AVFilterContext *ctx,
             uint8_t alpha;          ///< the amount of overlay to blend on to main
             uint8_t *s, *sa, *d, *da;
 
-            i = FFMAX(-y, 0);
+            i    = FFMAX(-y, 0);
+            imax = FFMIN(-y + dst_h, src_h);
+            slice_rows(&i, &imax, jobnr, nb_jobs);
             sa = src->data[3] + i     * src->linesize[3];
             da = dst->data[3] + (y+i) * dst->linesize[3];
 
-            for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+            for (; i < imax; i++) {
                 j = FFMAX(-x, 0);
                 s = sa + j;
                 d = da + x+j;
@@ -491,18 +538,35 @@ static void blend_image(AVFilterContext *ctx,
             int xp = x>>hsub;
             uint8_t *s, *sp, *d, *dp, *a, *ap;
 
-            j = FFMAX(-yp, 0);
+            j    = FFMAX(-yp, 0);
+            jmax = FFMIN(-yp + dst_hp, src_hp);
+            slice_rows(&j, &jmax, jobnr, nb_jobs);
             sp = src->data[i] + j         * src->linesize[i];
             dp = dst->data[i] + (yp+j)    * dst->linesize[i];
             ap = src->data[3] + (j<<vsub) * src->linesize[3];
 
-            for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+            for (; j < jmax; j++) {
                 k = FFMAX(-xp, 0);
                 d = dp + xp+k;
                 s = sp + k;
                 a = ap + (k<<hsub);
+                kmax = FFMIN(-xp + dst_wp, src_wp);
+
+                if (!main_has_alpha) {
+                    int n = 0;
+
+                    if (!hsub && !vsub)
+                        n = dsp->blend_row(d, s, a, kmax - k);
+                    else if (hsub && vsub && j+1 < src_hp)
+                        n = dsp->blend_row_420(d, s, a, src->linesize[3],
+                                               FFMIN(kmax, src_wp - 1) - k);
+                    d += n;
+                    s += n;
+                    a += n << hsub;
+                    k += n;
+                }
 
-                for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+                for (; k < kmax; k++) {
                     int alpha_v, alpha_h, alpha;
 
                     // average alpha for color components, improve quality
@@ -546,6 +610,7 @@ static void blend_image(AVFilterContext *ctx,
             }
         }
     }
+    return 0;
 }
 
 static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
@@ -570,7 +635,18 @@ static AVFrame *do_blend(AVFilterContext *ctx, AVFrame *mainpic,
                    s->var_values[VAR_Y], s->y);
         }
 
-    blend_image(ctx, mainpic, second, s->x, s->y);
+    if (s->x < mainpic->width  && s->x + second->width  >= 0 &&
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td = { .dst = mainpic, .src = second, .x = s->x, .y = s->y };
+        int nb_jobs = FFMIN(FFMIN(second->height, mainpic->height),
+                            ctx->graph->nb_threads);
+
+        /* the chroma planes of a main input with alpha are blended using
+         * neighbouring rows of the main picture, keep them in one job */
+        if (s->main_has_alpha && !s->main_is_packed_rgb)
+            nb_jobs = 1;
+        ctx->internal->execute(ctx, blend_slice, &td, NULL, FFMAX(nb_jobs, 1));
+    }
     return mainpic;
 }
 
@@ -605,6 +681,11 @@ static av_cold int init(AVFilterContext *ctx)
     }
 
     s->dinput.process = do_blend;
+
+    s->dsp.blend_row     = blend_row_c;
+    s->dsp.blend_row_420 = blend_row_420_c;
+    if (ARCH_X86)
+        ff_overlay_init_x86(&s->dsp);
     return 0;
 }
 
@@ -674,5 +755,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -0,0 +1,48 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_VF_OVERLAY_H
+#define AVFILTER_VF_OVERLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Row functions blending an overlay plane on top of a main plane without
+ * alpha: dst = (dst * (255 - alpha) + src * alpha) / 255, rounded to nearest.
+ * They return the number of pixels blended, which may be less than w; the
+ * remaining pixels are blended by the caller.
+ */
+typedef struct OverlayDSPContext {
+    /**
+     * Blend using one alpha value per pixel.
+     */
+    int (*blend_row)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int w);
+
+    /**
+     * Blend a chroma row of 4:2:0 content, using the average of the 2x2
+     * alpha values covering each pixel. alpha points to the upper row of
+     * the pair.
+     */
+    int (*blend_row_420)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha,
+                         ptrdiff_t alpha_linesize, int w);
+} OverlayDSPContext;
+
+void ff_overlay_init_x86(OverlayDSPContext *dsp);
+
+#endif /* AVFILTER_VF_OVERLAY_H */
@@ -289,10 +289,68 @@ static int frame_needs_copy(PadContext *s, AVFrame *frame)
     return 0;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int needs_copy;
+} ThreadData;
+
+static int pad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PadContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in, *out = td->out;
+    /* slices start on chroma lines, so that no chroma line is shared */
+    const int mask = (1 << s->draw.vsub_max) - 1;
+    const int slice_start = (s->h * jobnr) / nb_jobs & ~mask;
+    const int slice_end   = jobnr + 1 == nb_jobs ? s->h :
+                            (s->h * (jobnr+1)) / nb_jobs & ~mask;
+    int y0, y1;
+
+    /* top bar */
+    y1 = FFMIN(slice_end, s->y);
+    if (y1 > slice_start) {
+        ff_fill_rectangle(&s->draw, &s->color,
+                          out->data, out->linesize,
+                          0, slice_start, s->w, y1 - slice_start);
+    }
+
+    /* bottom bar */
+    y0 = FFMAX(slice_start, s->y + s->in_h);
+    if (slice_end > y0) {
+        ff_fill_rectangle(&s->draw, &s->color,
+                          out->data, out->linesize,
+                          0, y0, s->w, slice_end - y0);
+    }
+
+    y0 = FFMAX(slice_start, s->y);
+    y1 = FFMIN(slice_end,   s->y + in->height);
+    if (y1 <= y0)
+        return 0;
+
+    /* left border */
+    ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
+                      0, y0, s->x, y1 - y0);
+
+    if (td->needs_copy) {
+        ff_copy_rectangle2(&s->draw,
+                          out->data, out->linesize, in->data, in->linesize,
+                          s->x, y0, 0, y0 - s->y, in->width, y1 - y0);
+    }
+
+    /* right border */
+    ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
+                      s->x + s->in_w, y0, s->w - s->x - s->in_w,
+                      y1 - y0);
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
-    PadContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    PadContext *s = ctx->priv;
     AVFrame *out;
+    ThreadData td;
     int needs_copy = frame_needs_copy(s, in);
 
     if (needs_copy) {
@@ -318,34 +376,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
         }
     }
 
-    /* top bar */
-    if (s->y) {
-        ff_fill_rectangle(&s->draw, &s->color,
-                          out->data, out->linesize,
-                          0, 0, s->w, s->y);
-    }
-
-    /* bottom bar */
-    if (s->h > s->y + s->in_h) {
-        ff_fill_rectangle(&s->draw, &s->color,
-                          out->data, out->linesize,
-                          0, s->y + s->in_h, s->w, s->h - s->y - s->in_h);
-    }
-
-    /* left border */
-    ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
-                      0, s->y, s->x, in->height);
-
-    if (needs_copy) {
-        ff_copy_rectangle2(&s->draw,
-                          out->data, out->linesize, in->data, in->linesize,
-                          s->x, s->y, 0, 0, in->width, in->height);
-    }
-
-    /* right border */
-    ff_fill_rectangle(&s->draw, &s->color, out->data, out->linesize,
-                      s->x + s->in_w, s->y, s->w - s->x - s->in_w,
-                      in->height);
+    td.in         = in;
+    td.out        = out;
+    td.needs_copy = needs_copy;
+    ctx->internal->execute(ctx, pad_slice, &td, NULL,
+                           FFMIN(s->h, ctx->graph->nb_threads));
 
     out->width  = s->w;
     out->height = s->h;
@@ -399,4 +434,5 @@ AVFilter ff_vf_pad = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_pad_inputs,
     .outputs       = avfilter_vf_pad_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
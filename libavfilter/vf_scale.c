@@ -358,6 +358,9 @@ static int config_props(AVFilterLink *outlink)
                         return ret;
                 }
             }
+            /* use the filtergraph threads unless the scaler ones were set */
+            if (!av_dict_get(scale->opts, "threads", NULL, 0))
+                av_opt_set_int(*s, "threads", ctx->graph->nb_threads, 0);
 
             av_opt_set_int(*s, "srcw", inlink ->w, 0);
             av_opt_set_int(*s, "srch", inlink ->h >> !!i, 0);
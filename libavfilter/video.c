@@ -27,6 +27,7 @@
 #include "libavutil/buffer.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -37,13 +38,69 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
     return ff_get_video_buffer(link->dst->outputs[0], w, h);
 }
 
-/* TODO: set the buffer's priv member to a context structure for the whole
- * filter chain.  This will allow for a buffer pool instead of the constant
- * alloc & free cycle currently implemented. */
+#define BUFFER_ALIGN 32
+
+void ff_video_frame_pool_free(AVFilterPool **ppool)
+{
+    AVFilterPool *pool = *ppool;
+    int i;
+
+    if (!pool)
+        return;
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+    av_freep(ppool);
+}
+
+/* use the same layout as av_frame_get_buffer() */
+static AVFilterPool *video_frame_pool_alloc(int w, int h,
+                                              enum AVPixelFormat format)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+    AVFilterPool *pool;
+    int i;
+
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL) ||
+        av_image_check_size(w, h, 0, NULL) < 0)
+        return NULL;
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->width  = w;
+    pool->height = h;
+    pool->format = format;
+
+    for (i = 1; i <= BUFFER_ALIGN; i += i) {
+        if (av_image_fill_linesizes(pool->linesize, format, FFALIGN(w, i)) < 0)
+            goto fail;
+        if (!(pool->linesize[0] & (BUFFER_ALIGN - 1)))
+            break;
+    }
+
+    for (i = 0; i < 4 && pool->linesize[i]; i++) {
+        int plane_h = FFALIGN(h, 32);
+        if (i == 1 || i == 2)
+            plane_h = FF_CEIL_RSHIFT(plane_h, desc->log2_chroma_h);
+
+        pool->linesize[i] = FFALIGN(pool->linesize[i], BUFFER_ALIGN);
+        pool->pools[i] = av_buffer_pool_init2(pool->linesize[i] * plane_h + 16 + 16 - 1,
+                                              NULL, AV_BUFFER_POOL_FLAG_THREAD_CACHE);
+        if (!pool->pools[i])
+            goto fail;
+    }
+
+    return pool;
+fail:
+    ff_video_frame_pool_free(&pool);
+    return NULL;
+}
+
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
+    AVFilterPool *pool = link->pool;
     AVFrame *frame = av_frame_alloc();
-    int ret;
+    int i, ret;
 
     if (!frame)
         return NULL;
@@ -52,9 +109,30 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
     frame->height = h;
     frame->format = link->format;
 
-    ret = av_frame_get_buffer(frame, 32);
-    if (ret < 0)
-        av_frame_free(&frame);
+    if (!pool || pool->width != w || pool->height != h ||
+        pool->format != link->format) {
+        ff_video_frame_pool_free(&link->pool);
+        link->pool = pool = video_frame_pool_alloc(w, h, link->format);
+    }
+
+    /* formats with a palette are not pooled */
+    if (!pool) {
+        ret = av_frame_get_buffer(frame, BUFFER_ALIGN);
+        if (ret < 0)
+            av_frame_free(&frame);
+        return frame;
+    }
+
+    for (i = 0; i < 4 && pool->pools[i]; i++) {
+        frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+        if (!frame->buf[i]) {
+            av_frame_free(&frame);
+            return NULL;
+        }
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = pool->linesize[i];
+    }
+    frame->extended_data = frame->data;
 
     return frame;
 }
@@ -24,6 +24,12 @@
 #include "avfilter.h"
 
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h);
+
+/**
+ * Free a pool created by ff_default_get_video_buffer(). Buffers still in use
+ * stay valid.
+ */
+void ff_video_frame_pool_free(struct AVFilterPool **pool);
 AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h);
 
 /**
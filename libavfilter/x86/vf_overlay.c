@@ -0,0 +1,229 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/asm.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/vf_overlay.h"
+
+/*
+ * All the functions compute FAST_DIV255(d * (255 - a) + s * a) on 16-bit
+ * words: the sum never exceeds 255 * 255 + 128, and ((x + 128) * 257) >> 16
+ * is done with a pmulhuw by 257, so the results match the C code exactly.
+ */
+
+#if HAVE_SSE2_INLINE
+
+/* xmm3 = 257, xmm4 = 128, xmm6 = 255, xmm7 = 0 */
+#define LOAD_CONSTANTS_SSE2                     \
+    "pxor        %%xmm7, %%xmm7     \n\t"       \
+    "pcmpeqw     %%xmm6, %%xmm6     \n\t"       \
+    "psrlw           $8, %%xmm6     \n\t"       \
+    "pcmpeqw     %%xmm5, %%xmm5     \n\t"       \
+    "psrlw          $15, %%xmm5     \n\t"       \
+    "movdqa      %%xmm5, %%xmm4     \n\t"       \
+    "psllw           $7, %%xmm4     \n\t"       \
+    "movdqa      %%xmm6, %%xmm3     \n\t"       \
+    "paddw       %%xmm5, %%xmm3     \n\t"       \
+    "paddw       %%xmm5, %%xmm3     \n\t"
+
+/* d in xmm0 (bytes), s in xmm1 (bytes), a in xmm2 (words) */
+#define BLEND_SSE2                              \
+    "punpcklbw   %%xmm7, %%xmm0     \n\t"       \
+    "punpcklbw   %%xmm7, %%xmm1     \n\t"       \
+    "pmullw      %%xmm2, %%xmm1     \n\t"       \
+    "movdqa      %%xmm6, %%xmm5     \n\t"       \
+    "psubw       %%xmm2, %%xmm5     \n\t"       \
+    "pmullw      %%xmm5, %%xmm0     \n\t"       \
+    "paddw       %%xmm1, %%xmm0     \n\t"       \
+    "paddw       %%xmm4, %%xmm0     \n\t"       \
+    "pmulhuw     %%xmm3, %%xmm0     \n\t"       \
+    "packuswb    %%xmm0, %%xmm0     \n\t"
+
+static int blend_row_sse2(uint8_t *d, const uint8_t *s, const uint8_t *a, int w)
+{
+    int n = w & ~7;
+    x86_reg i = -n;
+
+    if (n <= 0)
+        return 0;
+
+    __asm__ volatile(
+        LOAD_CONSTANTS_SSE2
+        "1:                             \n\t"
+        "movq    (%3, %0), %%xmm2       \n\t"
+        "movq    (%1, %0), %%xmm0       \n\t"
+        "movq    (%2, %0), %%xmm1       \n\t"
+        "punpcklbw   %%xmm7, %%xmm2     \n\t"
+        BLEND_SSE2
+        "movq        %%xmm0, (%1, %0)   \n\t"
+        "add             $8, %0         \n\t"
+        "js              1b             \n\t"
+        : "+r"(i)
+        : "r"(d + n), "r"(s + n), "r"(a + n)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    return n;
+}
+
+static int blend_row_420_sse2(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                              ptrdiff_t alinesize, int w)
+{
+    int n = w & ~7;
+    x86_reg i = -n;
+
+    if (n <= 0)
+        return 0;
+
+    __asm__ volatile(
+        LOAD_CONSTANTS_SSE2
+        "1:                             \n\t"
+        "movdqu  (%3, %0, 2), %%xmm2    \n\t"
+        "movdqa      %%xmm2, %%xmm5     \n\t"
+        "psrlw           $8, %%xmm5     \n\t"
+        "pand        %%xmm6, %%xmm2     \n\t"
+        "paddw       %%xmm5, %%xmm2     \n\t"
+        "movdqu  (%4, %0, 2), %%xmm5    \n\t"
+        "movdqa      %%xmm5, %%xmm1     \n\t"
+        "psrlw           $8, %%xmm1     \n\t"
+        "pand        %%xmm6, %%xmm5     \n\t"
+        "paddw       %%xmm1, %%xmm2     \n\t"
+        "paddw       %%xmm5, %%xmm2     \n\t"
+        "psrlw           $2, %%xmm2     \n\t"
+        "movq    (%1, %0), %%xmm0       \n\t"
+        "movq    (%2, %0), %%xmm1       \n\t"
+        BLEND_SSE2
+        "movq        %%xmm0, (%1, %0)   \n\t"
+        "add             $8, %0         \n\t"
+        "js              1b             \n\t"
+        : "+r"(i)
+        : "r"(d + n), "r"(s + n), "r"(a + 2 * n), "r"(a + alinesize + 2 * n)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6", "xmm7",) "memory"
+    );
+    return n;
+}
+#endif /* HAVE_SSE2_INLINE */
+
+#if HAVE_AVX2_INLINE
+
+/* ymm3 = 257, ymm4 = 128, ymm6 = 255 */
+#define LOAD_CONSTANTS_AVX2                             \
+    "vpcmpeqw    %%ymm6, %%ymm6, %%ymm6     \n\t"       \
+    "vpsrlw          $8, %%ymm6, %%ymm6     \n\t"       \
+    "vpcmpeqw    %%ymm5, %%ymm5, %%ymm5     \n\t"       \
+    "vpsrlw         $15, %%ymm5, %%ymm5     \n\t"       \
+    "vpsllw          $7, %%ymm5, %%ymm4     \n\t"       \
+    "vpaddw      %%ymm5, %%ymm6, %%ymm3     \n\t"       \
+    "vpaddw      %%ymm5, %%ymm3, %%ymm3     \n\t"
+
+/* d in ymm0 (words), s in ymm1 (words), a in ymm2 (words) */
+#define BLEND_AVX2                                      \
+    "vpmullw     %%ymm2, %%ymm1, %%ymm1     \n\t"       \
+    "vpsubw      %%ymm2, %%ymm6, %%ymm5     \n\t"       \
+    "vpmullw     %%ymm5, %%ymm0, %%ymm0     \n\t"       \
+    "vpaddw      %%ymm1, %%ymm0, %%ymm0     \n\t"       \
+    "vpaddw      %%ymm4, %%ymm0, %%ymm0     \n\t"       \
+    "vpmulhuw    %%ymm3, %%ymm0, %%ymm0     \n\t"       \
+    "vextracti128    $1, %%ymm0, %%xmm1     \n\t"       \
+    "vpackuswb   %%xmm1, %%xmm0, %%xmm0     \n\t"
+
+static int blend_row_avx2(uint8_t *d, const uint8_t *s, const uint8_t *a, int w)
+{
+    int n = w & ~15;
+    x86_reg i = -n;
+
+    if (n <= 0)
+        return 0;
+
+    __asm__ volatile(
+        LOAD_CONSTANTS_AVX2
+        "1:                                     \n\t"
+        "vpmovzxbw   (%1, %0), %%ymm0           \n\t"
+        "vpmovzxbw   (%2, %0), %%ymm1           \n\t"
+        "vpmovzxbw   (%3, %0), %%ymm2           \n\t"
+        BLEND_AVX2
+        "vmovdqu     %%xmm0, (%1, %0)           \n\t"
+        "add            $16, %0                 \n\t"
+        "js              1b                     \n\t"
+        "vzeroupper                             \n\t"
+        : "+r"(i)
+        : "r"(d + n), "r"(s + n), "r"(a + n)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6",) "memory"
+    );
+    return n;
+}
+
+static int blend_row_420_avx2(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                              ptrdiff_t alinesize, int w)
+{
+    int n = w & ~15;
+    x86_reg i = -n;
+
+    if (n <= 0)
+        return 0;
+
+    __asm__ volatile(
+        LOAD_CONSTANTS_AVX2
+        "1:                                     \n\t"
+        "vmovdqu     (%3, %0, 2), %%ymm2        \n\t"
+        "vmovdqu     (%4, %0, 2), %%ymm1        \n\t"
+        "vpsrlw          $8, %%ymm2, %%ymm5     \n\t"
+        "vpand       %%ymm6, %%ymm2, %%ymm2     \n\t"
+        "vpaddw      %%ymm5, %%ymm2, %%ymm2     \n\t"
+        "vpsrlw          $8, %%ymm1, %%ymm5     \n\t"
+        "vpand       %%ymm6, %%ymm1, %%ymm1     \n\t"
+        "vpaddw      %%ymm5, %%ymm2, %%ymm2     \n\t"
+        "vpaddw      %%ymm1, %%ymm2, %%ymm2     \n\t"
+        "vpsrlw          $2, %%ymm2, %%ymm2     \n\t"
+        "vpmovzxbw   (%1, %0), %%ymm0           \n\t"
+        "vpmovzxbw   (%2, %0), %%ymm1           \n\t"
+        BLEND_AVX2
+        "vmovdqu     %%xmm0, (%1, %0)           \n\t"
+        "add            $16, %0                 \n\t"
+        "js              1b                     \n\t"
+        "vzeroupper                             \n\t"
+        : "+r"(i)
+        : "r"(d + n), "r"(s + n), "r"(a + 2 * n), "r"(a + alinesize + 2 * n)
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",
+                       "xmm4", "xmm5", "xmm6",) "memory"
+    );
+    return n;
+}
+#endif /* HAVE_AVX2_INLINE */
+
+av_cold void ff_overlay_init_x86(OverlayDSPContext *dsp)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+#if HAVE_SSE2_INLINE
+    if (INLINE_SSE2(cpu_flags)) {
+        dsp->blend_row     = blend_row_sse2;
+        dsp->blend_row_420 = blend_row_420_sse2;
+    }
+#endif
+#if HAVE_AVX2_INLINE
+    if (INLINE_AVX2(cpu_flags)) {
+        dsp->blend_row     = blend_row_avx2;
+        dsp->blend_row_420 = blend_row_420_avx2;
+    }
+#endif
+}
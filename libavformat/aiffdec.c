@@ -369,5 +369,6 @@ AVInputFormat ff_aiff_demuxer = {
     .read_header    = aiff_read_header,
     .read_packet    = aiff_read_packet,
     .read_seek      = ff_pcm_read_seek,
+    .flags          = AVFMT_ZERO_COPY,
     .codec_tag      = (const AVCodecTag* const []){ ff_codec_aiff_tags, 0 },
 };
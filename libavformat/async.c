@@ -0,0 +1,325 @@
+/*
+ * Asynchronous read-ahead protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Read-ahead wrapper for input streams.
+ *
+ * A background thread reads from the wrapped protocol into a FIFO while
+ * the caller consumes data from it, so that I/O latency overlaps with
+ * demuxing and decoding.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
+#include "libavutil/opt.h"
+#include "avformat.h"
+#include "url.h"
+
+#define READ_CHUNK_SIZE 32768
+
+typedef struct AsyncContext {
+    const AVClass *class;
+    URLContext *inner;
+    int readahead_size;
+
+    AVFifoBuffer *fifo;
+    uint8_t *read_buf;
+    int64_t logical_pos;
+    int64_t logical_size;
+
+    int seek_request;
+    int64_t seek_pos;
+    int seek_completed;
+    int64_t seek_ret;
+
+    int io_eof_reached;
+    int io_error;
+    int abort_request;
+
+    AVIOInterruptCB interrupt_callback;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_wakeup_main;
+    pthread_cond_t cond_wakeup_background;
+} AsyncContext;
+
+static int async_check_interrupt(void *arg)
+{
+    URLContext   *h = arg;
+    AsyncContext *c = h->priv_data;
+
+    if (c->abort_request)
+        return 1;
+    return ff_check_interrupt(&c->interrupt_callback);
+}
+
+static void *async_buffer_task(void *arg)
+{
+    URLContext   *h = arg;
+    AsyncContext *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int ret, size;
+
+        if (c->seek_request) {
+            int64_t pos = c->seek_pos;
+
+            pthread_mutex_unlock(&c->mutex);
+            ret = ffurl_seek(c->inner, pos, SEEK_SET);
+            pthread_mutex_lock(&c->mutex);
+
+            av_fifo_reset(c->fifo);
+            c->seek_ret       = ret;
+            c->seek_request   = 0;
+            c->seek_completed = 1;
+            c->io_eof_reached = 0;
+            c->io_error       = ret < 0 ? ret : 0;
+            pthread_cond_signal(&c->cond_wakeup_main);
+            continue;
+        }
+
+        size = FFMIN(av_fifo_space(c->fifo), READ_CHUNK_SIZE);
+        if (c->io_eof_reached || c->io_error || size <= 0) {
+            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&c->mutex);
+        ret = ffurl_read(c->inner, c->read_buf, size);
+        pthread_mutex_lock(&c->mutex);
+
+        /* the data read belongs to the old position, drop it */
+        if (c->seek_request)
+            continue;
+
+        if (ret > 0) {
+            av_fifo_generic_write(c->fifo, c->read_buf, ret, NULL);
+        } else if (ret == 0 || ret == AVERROR_EOF) {
+            c->io_eof_reached = 1;
+        } else {
+            c->io_error = ret;
+        }
+        pthread_cond_signal(&c->cond_wakeup_main);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+static int async_open(URLContext *h, const char *arg, int flags,
+                      AVDictionary **options)
+{
+    AsyncContext *c = h->priv_data;
+    AVIOInterruptCB interrupt_callback = { async_check_interrupt, h };
+    int ret;
+
+    if (flags & AVIO_FLAG_WRITE)
+        return AVERROR(ENOSYS);
+
+    av_strstart(arg, "async:", &arg);
+
+    c->fifo     = av_fifo_alloc(c->readahead_size);
+    c->read_buf = av_malloc(READ_CHUNK_SIZE);
+    if (!c->fifo || !c->read_buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* wrap the interrupt callback so that closing also aborts blocking
+     * reads of the inner protocol */
+    c->interrupt_callback = h->interrupt_callback;
+    ret = ffurl_open(&c->inner, arg, flags, &interrupt_callback, options);
+    if (ret < 0)
+        goto fail;
+
+    h->is_streamed  = c->inner->is_streamed;
+    c->logical_size = ffurl_size(c->inner);
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_main, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto mutex_fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_background, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto cond_main_fail;
+    }
+    ret = pthread_create(&c->thread, NULL, async_buffer_task, h);
+    if (ret) {
+        av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto cond_background_fail;
+    }
+
+    return 0;
+
+cond_background_fail:
+    pthread_cond_destroy(&c->cond_wakeup_background);
+cond_main_fail:
+    pthread_cond_destroy(&c->cond_wakeup_main);
+mutex_fail:
+    pthread_mutex_destroy(&c->mutex);
+fail:
+    ffurl_closep(&c->inner);
+    av_fifo_free(c->fifo);
+    c->fifo = NULL;
+    av_freep(&c->read_buf);
+    return ret;
+}
+
+static int async_close(URLContext *h)
+{
+    AsyncContext *c = h->priv_data;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_join(c->thread, NULL);
+
+    pthread_cond_destroy(&c->cond_wakeup_background);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+    ffurl_closep(&c->inner);
+    av_fifo_free(c->fifo);
+    c->fifo = NULL;
+    av_freep(&c->read_buf);
+
+    return 0;
+}
+
+static int async_read(URLContext *h, unsigned char *buf, int size)
+{
+    AsyncContext *c = h->priv_data;
+    int ret = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!av_fifo_size(c->fifo)) {
+        if (c->io_error) {
+            ret = c->io_error;
+            break;
+        }
+        if (c->io_eof_reached) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        if (ff_check_interrupt(&c->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+
+    if (!ret) {
+        ret = FFMIN(size, av_fifo_size(c->fifo));
+        av_fifo_generic_read(c->fifo, buf, ret, NULL);
+        c->logical_pos += ret;
+        pthread_cond_signal(&c->cond_wakeup_background);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+{
+    AsyncContext *c = h->priv_data;
+    int64_t ret;
+
+    if (whence == AVSEEK_SIZE)
+        return c->logical_size;
+
+    if (whence == SEEK_CUR) {
+        pos += c->logical_pos;
+    } else if (whence == SEEK_END) {
+        if (c->logical_size < 0)
+            return AVERROR(EINVAL);
+        pos += c->logical_size;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&c->mutex);
+
+    /* seeking forward within the read-ahead data only skips it */
+    if (!c->seek_request && pos >= c->logical_pos &&
+        pos - c->logical_pos <= av_fifo_size(c->fifo)) {
+        av_fifo_drain(c->fifo, pos - c->logical_pos);
+        c->logical_pos = pos;
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_mutex_unlock(&c->mutex);
+        return pos;
+    }
+
+    c->seek_request   = 1;
+    c->seek_pos       = pos;
+    c->seek_completed = 0;
+    pthread_cond_signal(&c->cond_wakeup_background);
+
+    while (!c->seek_completed)
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+
+    ret = c->seek_ret;
+    if (ret >= 0)
+        c->logical_pos = ret;
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+#define OFFSET(x) offsetof(AsyncContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+
+static const AVOption options[] = {
+    { "readahead_size", "set the size of the read-ahead buffer in bytes", OFFSET(readahead_size), AV_OPT_TYPE_INT, { .i64 = 4 * 1024 * 1024 }, READ_CHUNK_SIZE, INT_MAX, D },
+    { NULL }
+};
+
+static const AVClass async_context_class = {
+    .class_name = "async",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+URLProtocol ff_async_protocol = {
+    .name            = "async",
+    .url_open2       = async_open,
+    .url_read        = async_read,
+    .url_seek        = async_seek,
+    .url_close       = async_close,
+    .priv_data_size  = sizeof(AsyncContext),
+    .priv_data_class = &async_context_class,
+};
@@ -156,6 +156,7 @@ AVInputFormat ff_au_demuxer = {
     .read_header = au_read_header,
     .read_packet = ff_pcm_read_packet,
     .read_seek   = ff_pcm_read_seek,
+    .flags       = AVFMT_ZERO_COPY,
     .codec_tag   = (const AVCodecTag* const []) { codec_au_tags, 0 },
 };
 
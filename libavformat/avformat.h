@@ -436,6 +436,10 @@ typedef struct AVProbeData {
                                         */
 
 #define AVFMT_SEEK_TO_PTS   0x4000000 /**< Seeking is based on PTS */
+#define AVFMT_ZERO_COPY    0x10000000 /**< Demuxer neither modifies nor shrinks
+                                        the packets read with av_get_packet(),
+                                        so they can reference the input buffer
+                                        with AVFMT_FLAG_ZERO_COPY */
 
 /**
  * @addtogroup lavf_encoding
@@ -542,6 +546,12 @@ typedef struct AVOutputFormat {
      * @see avdevice_capabilities_free() for more details.
      */
     int (*free_device_capabilities)(struct AVFormatContext *s, struct AVDeviceCapabilitiesQuery *caps);
+    /**
+     * Free the private data of a muxer whose header was written. Called
+     * by av_write_trailer() after write_trailer, or by
+     * avformat_free_context() if the trailer was never written.
+     */
+    void (*deinit)(struct AVFormatContext *);
 } AVOutputFormat;
 /**
  * @}
@@ -568,7 +578,8 @@ typedef struct AVInputFormat {
     /**
      * Can use flags: AVFMT_NOFILE, AVFMT_NEEDNUMBER, AVFMT_SHOW_IDS,
      * AVFMT_GENERIC_INDEX, AVFMT_TS_DISCONT, AVFMT_NOBINSEARCH,
-     * AVFMT_NOGENSEARCH, AVFMT_NO_BYTE_SEEK, AVFMT_SEEK_TO_PTS.
+     * AVFMT_NOGENSEARCH, AVFMT_NO_BYTE_SEEK, AVFMT_SEEK_TO_PTS,
+     * AVFMT_ZERO_COPY.
      */
     int flags;
 
@@ -909,6 +920,17 @@ typedef struct AVStream {
         int64_t fps_last_dts;
         int     fps_last_dts_idx;
 
+        /**
+         * Statistics reported at the end of avformat_find_stream_info().
+         * found_time is the time in microseconds after which all codec
+         * parameters were known, AV_NOPTS_VALUE if they never were.
+         */
+        int64_t codec_info_bytes;
+        int64_t decode_time;
+        int64_t found_time;
+        int64_t found_bytes;
+        int     found_nb_frames;
+
     } *info;
 
     int pts_wrap_bits; /**< number of bits in pts (used for wrapping control) */
@@ -1248,6 +1270,14 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_SORT_DTS    0x10000 ///< try to interleave outputted packets by dts (using this flag can slow demuxing down)
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Don't merge side data but keep it separate.
+/**
+ * Return packets referencing the input buffer instead of copying their data
+ * when the demuxer supports it (AVFMT_ZERO_COPY). Packets larger than the
+ * input buffer are read into buffers of their own without going through it.
+ * Queued packets keep whole input buffers alive, i.e. 32 kB per buffer by
+ * default even for small packets. Has no effect with custom I/O.
+ */
+#define AVFMT_FLAG_ZERO_COPY   0x80000
 
     /**
      * Maximum size of the data read from input for determining
@@ -1604,6 +1634,21 @@ typedef struct AVFormatContext {
      * Muxing: set by user via AVOptions (NO direct access)
      */
     int64_t output_ts_offset;
+
+    /**
+     * Number of threads used to decode packets in avformat_find_stream_info(),
+     * 0 for automatic.
+     * Demuxing: set by user via AVOptions (NO direct access)
+     */
+    int analyze_threads;
+
+    /**
+     * Directory of the probe cache, which stores the stream parameters
+     * and index entries of local files so that they need not be probed
+     * again when the same file is opened.
+     * Demuxing: set by user via AVOptions (NO direct access)
+     */
+    char *probe_cache;
 } AVFormatContext;
 
 int av_format_get_probe_score(const AVFormatContext *s);
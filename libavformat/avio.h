@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
@@ -153,6 +154,13 @@ typedef struct AVIOContext {
      * This field is internal to libavformat and access from outside is not allowed.
      */
     int orig_buffer_size;
+
+    /**
+     * Reference to the buffer when it is refcounted, so that data read from
+     * it can be returned without copying, NULL otherwise.
+     * This field is internal to libavformat and access from outside is not allowed.
+     */
+    AVBufferRef *buffer_ref;
 } AVIOContext;
 
 /* unbuffered I/O */
@@ -54,6 +54,28 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Switch the read buffer of s to a refcounted buffer, which allows
+ * ffio_read_ref() to return data without copying it.
+ * The buffer is reallocated whenever it is refilled while still being
+ * referenced, so returned data stays valid for the lifetime of the reference.
+ * @return 0 on success, AVERROR otherwise
+ */
+int ffio_enable_buffer_ref(AVIOContext *s);
+
+/**
+ * Read size bytes from AVIOContext as a reference to the underlying buffer.
+ * This only succeeds if the buffer is refcounted and all the requested bytes
+ * are already buffered, or if size is larger than the buffer. In the latter
+ * case the bytes are read into a new buffer, directly from the protocol
+ * except for those already buffered, and fewer bytes are returned at the end
+ * of the stream. The data is followed by FF_INPUT_BUFFER_PADDING_SIZE zeroed
+ * bytes.
+ * @return a new reference with data and size set to the bytes read,
+ *         or NULL if nothing was read
+ */
+AVBufferRef *ffio_read_ref(AVIOContext *s, int size);
+
 /**
  * Read size bytes from AVIOContext into buf.
  * This reads at most 1 packet. If that is not enough fewer bytes will be
@@ -68,6 +68,33 @@ const AVClass ffio_url_class = {
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
 
+/**
+ * Allocate a new buffer for s, refcounted and padded if s uses a refcounted
+ * buffer.
+ */
+static uint8_t *alloc_buffer(AVIOContext *s, int size, AVBufferRef **ref)
+{
+    *ref = NULL;
+    if (!s->buffer_ref)
+        return av_malloc(size);
+
+    *ref = av_buffer_alloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!*ref)
+        return NULL;
+    memset((*ref)->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    return (*ref)->data;
+}
+
+static void replace_buffer(AVIOContext *s, uint8_t *buffer, AVBufferRef *ref)
+{
+    if (s->buffer_ref)
+        av_buffer_unref(&s->buffer_ref);
+    else
+        av_free(s->buffer);
+    s->buffer     = buffer;
+    s->buffer_ref = ref;
+}
+
 int ffio_init_context(AVIOContext *s,
                   unsigned char *buffer,
                   int buffer_size,
@@ -78,6 +105,7 @@ int ffio_init_context(AVIOContext *s,
                   int64_t (*seek)(void *opaque, int64_t offset, int whence))
 {
     s->buffer      = buffer;
+    s->buffer_ref  = NULL;
     s->orig_buffer_size =
     s->buffer_size = buffer_size;
     s->buf_ptr     = buffer;
@@ -445,6 +473,24 @@ static void fill_buffer(AVIOContext *s)
         len = s->orig_buffer_size;
     }
 
+    /* do not overwrite data still referenced by packets */
+    if (s->read_packet && s->buffer_ref &&
+        !av_buffer_is_writable(s->buffer_ref)) {
+        AVBufferRef *ref;
+        uint8_t *buffer = alloc_buffer(s, s->buffer_size, &ref);
+        if (!buffer) {
+            s->eof_reached = 1;
+            s->error = AVERROR(ENOMEM);
+            return;
+        }
+        memcpy(buffer, s->buffer, dst - s->buffer);
+        s->checksum_ptr = buffer + (s->checksum_ptr - s->buffer);
+        s->buf_ptr      = buffer + (s->buf_ptr      - s->buffer);
+        s->buf_end      = buffer + (s->buf_end      - s->buffer);
+        dst             = buffer + (dst             - s->buffer);
+        replace_buffer(s, buffer, ref);
+    }
+
     if (s->read_packet)
         len = s->read_packet(s->opaque, dst, len);
     else
@@ -460,6 +506,8 @@ static void fill_buffer(AVIOContext *s)
         s->buf_ptr = dst;
         s->buf_end = dst + len;
         s->bytes_read += len;
+        if (s->buffer_ref)
+            memset(s->buf_end, 0, FF_INPUT_BUFFER_PADDING_SIZE);
     }
 }
 
@@ -564,6 +612,116 @@ int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsig
     }
 }
 
+int ffio_enable_buffer_ref(AVIOContext *s)
+{
+    AVBufferRef *ref;
+    int filled = s->buf_end - s->buffer;
+
+    if (s->buffer_ref)
+        return 0;
+    if (s->write_flag)
+        return AVERROR(EINVAL);
+
+    ref = av_buffer_alloc(s->buffer_size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!ref)
+        return AVERROR(ENOMEM);
+    memcpy(ref->data, s->buffer, filled);
+    memset(ref->data + filled, 0,
+           s->buffer_size - filled + FF_INPUT_BUFFER_PADDING_SIZE);
+
+    s->checksum_ptr = ref->data + (s->checksum_ptr - s->buffer);
+    s->buf_ptr      = ref->data + (s->buf_ptr      - s->buffer);
+    s->buf_end      = ref->data + filled;
+    av_free(s->buffer);
+    s->buffer       = ref->data;
+    s->buffer_ref   = ref;
+    return 0;
+}
+
+/* Read a packet larger than the buffer into a buffer of its own, reading the
+ * part that is not buffered yet directly into it. */
+static AVBufferRef *read_ref_direct(AVIOContext *s, int size)
+{
+    AVBufferRef *ref;
+    int len = s->buf_end - s->buf_ptr;
+
+    if (!s->read_packet || s->update_checksum)
+        return NULL;
+    ref = av_buffer_alloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!ref)
+        return NULL;
+
+    memcpy(ref->data, s->buf_ptr, len);
+    s->buf_ptr = s->buf_end = s->buffer;
+    while (len < size) {
+        int ret = s->read_packet(s->opaque, ref->data + len, size - len);
+        if (ret <= 0) {
+            s->eof_reached = 1;
+            if (ret < 0)
+                s->error = ret;
+            break;
+        }
+        s->pos        += ret;
+        s->bytes_read += ret;
+        len           += ret;
+    }
+    if (!len) {
+        av_buffer_unref(&ref);
+        return NULL;
+    }
+    memset(ref->data + len, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    ref->size = len;
+    return ref;
+}
+
+AVBufferRef *ffio_read_ref(AVIOContext *s, int size)
+{
+    AVBufferRef *ref, *tail_ref = NULL;
+    uint8_t *end = s->buf_ptr + size, *tail_buf = NULL;
+    int tail;
+
+    if (!s->buffer_ref || size <= 0)
+        return NULL;
+    if (s->buf_end - s->buf_ptr < size)
+        return size > s->buffer_size ? read_ref_direct(s, size) : NULL;
+
+    /* The padding of the returned data is zeroed, which overwrites the start
+     * of the data following it. If that data has not been read yet it is
+     * moved to a new buffer first; this drops the data before it, so it is
+     * only done when s is seekable and the move is cheaper than a copy. */
+    tail = s->buf_end - end;
+    if (tail) {
+        if (!s->seekable || tail > size)
+            return NULL;
+        tail_buf = alloc_buffer(s, s->buffer_size, &tail_ref);
+        if (!tail_buf)
+            return NULL;
+    }
+
+    ref = av_buffer_ref(s->buffer_ref);
+    if (!ref) {
+        av_buffer_unref(&tail_ref);
+        return NULL;
+    }
+    ref->data = s->buf_ptr;
+    ref->size = size;
+
+    if (tail) {
+        if (s->update_checksum && end > s->checksum_ptr)
+            s->checksum = s->update_checksum(s->checksum, s->checksum_ptr,
+                                             end - s->checksum_ptr);
+        memcpy(tail_buf, end, tail);
+        replace_buffer(s, tail_buf, tail_ref);
+        s->checksum_ptr = s->buf_ptr = tail_buf;
+        s->buf_end      = tail_buf + tail;
+        memset(s->buf_end, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    } else {
+        s->buf_ptr = end;
+    }
+    memset(end, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    return ref;
+}
+
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -766,6 +924,7 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
 
 int ffio_ensure_seekback(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
     int max_buffer_size = s->max_packet_size ?
                           s->max_packet_size : IO_BUFFER_SIZE;
@@ -777,28 +936,27 @@ int ffio_ensure_seekback(AVIOContext *s, int buf_size)
         return 0;
     av_assert0(!s->write_flag);
 
-    buffer = av_malloc(buf_size);
+    buffer = alloc_buffer(s, buf_size, &ref);
     if (!buffer)
         return AVERROR(ENOMEM);
 
     memcpy(buffer, s->buffer, filled);
-    av_free(s->buffer);
     s->buf_ptr = buffer + (s->buf_ptr - s->buffer);
     s->buf_end = buffer + (s->buf_end - s->buffer);
-    s->buffer = buffer;
+    replace_buffer(s, buffer, ref);
     s->buffer_size = buf_size;
     return 0;
 }
 
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref;
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
+    buffer = alloc_buffer(s, buf_size, &ref);
     if (!buffer)
         return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
-    s->buffer = buffer;
+    replace_buffer(s, buffer, ref);
     s->orig_buffer_size =
     s->buffer_size = buf_size;
     s->buf_ptr = buffer;
@@ -853,8 +1011,9 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char **bufp, int buf_si
         buf_size = new_size;
     }
 
-    av_free(s->buffer);
-    s->buf_ptr = s->buffer = buf;
+    /* the probe buffer is not refcounted, return to copying reads */
+    replace_buffer(s, buf, NULL);
+    s->buf_ptr = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
     s->buf_end = s->buf_ptr + buf_size;
@@ -895,7 +1054,7 @@ int avio_close(AVIOContext *s)
 
     avio_flush(s);
     h = s->opaque;
-    av_freep(&s->buffer);
+    replace_buffer(s, NULL, NULL);
     if (s->write_flag)
         av_log(s, AV_LOG_DEBUG, "Statistics: %d seeks, %d writeouts\n", s->seek_count, s->writeout_count);
     else
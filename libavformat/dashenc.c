@@ -0,0 +1,634 @@
+/*
+ * MPEG-DASH ISO BMFF segmenter
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include <time.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/opt.h"
+
+#include "avc.h"
+#include "avformat.h"
+#include "internal.h"
+#include "isom.h"
+#include "os_support.h"
+#include "url.h"
+
+typedef struct Segment {
+    char file[1024];
+    int64_t time;
+    int duration;
+    int64_t size;
+    int n;
+} Segment;
+
+typedef struct OutputStream {
+    AVFormatContext *ctx;
+    int ctx_inited;
+    uint8_t iobuf[32768];
+    URLContext *out;
+    int64_t pos;
+    int packets_written;
+    char initfile[1024];
+    int nb_segments, segments_size, segment_index;
+    Segment **segments;
+    int64_t first_dts, start_dts, end_dts;
+    int max_bandwidth;
+    char codec_str[100];
+} OutputStream;
+
+typedef struct DASHContext {
+    const AVClass *class;  /* Class for private options. */
+    int window_size;
+    int extra_window_size;
+    int64_t min_seg_duration;
+    int remove_at_exit;
+    int use_template;
+    int use_timeline;
+    OutputStream *streams;
+    int has_video, has_audio;
+    int nb_segments;
+    int64_t last_duration;
+    int64_t total_duration;
+    char availability_start_time[100];
+    char dirname[1024];
+} DASHContext;
+
+static int dash_write(void *opaque, uint8_t *buf, int buf_size)
+{
+    OutputStream *os = opaque;
+    if (os->out)
+        ffurl_write(os->out, buf, buf_size);
+    os->pos += buf_size;
+    return buf_size;
+}
+
+/**
+ * Build the RFC 6381 codecs parameter of a stream, matching the sample
+ * entry the mp4 muxer writes for it.
+ */
+static void set_codec_str(AVCodecContext *codec, char *str, int size)
+{
+    const AVCodecTag *tags[2] = { ff_mp4_obj_type, NULL };
+    int oti = av_codec_get_tag(tags, codec->codec_id);
+
+    switch (codec->codec_id) {
+    case AV_CODEC_ID_H264: {
+        uint8_t *tmpbuf = NULL;
+        uint8_t *extradata = codec->extradata;
+        int extradata_size = codec->extradata_size;
+
+        av_strlcpy(str, "avc1", size);
+        if (!extradata_size)
+            return;
+        if (extradata[0] != 1) {
+            AVIOContext *pb;
+            if (avio_open_dyn_buf(&pb) < 0)
+                return;
+            if (ff_isom_write_avcc(pb, extradata, extradata_size) < 0) {
+                avio_close_dyn_buf(pb, &tmpbuf);
+                av_free(tmpbuf);
+                return;
+            }
+            extradata_size = avio_close_dyn_buf(pb, &extradata);
+            tmpbuf = extradata;
+        }
+        if (extradata_size >= 4)
+            av_strlcatf(str, size, ".%02x%02x%02x",
+                        extradata[1], extradata[2], extradata[3]);
+        av_free(tmpbuf);
+        break;
+    }
+    case AV_CODEC_ID_HEVC:  av_strlcpy(str, "hev1", size); break;
+    case AV_CODEC_ID_AC3:   av_strlcpy(str, "ac-3", size); break;
+    case AV_CODEC_ID_DIRAC: av_strlcpy(str, "drac", size); break;
+    case AV_CODEC_ID_VC1:   av_strlcpy(str, "vc-1", size); break;
+    default:
+        if (!oti)
+            return;
+        snprintf(str, size, "%s.%02x",
+                 codec->codec_type == AVMEDIA_TYPE_VIDEO ? "mp4v" : "mp4a", oti);
+        /* add the audio object type of AAC */
+        if (codec->codec_id == AV_CODEC_ID_AAC && codec->extradata_size >= 2) {
+            int aot = codec->extradata[0] >> 3;
+            if (aot == 31)
+                aot = ((AV_RB16(codec->extradata) >> 5) & 0x3f) + 32;
+            av_strlcatf(str, size, ".%d", aot);
+        }
+    }
+}
+
+static void dash_free(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int i, j;
+    if (!c->streams)
+        return;
+    for (i = 0; i < s->nb_streams; i++) {
+        OutputStream *os = &c->streams[i];
+        ffurl_close(os->out);
+        os->out = NULL;
+        if (os->ctx && os->ctx_inited)
+            av_write_trailer(os->ctx);
+        if (os->ctx && os->ctx->pb)
+            av_free(os->ctx->pb);
+        if (os->ctx)
+            avformat_free_context(os->ctx);
+        for (j = 0; j < os->nb_segments; j++)
+            av_free(os->segments[j]);
+        av_free(os->segments);
+    }
+    av_freep(&c->streams);
+}
+
+static void output_segment_list(OutputStream *os, AVIOContext *out, DASHContext *c,
+                                int representation_id)
+{
+    AVRational time_base = os->ctx->streams[0]->time_base;
+    int i, start_index = 0, start_number = 1;
+
+    if (c->window_size)
+        start_index = FFMAX(os->nb_segments - c->window_size, 0);
+    if (start_index < os->nb_segments)
+        start_number = os->segments[start_index]->n;
+
+    if (c->use_template) {
+        avio_printf(out, "\t\t\t\t<SegmentTemplate timescale=\"%d\" ", time_base.den);
+        if (!c->use_timeline)
+            avio_printf(out, "duration=\"%"PRId64"\" ",
+                        av_rescale(c->min_seg_duration, time_base.den, AV_TIME_BASE));
+        avio_printf(out, "initialization=\"init-stream$RepresentationID$.m4s\" "
+                         "media=\"chunk-stream$RepresentationID$-$Number%%05d$.m4s\" "
+                         "startNumber=\"%d\">\n", c->use_timeline ? start_number : 1);
+        if (c->use_timeline) {
+            int64_t cur_time = 0;
+            avio_printf(out, "\t\t\t\t\t<SegmentTimeline>\n");
+            for (i = start_index; i < os->nb_segments; ) {
+                Segment *seg = os->segments[i];
+                int repeat = 0;
+                avio_printf(out, "\t\t\t\t\t\t<S ");
+                if (i == start_index || seg->time != cur_time)
+                    avio_printf(out, "t=\"%"PRId64"\" ", seg->time);
+                avio_printf(out, "d=\"%d\" ", seg->duration);
+                while (i + repeat + 1 < os->nb_segments &&
+                       os->segments[i + repeat + 1]->duration == seg->duration &&
+                       os->segments[i + repeat + 1]->time == os->segments[i + repeat]->time + os->segments[i + repeat]->duration)
+                    repeat++;
+                if (repeat > 0)
+                    avio_printf(out, "r=\"%d\" ", repeat);
+                avio_printf(out, "/>\n");
+                i += 1 + repeat;
+                cur_time = seg->time + (1 + repeat) * (int64_t)seg->duration;
+            }
+            avio_printf(out, "\t\t\t\t\t</SegmentTimeline>\n");
+        }
+        avio_printf(out, "\t\t\t\t</SegmentTemplate>\n");
+    } else {
+        avio_printf(out, "\t\t\t\t<SegmentList timescale=\"%d\" duration=\"%"PRId64"\" startNumber=\"%d\">\n",
+                    time_base.den, av_rescale(c->last_duration, time_base.den, AV_TIME_BASE),
+                    start_number);
+        avio_printf(out, "\t\t\t\t\t<Initialization sourceURL=\"init-stream%d.m4s\" />\n",
+                    representation_id);
+        for (i = start_index; i < os->nb_segments; i++)
+            avio_printf(out, "\t\t\t\t\t<SegmentURL media=\"%s\" />\n",
+                        os->segments[i]->file);
+        avio_printf(out, "\t\t\t\t</SegmentList>\n");
+    }
+}
+
+static void write_time(AVIOContext *out, int64_t time)
+{
+    int seconds = time / AV_TIME_BASE;
+    int fractions = time % AV_TIME_BASE;
+    int minutes = seconds / 60;
+    int hours = minutes / 60;
+    seconds %= 60;
+    minutes %= 60;
+    avio_printf(out, "PT");
+    if (hours)
+        avio_printf(out, "%dH", hours);
+    if (hours || minutes)
+        avio_printf(out, "%dM", minutes);
+    avio_printf(out, "%d.%dS", seconds, fractions / (AV_TIME_BASE / 10));
+}
+
+static void write_adaptation_set(AVFormatContext *s, AVIOContext *out,
+                                 enum AVMediaType type)
+{
+    DASHContext *c = s->priv_data;
+    int i;
+
+    avio_printf(out, "\t\t<AdaptationSet contentType=\"%s\" segmentAlignment=\"true\" bitstreamSwitching=\"true\">\n",
+                type == AVMEDIA_TYPE_VIDEO ? "video" : "audio");
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        OutputStream *os = &c->streams[i];
+        int bandwidth = st->codec->bit_rate ? st->codec->bit_rate : os->max_bandwidth;
+
+        if (st->codec->codec_type != type)
+            continue;
+        avio_printf(out, "\t\t\t<Representation id=\"%d\" mimeType=\"%s/mp4\" codecs=\"%s\" bandwidth=\"%d\"",
+                    i, type == AVMEDIA_TYPE_VIDEO ? "video" : "audio",
+                    os->codec_str, bandwidth);
+        if (type == AVMEDIA_TYPE_VIDEO) {
+            avio_printf(out, " width=\"%d\" height=\"%d\">\n",
+                        st->codec->width, st->codec->height);
+        } else {
+            avio_printf(out, " audioSamplingRate=\"%d\">\n", st->codec->sample_rate);
+            avio_printf(out, "\t\t\t\t<AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%d\" />\n",
+                        st->codec->channels);
+        }
+        output_segment_list(os, out, c, i);
+        avio_printf(out, "\t\t\t</Representation>\n");
+    }
+    avio_printf(out, "\t\t</AdaptationSet>\n");
+}
+
+static int write_manifest(AVFormatContext *s, int final)
+{
+    DASHContext *c = s->priv_data;
+    AVIOContext *out;
+    char temp_filename[1024];
+    int ret;
+
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", s->filename);
+    ret = avio_open2(&out, temp_filename, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+    if (ret < 0) {
+        av_log(s, AV_LOG_ERROR, "Unable to open %s for writing\n", temp_filename);
+        return ret;
+    }
+    avio_printf(out, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+    avio_printf(out, "<MPD xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n"
+                "\txmlns=\"urn:mpeg:dash:schema:mpd:2011\"\n"
+                "\txmlns:xlink=\"http://www.w3.org/1999/xlink\"\n"
+                "\txsi:schemaLocation=\"urn:mpeg:DASH:schema:MPD:2011 http://standards.iso.org/ittf/PubliclyAvailableStandards/MPEG-DASH_schema_files/DASH-MPD.xsd\"\n"
+                "\tprofiles=\"urn:mpeg:dash:profile:isoff-live:2011\"\n"
+                "\ttype=\"%s\"\n", final ? "static" : "dynamic");
+    if (final) {
+        avio_printf(out, "\tmediaPresentationDuration=\"");
+        write_time(out, c->total_duration);
+        avio_printf(out, "\"\n");
+    } else {
+        int update_period = c->last_duration / AV_TIME_BASE;
+        if (c->use_template && !c->use_timeline)
+            update_period = 500;
+        avio_printf(out, "\tminimumUpdatePeriod=\"PT%dS\"\n", update_period);
+        avio_printf(out, "\tsuggestedPresentationDelay=\"PT%dS\"\n", update_period);
+        if (!c->availability_start_time[0] && s->nb_streams > 0 &&
+            c->streams[0].nb_segments > 0) {
+            time_t t = time(NULL);
+            struct tm *ptm = gmtime(&t);
+            if (!ptm || !strftime(c->availability_start_time,
+                                  sizeof(c->availability_start_time),
+                                  "%Y-%m-%dT%H:%M:%SZ", ptm))
+                c->availability_start_time[0] = '\0';
+        }
+        if (c->availability_start_time[0])
+            avio_printf(out, "\tavailabilityStartTime=\"%s\"\n", c->availability_start_time);
+        if (c->window_size && c->use_template) {
+            avio_printf(out, "\ttimeShiftBufferDepth=\"");
+            write_time(out, c->last_duration * c->window_size);
+            avio_printf(out, "\"\n");
+        }
+    }
+    avio_printf(out, "\tminBufferTime=\"");
+    write_time(out, c->last_duration);
+    avio_printf(out, "\">\n");
+    avio_printf(out, "\t<Period start=\"PT0.0S\">\n");
+
+    if (c->has_video)
+        write_adaptation_set(s, out, AVMEDIA_TYPE_VIDEO);
+    if (c->has_audio)
+        write_adaptation_set(s, out, AVMEDIA_TYPE_AUDIO);
+    avio_printf(out, "\t</Period>\n");
+    avio_printf(out, "</MPD>\n");
+    avio_flush(out);
+    avio_close(out);
+    if (rename(temp_filename, s->filename) < 0)
+        return AVERROR(errno);
+    return 0;
+}
+
+static int dash_write_header(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+    int ret = 0, i;
+    AVOutputFormat *oformat;
+    char *ptr;
+
+    av_strlcpy(c->dirname, s->filename, sizeof(c->dirname));
+    ptr = strrchr(c->dirname, '/');
+    if (ptr)
+        ptr[1] = '\0';
+    else
+        c->dirname[0] = '\0';
+
+    oformat = av_guess_format("mp4", NULL, NULL);
+    if (!oformat) {
+        ret = AVERROR_MUXER_NOT_FOUND;
+        goto fail;
+    }
+
+    c->streams = av_mallocz(sizeof(*c->streams) * s->nb_streams);
+    if (!c->streams) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        OutputStream *os = &c->streams[i];
+        AVFormatContext *ctx;
+        AVStream *st;
+        AVDictionary *opts = NULL;
+        char filename[1024];
+
+        if (s->streams[i]->codec->codec_type != AVMEDIA_TYPE_VIDEO &&
+            s->streams[i]->codec->codec_type != AVMEDIA_TYPE_AUDIO) {
+            av_log(s, AV_LOG_ERROR, "Stream %d is neither audio nor video\n", i);
+            ret = AVERROR(EINVAL);
+            goto fail;
+        }
+
+        ctx = avformat_alloc_context();
+        if (!ctx) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        os->ctx = ctx;
+        ctx->oformat = oformat;
+        ctx->interrupt_callback = s->interrupt_callback;
+
+        if (!(st = avformat_new_stream(ctx, NULL))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        avcodec_copy_context(st->codec, s->streams[i]->codec);
+        st->sample_aspect_ratio = s->streams[i]->sample_aspect_ratio;
+        st->time_base = s->streams[i]->time_base;
+        ctx->avoid_negative_ts = s->avoid_negative_ts;
+
+        ctx->pb = avio_alloc_context(os->iobuf, sizeof(os->iobuf), AVIO_FLAG_WRITE, os, NULL, dash_write, NULL);
+        if (!ctx->pb) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+
+        snprintf(os->initfile, sizeof(os->initfile), "init-stream%d.m4s", i);
+        snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
+        ret = ffurl_open(&os->out, filename, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+        if (ret < 0)
+            goto fail;
+
+        av_dict_set(&opts, "movflags", "frag_custom+dash+empty_moov+omit_tfhd_offset", 0);
+        ret = avformat_write_header(ctx, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+            goto fail;
+        os->ctx_inited = 1;
+        avio_flush(ctx->pb);
+        ffurl_close(os->out);
+        os->out = NULL;
+
+        s->streams[i]->time_base = st->time_base;
+        // If the muxer wants to shift timestamps, request to have them shifted
+        // already before being handed to this muxer, so we don't have mismatches
+        // between the MPD and the actual segments.
+        s->avoid_negative_ts = ctx->avoid_negative_ts;
+        if (st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+            c->has_video = 1;
+        else
+            c->has_audio = 1;
+
+        set_codec_str(st->codec, os->codec_str, sizeof(os->codec_str));
+        os->first_dts = AV_NOPTS_VALUE;
+        os->segment_index = 1;
+    }
+
+    if (!c->has_video && c->min_seg_duration <= 0) {
+        av_log(s, AV_LOG_WARNING, "no video stream and no min seg duration set\n");
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+    ret = write_manifest(s, 0);
+
+fail:
+    if (ret)
+        dash_free(s);
+    return ret;
+}
+
+static int add_segment(OutputStream *os, const char *file,
+                       int64_t time, int duration, int64_t size)
+{
+    int err;
+    Segment *seg;
+    if (os->nb_segments >= os->segments_size) {
+        os->segments_size = (os->segments_size + 1) * 2;
+        if ((err = av_reallocp(&os->segments, sizeof(*os->segments) *
+                               os->segments_size)) < 0) {
+            os->segments_size = 0;
+            os->nb_segments = 0;
+            return err;
+        }
+    }
+    seg = av_mallocz(sizeof(*seg));
+    if (!seg)
+        return AVERROR(ENOMEM);
+    av_strlcpy(seg->file, file, sizeof(seg->file));
+    seg->time = time;
+    seg->duration = duration;
+    seg->size = size;
+    seg->n = os->segment_index;
+    os->segments[os->nb_segments++] = seg;
+    os->segment_index++;
+    return 0;
+}
+
+static int dash_flush(AVFormatContext *s, int final)
+{
+    DASHContext *c = s->priv_data;
+    int i, ret = 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        OutputStream *os = &c->streams[i];
+        AVStream *st = os->ctx->streams[0];
+        char filename[1024], full_path[1024], temp_path[1024];
+        int64_t start_pos = os->pos, duration;
+
+        if (!os->packets_written)
+            continue;
+
+        snprintf(filename, sizeof(filename), "chunk-stream%d-%05d.m4s", i, os->segment_index);
+        snprintf(full_path, sizeof(full_path), "%s%s", c->dirname, filename);
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", full_path);
+        ret = ffurl_open(&os->out, temp_path, AVIO_FLAG_WRITE, &s->interrupt_callback, NULL);
+        if (ret < 0)
+            break;
+        av_write_frame(os->ctx, NULL);
+        avio_flush(os->ctx->pb);
+        os->packets_written = 0;
+
+        ffurl_close(os->out);
+        os->out = NULL;
+        if (rename(temp_path, full_path) < 0) {
+            ret = AVERROR(errno);
+            break;
+        }
+
+        duration = os->end_dts - os->start_dts;
+        if (duration > 0) {
+            int bandwidth = av_rescale_q(8 * (os->pos - start_pos),
+                                         (AVRational){ 1, 1 }, st->time_base) / duration;
+            os->max_bandwidth = FFMAX(os->max_bandwidth, bandwidth);
+        }
+        ret = add_segment(os, filename, os->start_dts - os->first_dts,
+                          duration, os->pos - start_pos);
+        if (ret < 0)
+            break;
+        c->last_duration = FFMAX(c->last_duration,
+                                 av_rescale_q(duration, st->time_base, AV_TIME_BASE_Q));
+        c->total_duration = FFMAX(c->total_duration,
+                                  av_rescale_q(os->end_dts - os->first_dts,
+                                               st->time_base, AV_TIME_BASE_Q));
+    }
+
+    if (ret >= 0 && (c->window_size || (final && c->remove_at_exit))) {
+        for (i = 0; i < s->nb_streams; i++) {
+            OutputStream *os = &c->streams[i];
+            int j;
+            int remove = os->nb_segments - c->window_size - c->extra_window_size;
+            if (final && c->remove_at_exit)
+                remove = os->nb_segments;
+            if (remove > 0) {
+                for (j = 0; j < remove; j++) {
+                    char file[1024];
+                    snprintf(file, sizeof(file), "%s%s", c->dirname, os->segments[j]->file);
+                    unlink(file);
+                    av_free(os->segments[j]);
+                }
+                os->nb_segments -= remove;
+                memmove(os->segments, os->segments + remove, os->nb_segments * sizeof(*os->segments));
+            }
+        }
+    }
+
+    if (ret >= 0)
+        ret = write_manifest(s, final);
+    return ret;
+}
+
+static int dash_write_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    DASHContext *c = s->priv_data;
+    AVStream *st = s->streams[pkt->stream_index];
+    OutputStream *os = &c->streams[pkt->stream_index];
+    int64_t seg_end_duration = (c->nb_segments + 1) * (int64_t) c->min_seg_duration;
+    int ret;
+
+    if (os->first_dts == AV_NOPTS_VALUE)
+        os->first_dts = os->end_dts = pkt->dts;
+
+    /* Cut all streams at the same time, at a key frame of the video stream
+     * if there is one, so that the segments of all representations align. */
+    if ((!c->has_video || st->codec->codec_type == AVMEDIA_TYPE_VIDEO) &&
+        pkt->flags & AV_PKT_FLAG_KEY && os->packets_written &&
+        av_compare_ts(pkt->dts - os->first_dts, st->time_base,
+                      seg_end_duration, AV_TIME_BASE_Q) >= 0) {
+
+        if ((ret = dash_flush(s, 0)) < 0)
+            return ret;
+        c->nb_segments++;
+    }
+
+    if (!os->packets_written)
+        os->start_dts = pkt->dts;
+    os->end_dts = FFMAX(os->end_dts, pkt->dts + pkt->duration);
+    os->packets_written++;
+    return ff_write_chained(os->ctx, 0, pkt, s);
+}
+
+static int dash_write_trailer(AVFormatContext *s)
+{
+    DASHContext *c = s->priv_data;
+
+    if (s->nb_streams > 0) {
+        OutputStream *os = &c->streams[0];
+        // If no segments have been written so far, try to do a crude
+        // guess of the segment duration
+        if (!c->last_duration)
+            c->last_duration = av_rescale_q(os->end_dts - os->start_dts,
+                                            s->streams[0]->time_base,
+                                            AV_TIME_BASE_Q);
+    }
+    dash_flush(s, 1);
+
+    if (c->remove_at_exit) {
+        char filename[1024];
+        int i;
+        for (i = 0; i < s->nb_streams; i++) {
+            OutputStream *os = &c->streams[i];
+            snprintf(filename, sizeof(filename), "%s%s", c->dirname, os->initfile);
+            unlink(filename);
+        }
+        unlink(s->filename);
+    }
+
+    dash_free(s);
+    return 0;
+}
+
+#define OFFSET(x) offsetof(DASHContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "window_size", "number of segments kept in the manifest", OFFSET(window_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
+    { "extra_window_size", "number of segments kept outside of the manifest before removing from disk", OFFSET(extra_window_size), AV_OPT_TYPE_INT, { .i64 = 5 }, 0, INT_MAX, E },
+    { "min_seg_duration", "minimum segment duration (in microseconds)", OFFSET(min_seg_duration), AV_OPT_TYPE_INT64, { .i64 = 5000000 }, 0, INT_MAX, E },
+    { "remove_at_exit", "remove all segments when finished", OFFSET(remove_at_exit), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { "use_template", "use SegmentTemplate instead of SegmentList", OFFSET(use_template), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
+    { "use_timeline", "use SegmentTimeline in SegmentTemplate", OFFSET(use_timeline), AV_OPT_TYPE_INT, { .i64 = 1 }, 0, 1, E },
+    { NULL },
+};
+
+static const AVClass dash_class = {
+    .class_name = "dash muxer",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVOutputFormat ff_dash_muxer = {
+    .name           = "dash",
+    .long_name      = NULL_IF_CONFIG_SMALL("DASH Muxer"),
+    .extensions     = "mpd",
+    .priv_data_size = sizeof(DASHContext),
+    .audio_codec    = AV_CODEC_ID_AAC,
+    .video_codec    = AV_CODEC_ID_H264,
+    .flags          = AVFMT_GLOBALHEADER | AVFMT_NOFILE | AVFMT_TS_NONSTRICT,
+    .write_header   = dash_write_header,
+    .write_packet   = dash_write_packet,
+    .write_trailer  = dash_write_trailer,
+    .codec_tag      = (const AVCodecTag* const []){ ff_mp4_obj_type, 0 },
+    .priv_class     = &dash_class,
+};
@@ -0,0 +1,515 @@
+/*
+ * FIFO pseudo-muxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Background writer for output files.
+ *
+ * The packets given to this muxer are queued and written to the actual
+ * output by a separate thread, so that a slow or stalling output does not
+ * block the caller. The output can optionally be reopened when it fails.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "internal.h"
+#include "url.h"
+
+typedef struct FifoContext {
+    const AVClass *class;
+    AVFormatContext *avf;
+    AVOutputFormat *oformat;
+
+    char *format;
+    char *format_options_str;
+    AVDictionary *format_options;
+    int queue_size;
+    int drop_pkts_on_overflow;
+    int attempt_recovery;
+    int max_recovery_attempts;
+    int64_t recovery_wait_time;
+    int recover_any_error;
+    int restart_with_keyframe;
+
+    /* ring of queued packets, a packet with a negative stream index
+     * is a flush request */
+    AVPacket *queue;
+    int queue_rindex;
+    int queue_nb;
+
+    int thread_started;   /* cleared once the trailer is written */
+    int finished;
+    int abort_request;
+    int error;
+    int overflow;
+    int64_t nb_dropped;
+
+    int recovery_nr;
+    uint8_t *waiting_keyframe;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_wakeup_main;
+    pthread_cond_t cond_wakeup_background;
+} FifoContext;
+
+static int fifo_check_interrupt(void *arg)
+{
+    AVFormatContext *avf = arg;
+    FifoContext     *c   = avf->priv_data;
+
+    if (c->abort_request)
+        return 1;
+    return ff_check_interrupt(&avf->interrupt_callback);
+}
+
+static int fifo_open_output(AVFormatContext *avf)
+{
+    FifoContext *c = avf->priv_data;
+    AVFormatContext *avf2 = NULL;
+    AVDictionary *options = NULL;
+    AVDictionaryEntry *entry = NULL;
+    AVStream *st, *st2;
+    int i, ret;
+
+    ret = avformat_alloc_output_context2(&avf2, c->oformat, NULL, avf->filename);
+    if (ret < 0)
+        return ret;
+    avf2->interrupt_callback.callback = fifo_check_interrupt;
+    avf2->interrupt_callback.opaque   = avf;
+    av_dict_copy(&avf2->metadata, avf->metadata, 0);
+
+    for (i = 0; i < avf->nb_streams; i++) {
+        st = avf->streams[i];
+        if (!(st2 = avformat_new_stream(avf2, NULL))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        st2->id                  = st->id;
+        st2->r_frame_rate        = st->r_frame_rate;
+        st2->time_base           = st->time_base;
+        st2->start_time          = st->start_time;
+        st2->duration            = st->duration;
+        st2->nb_frames           = st->nb_frames;
+        st2->disposition         = st->disposition;
+        st2->sample_aspect_ratio = st->sample_aspect_ratio;
+        st2->avg_frame_rate      = st->avg_frame_rate;
+        av_dict_copy(&st2->metadata, st->metadata, 0);
+        if ((ret = avcodec_copy_context(st2->codec, st->codec)) < 0)
+            goto fail;
+    }
+
+    if (!(avf2->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open2(&avf2->pb, avf->filename, AVIO_FLAG_WRITE,
+                         &avf2->interrupt_callback, NULL);
+        if (ret < 0) {
+            av_log(avf, AV_LOG_ERROR, "Error opening '%s': %s\n",
+                   avf->filename, av_err2str(ret));
+            goto fail;
+        }
+    }
+
+    av_dict_copy(&options, c->format_options, 0);
+    if ((ret = avformat_write_header(avf2, &options)) < 0) {
+        av_log(avf, AV_LOG_ERROR, "Error writing header of '%s': %s\n",
+               avf->filename, av_err2str(ret));
+        goto fail;
+    }
+    while ((entry = av_dict_get(options, "", entry, AV_DICT_IGNORE_SUFFIX)))
+        av_log(avf, AV_LOG_WARNING, "Unused option '%s'\n", entry->key);
+    av_dict_free(&options);
+
+    c->avf = avf2;
+    return 0;
+
+fail:
+    av_dict_free(&options);
+    if (!(avf2->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&avf2->pb);
+    avformat_free_context(avf2);
+    return ret;
+}
+
+static int fifo_close_output(AVFormatContext *avf, int write_trailer)
+{
+    FifoContext *c = avf->priv_data;
+    AVFormatContext *avf2 = c->avf;
+    int ret = 0, ret2;
+
+    if (!avf2)
+        return 0;
+    if (write_trailer)
+        ret = av_write_trailer(avf2);
+    if (!(avf2->oformat->flags & AVFMT_NOFILE)) {
+        if ((ret2 = avio_closep(&avf2->pb)) < 0 && write_trailer && !ret)
+            ret = ret2;
+    }
+    avformat_free_context(avf2);
+    c->avf = NULL;
+    return ret;
+}
+
+static int fifo_is_recoverable(FifoContext *c, int err)
+{
+    if (err == AVERROR_EXIT)
+        return 0;
+    if (c->recover_any_error)
+        return 1;
+    switch (err) {
+    case AVERROR(EINVAL):
+    case AVERROR(ENOSYS):
+    case AVERROR_EOF:
+    case AVERROR_PATCHWELCOME:
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Reopen the output after a failure, honouring the recovery options.
+ * @return 0 once the output is open again, the error to report otherwise
+ */
+static int fifo_recover(AVFormatContext *avf, int err)
+{
+    FifoContext *c = avf->priv_data;
+    int ret = err;
+
+    fifo_close_output(avf, 0);
+    if (!c->attempt_recovery || !fifo_is_recoverable(c, err))
+        return err;
+
+    while (!c->max_recovery_attempts ||
+           c->recovery_nr < c->max_recovery_attempts) {
+        int64_t deadline = av_gettime() + c->recovery_wait_time;
+        int stop;
+
+        pthread_mutex_lock(&c->mutex);
+        while (!c->abort_request && !c->finished && av_gettime() < deadline) {
+            struct timespec tv = { .tv_sec  =  deadline / 1000000,
+                                   .tv_nsec = (deadline % 1000000) * 1000 };
+            pthread_cond_timedwait(&c->cond_wakeup_background, &c->mutex, &tv);
+        }
+        /* do not keep a finishing output waiting for a reconnection */
+        stop = c->abort_request || c->finished;
+        pthread_mutex_unlock(&c->mutex);
+        if (stop)
+            break;
+
+        c->recovery_nr++;
+        av_log(avf, AV_LOG_INFO, "Recovery attempt #%d\n", c->recovery_nr);
+        ret = fifo_open_output(avf);
+        if (ret >= 0) {
+            av_log(avf, AV_LOG_INFO, "Output recovered\n");
+            if (c->restart_with_keyframe)
+                memset(c->waiting_keyframe, 1, avf->nb_streams);
+            c->recovery_nr = 0;
+            return 0;
+        }
+        if (!fifo_is_recoverable(c, ret))
+            break;
+    }
+
+    av_log(avf, AV_LOG_ERROR, "Giving up on recovery of '%s'\n", avf->filename);
+    return ret;
+}
+
+static int fifo_write_queued(AVFormatContext *avf, AVPacket *pkt)
+{
+    FifoContext *c = avf->priv_data;
+    int s = pkt->stream_index;
+
+    if (s < 0)
+        return c->avf->oformat->flags & AVFMT_ALLOW_FLUSH ?
+               av_write_frame(c->avf, NULL) : 0;
+
+    if (c->waiting_keyframe[s]) {
+        if (!(pkt->flags & AV_PKT_FLAG_KEY))
+            return 0;
+        c->waiting_keyframe[s] = 0;
+    }
+    return ff_write_chained(c->avf, s, pkt, avf);
+}
+
+static void *fifo_writer_task(void *arg)
+{
+    AVFormatContext *avf = arg;
+    FifoContext     *c   = avf->priv_data;
+    AVPacket pkt;
+    int ret, write_trailer;
+
+    ret = fifo_open_output(avf);
+    if (ret < 0)
+        ret = fifo_recover(avf, ret);
+
+    pthread_mutex_lock(&c->mutex);
+    while (ret >= 0 && !c->abort_request) {
+        if (!c->queue_nb) {
+            if (c->finished)
+                break;
+            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+            continue;
+        }
+
+        pkt = c->queue[c->queue_rindex];
+        c->queue_rindex = (c->queue_rindex + 1) % c->queue_size;
+        c->queue_nb--;
+        pthread_cond_signal(&c->cond_wakeup_main);
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = fifo_write_queued(avf, &pkt);
+        av_free_packet(&pkt);
+        if (ret < 0) {
+            av_log(avf, AV_LOG_ERROR, "Error writing packet to '%s': %s\n",
+                   avf->filename, av_err2str(ret));
+            ret = fifo_recover(avf, ret);
+        }
+
+        pthread_mutex_lock(&c->mutex);
+    }
+    if (ret < 0)
+        c->error = ret;
+    /* the queued packets are lost when aborting, so the trailer is not
+     * written either */
+    write_trailer = ret >= 0 && !c->abort_request;
+    pthread_cond_signal(&c->cond_wakeup_main);
+    pthread_mutex_unlock(&c->mutex);
+
+    ret = fifo_close_output(avf, write_trailer);
+    if (ret < 0) {
+        pthread_mutex_lock(&c->mutex);
+        c->error = ret;
+        pthread_mutex_unlock(&c->mutex);
+    }
+
+    return NULL;
+}
+
+static void fifo_free_queue(FifoContext *c)
+{
+    while (c->queue_nb) {
+        av_free_packet(&c->queue[c->queue_rindex]);
+        c->queue_rindex = (c->queue_rindex + 1) % c->queue_size;
+        c->queue_nb--;
+    }
+    av_freep(&c->queue);
+    av_freep(&c->waiting_keyframe);
+    av_dict_free(&c->format_options);
+}
+
+static int fifo_write_header(AVFormatContext *avf)
+{
+    FifoContext *c = avf->priv_data;
+    int ret;
+
+    if (c->format) {
+        c->oformat = av_guess_format(c->format, NULL, NULL);
+        if (!c->oformat) {
+            av_log(avf, AV_LOG_ERROR, "Unknown format '%s'\n", c->format);
+            return AVERROR_MUXER_NOT_FOUND;
+        }
+    } else {
+        c->oformat = av_guess_format(NULL, avf->filename, NULL);
+        if (!c->oformat) {
+            av_log(avf, AV_LOG_ERROR, "Unable to find a suitable output format "
+                   "for '%s', use the fifo_format option\n", avf->filename);
+            return AVERROR_MUXER_NOT_FOUND;
+        }
+    }
+
+    if (c->format_options_str) {
+        ret = av_dict_parse_string(&c->format_options, c->format_options_str,
+                                   "=", ":", 0);
+        if (ret < 0) {
+            av_log(avf, AV_LOG_ERROR, "Could not parse format options '%s'\n",
+                   c->format_options_str);
+            goto fail;
+        }
+    }
+
+    c->queue            = av_calloc(c->queue_size, sizeof(*c->queue));
+    c->waiting_keyframe = av_mallocz(FFMAX(avf->nb_streams, 1));
+    if (!c->queue || !c->waiting_keyframe) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_main, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto mutex_fail;
+    }
+    ret = pthread_cond_init(&c->cond_wakeup_background, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto cond_main_fail;
+    }
+    ret = pthread_create(&c->thread, NULL, fifo_writer_task, avf);
+    if (ret) {
+        av_log(avf, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto cond_background_fail;
+    }
+    c->thread_started = 1;
+
+    return 0;
+
+cond_background_fail:
+    pthread_cond_destroy(&c->cond_wakeup_background);
+cond_main_fail:
+    pthread_cond_destroy(&c->cond_wakeup_main);
+mutex_fail:
+    pthread_mutex_destroy(&c->mutex);
+fail:
+    fifo_free_queue(c);
+    return ret;
+}
+
+static int fifo_write_packet(AVFormatContext *avf, AVPacket *pkt)
+{
+    FifoContext *c = avf->priv_data;
+    AVPacket *slot;
+    int ret = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->error && c->queue_nb == c->queue_size) {
+        if (c->drop_pkts_on_overflow) {
+            if (!c->overflow)
+                av_log(avf, AV_LOG_WARNING, "Queue full, dropping packets\n");
+            c->overflow = 1;
+            c->nb_dropped++;
+            goto end;
+        }
+        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+    }
+    if (c->error) {
+        ret = c->error;
+        goto end;
+    }
+
+    slot = &c->queue[(c->queue_rindex + c->queue_nb) % c->queue_size];
+    if (pkt) {
+        ret = av_packet_ref(slot, pkt);
+        if (ret < 0)
+            goto end;
+    } else {
+        av_init_packet(slot);
+        slot->data         = NULL;
+        slot->size         = 0;
+        slot->stream_index = -1;
+    }
+    c->queue_nb++;
+    c->overflow = 0;
+    pthread_cond_signal(&c->cond_wakeup_background);
+
+end:
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int fifo_write_trailer(AVFormatContext *avf)
+{
+    FifoContext *c = avf->priv_data;
+    int ret;
+
+    pthread_mutex_lock(&c->mutex);
+    c->finished = 1;
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_join(c->thread, NULL);
+    c->thread_started = 0;
+
+    ret = c->error;
+    if (c->nb_dropped)
+        av_log(avf, AV_LOG_WARNING, "%"PRId64" packets dropped on queue "
+               "overflow\n", c->nb_dropped);
+
+    pthread_cond_destroy(&c->cond_wakeup_background);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+    fifo_free_queue(c);
+
+    return ret;
+}
+
+/* stop the writer thread if the trailer was not written, e.g. on errors */
+static void fifo_deinit(AVFormatContext *avf)
+{
+    FifoContext *c = avf->priv_data;
+
+    if (!c->thread_started)
+        return;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_signal(&c->cond_wakeup_background);
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_join(c->thread, NULL);
+    c->thread_started = 0;
+
+    pthread_cond_destroy(&c->cond_wakeup_background);
+    pthread_cond_destroy(&c->cond_wakeup_main);
+    pthread_mutex_destroy(&c->mutex);
+    fifo_free_queue(c);
+}
+
+#define OFFSET(x) offsetof(FifoContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "fifo_format", "set the format of the actual output", OFFSET(format), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    { "format_opts", "set options of the actual output as a :-separated list of key=value pairs", OFFSET(format_options_str), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
+    { "queue_size", "set the maximum number of queued packets", OFFSET(queue_size), AV_OPT_TYPE_INT, { .i64 = 60 }, 1, INT_MAX, E },
+    { "drop_pkts_on_overflow", "drop packets instead of blocking when the queue is full", OFFSET(drop_pkts_on_overflow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { "attempt_recovery", "reopen the output when writing to it fails", OFFSET(attempt_recovery), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { "max_recovery_attempts", "set the maximum number of consecutive recovery attempts, 0 for no limit", OFFSET(max_recovery_attempts), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, E },
+    { "recovery_wait_time", "set the time to wait before a recovery attempt", OFFSET(recovery_wait_time), AV_OPT_TYPE_DURATION, { .i64 = 5000000 }, 0, INT64_MAX, E },
+    { "recover_any_error", "attempt recovery regardless of the type of the error", OFFSET(recover_any_error), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { "restart_with_keyframe", "drop packets after a recovery until the next keyframe", OFFSET(restart_with_keyframe), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, E },
+    { NULL },
+};
+
+static const AVClass fifo_muxer_class = {
+    .class_name = "fifo muxer",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVOutputFormat ff_fifo_muxer = {
+    .name           = "fifo",
+    .long_name      = NULL_IF_CONFIG_SMALL("FIFO queue pseudo-muxer"),
+    .priv_data_size = sizeof(FifoContext),
+    .write_header   = fifo_write_header,
+    .write_packet   = fifo_write_packet,
+    .write_trailer  = fifo_write_trailer,
+    .deinit         = fifo_deinit,
+    .priv_class     = &fifo_muxer_class,
+    .flags          = AVFMT_NOFILE | AVFMT_ALLOW_FLUSH | AVFMT_TS_NEGATIVE,
+};
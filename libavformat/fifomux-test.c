@@ -0,0 +1,83 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Write packets through the fifo muxer and free it with and without
+ * writing the trailer, which must stop its writer thread in both cases.
+ */
+
+#include <stdio.h>
+
+#include "avformat.h"
+
+#define NB_PACKETS 16
+
+static int test(const char *name, int write_trailer)
+{
+    AVFormatContext *oc = NULL;
+    AVDictionary *opts = NULL;
+    uint8_t data[64] = { 0 };
+    AVStream *st;
+    AVPacket pkt;
+    int i, ret;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, "fifo", "-");
+    if (ret < 0)
+        goto end;
+    if (!(st = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codec->codec_type  = AVMEDIA_TYPE_AUDIO;
+    st->codec->codec_id    = AV_CODEC_ID_PCM_S16LE;
+    st->codec->sample_rate = 44100;
+    st->codec->channels    = 1;
+    st->time_base          = (AVRational){ 1, 44100 };
+
+    av_dict_set(&opts, "fifo_format", "null", 0);
+    ret = avformat_write_header(oc, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+
+    for (i = 0; i < NB_PACKETS && ret >= 0; i++) {
+        av_init_packet(&pkt);
+        pkt.data = data;
+        pkt.size = sizeof(data);
+        pkt.pts  = pkt.dts = i * sizeof(data) / 2;
+        ret = av_write_frame(oc, &pkt);
+    }
+    if (ret >= 0 && write_trailer)
+        ret = av_write_trailer(oc);
+
+end:
+    avformat_free_context(oc);
+    if (ret < 0)
+        printf("%s: failed (%s)\n", name, av_err2str(ret));
+    else
+        printf("%s: ok\n", name);
+    return ret;
+}
+
+int main(void)
+{
+    av_register_all();
+
+    return test("with trailer", 1) < 0 ||
+           test("without trailer", 0) < 0;
+}
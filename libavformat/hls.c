@@ -28,6 +28,7 @@
 
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
+#include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
@@ -39,7 +40,12 @@
 #include "url.h"
 #include "id3v2.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_CHUNK_SIZE 32768
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -74,6 +80,22 @@ struct segment {
     uint8_t iv[16];
 };
 
+/*
+ * A segment downloaded ahead of time by a prefetch thread. The data is
+ * appended to fifo while the segment is being downloaded, so it can be
+ * read before the download is complete.
+ */
+struct prefetch_segment {
+    struct playlist *pls;
+    int seq_no;
+    int64_t size;   /* size of the segment, -1 if unknown */
+    int filling;    /* a prefetch thread is downloading the segment */
+    int eof;        /* the download is complete */
+    int dropped;    /* no longer wanted, freed by the prefetch thread */
+    AVFifoBuffer *fifo;
+    struct prefetch_segment *next;
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -92,6 +114,7 @@ struct playlist {
     AVIOContext pb;
     uint8_t* read_buffer;
     URLContext *input;
+    struct prefetch_segment *cur_prefetch; /* used instead of input */
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -107,6 +130,7 @@ struct playlist {
     int needed, cur_needed;
     int cur_seq_no;
     int64_t cur_seg_offset;
+    int64_t cur_seg_size;
     int64_t last_load_time;
 
     char key_url[MAX_URL_SIZE];
@@ -134,6 +158,28 @@ struct playlist {
      * multiple (playlist-less) renditions associated with them. */
     int n_renditions;
     struct rendition **renditions;
+
+#if HAVE_PTHREADS
+    /* Segment prefetching, see prefetch_task(). While the prefetch threads
+     * are running, the segment list and the other fields written by
+     * parse_playlist() are protected by prefetch_mutex. */
+    int prefetch_started;
+    int prefetch_active;  /* fetching segments from prefetch_seq_no on */
+    int prefetch_abort;
+    int prefetch_seq_no;  /* next segment to fetch */
+    int prefetch_eof;     /* all segments of a finished playlist fetched */
+    int prefetch_error;
+    int prefetch_reloading; /* a thread is reloading the playlist */
+    int prefetch_reloaded;  /* reloaded without finding a new segment */
+    int nb_prefetched;    /* number of segments in prefetch_queue */
+    int64_t prefetch_bytes;
+    struct prefetch_segment *prefetch_queue;
+    pthread_t *prefetch_threads;
+    int nb_prefetch_threads;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond_main;
+    pthread_cond_t prefetch_cond_background;
+#endif
 };
 
 /*
@@ -164,6 +210,7 @@ struct variant {
 };
 
 typedef struct HLSContext {
+    const AVClass *class;
     int n_variants;
     struct variant **variants;
     int n_playlists;
@@ -179,8 +226,29 @@ typedef struct HLSContext {
     char *user_agent;                    ///< holds HTTP user agent set as an AVOption to the HTTP protocol context
     char *cookies;                       ///< holds HTTP cookie values set in either the initial response or as an AVOption to the HTTP protocol context
     char *headers;                       ///< holds HTTP headers set as an AVOption to the HTTP protocol context
+    int prefetch_segments;
+    int prefetch_size;
+    int http_persistent;
+#if HAVE_PTHREADS
+    pthread_mutex_t http_options_mutex; ///< protects user_agent, cookies and headers against the prefetch threads
+#endif
 } HLSContext;
 
+/* broker prior HTTP options that should be consistent across requests */
+static void set_http_options(HLSContext *c, AVDictionary **opts)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&c->http_options_mutex);
+#endif
+    av_dict_set(opts, "user-agent", c->user_agent, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&c->http_options_mutex);
+#endif
+    av_dict_set(opts, "multiple_requests", c->http_persistent ? "1" : "0", 0);
+}
+
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
 {
     int len = ff_get_line(s, buf, maxlen);
@@ -201,11 +269,113 @@ static void free_segment_list(struct playlist *pls)
     pls->n_segments = 0;
 }
 
+#if HAVE_PTHREADS
+static void free_prefetch_segment(struct prefetch_segment *ps)
+{
+    av_fifo_free(ps->fifo);
+    av_free(ps);
+}
+
+/* must be called with prefetch_mutex locked */
+static void release_prefetch_segment(struct playlist *pls,
+                                     struct prefetch_segment *ps)
+{
+    pls->prefetch_bytes -= av_fifo_size(ps->fifo);
+    if (ps->filling)
+        ps->dropped = 1;
+    else
+        free_prefetch_segment(ps);
+}
+
+/* must be called with prefetch_mutex locked */
+static void drop_prefetched_segments(struct playlist *pls)
+{
+    struct prefetch_segment *ps, *next;
+
+    for (ps = pls->prefetch_queue; ps; ps = next) {
+        next = ps->next;
+        release_prefetch_segment(pls, ps);
+    }
+    pls->prefetch_queue = NULL;
+    pls->nb_prefetched  = 0;
+}
+#endif
+
+/* close the current segment */
+static void close_input(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    if (pls->cur_prefetch) {
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        release_prefetch_segment(pls, pls->cur_prefetch);
+        pls->cur_prefetch = NULL;
+        pthread_cond_broadcast(&pls->prefetch_cond_background);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+    }
+#endif
+    if (pls->input) {
+        ffurl_close(pls->input);
+        pls->input = NULL;
+    }
+}
+
+/* close the current segment and drop all prefetched data, for when the
+ * playlist is no longer read sequentially from the current position */
+static void stop_prefetch(struct playlist *pls)
+{
+    close_input(pls);
+#if HAVE_PTHREADS
+    if (pls->prefetch_started) {
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        drop_prefetched_segments(pls);
+        pls->prefetch_active = 0;
+        pthread_cond_broadcast(&pls->prefetch_cond_background);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+    }
+#endif
+}
+
+static void playlist_lock(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    if (pls->prefetch_started)
+        pthread_mutex_lock(&pls->prefetch_mutex);
+#endif
+}
+
+static void playlist_unlock(struct playlist *pls)
+{
+#if HAVE_PTHREADS
+    if (pls->prefetch_started)
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+#endif
+}
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        close_input(pls);
+#if HAVE_PTHREADS
+        if (pls->prefetch_started) {
+            int j;
+
+            pthread_mutex_lock(&pls->prefetch_mutex);
+            pls->prefetch_abort = 1;
+            drop_prefetched_segments(pls);
+            pthread_cond_broadcast(&pls->prefetch_cond_background);
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+
+            for (j = 0; j < pls->nb_prefetch_threads; j++)
+                pthread_join(pls->prefetch_threads[j], NULL);
+            av_freep(&pls->prefetch_threads);
+
+            pthread_cond_destroy(&pls->prefetch_cond_background);
+            pthread_cond_destroy(&pls->prefetch_cond_main);
+            pthread_mutex_destroy(&pls->prefetch_mutex);
+        }
+#endif
         free_segment_list(pls);
         av_freep(&pls->renditions);
         av_freep(&pls->id3_buf);
@@ -213,8 +383,6 @@ static void free_playlist_list(HLSContext *c)
         ff_id3v2_free_extra_meta(&pls->id3_deferred_extra);
         av_free_packet(&pls->pkt);
         av_free(pls->pb.buffer);
-        if (pls->input)
-            ffurl_close(pls->input);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -515,10 +683,7 @@ static int parse_playlist(HLSContext *c, const char *url,
         /* Some HLS servers don't like being sent the range header */
         av_dict_set(&opts, "seekable", "0", 0);
 
-        // broker prior HTTP options that should be consistent across requests
-        av_dict_set(&opts, "user-agent", c->user_agent, 0);
-        av_dict_set(&opts, "cookies", c->cookies, 0);
-        av_dict_set(&opts, "headers", c->headers, 0);
+        set_http_options(c, &opts);
 
         ret = avio_open2(&in, url, AVIO_FLAG_READ,
                          c->interrupt_callback, &opts);
@@ -680,16 +845,51 @@ enum ReadFromURLMode {
     READ_COMPLETE,
 };
 
+#if HAVE_PTHREADS
+/* read from the current prefetched segment */
+static int read_from_prefetch(struct playlist *pls, uint8_t *buf, int buf_size,
+                              enum ReadFromURLMode mode)
+{
+    struct prefetch_segment *ps = pls->cur_prefetch;
+    int ret = 0;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (ret < buf_size) {
+        int len = FFMIN(av_fifo_size(ps->fifo), buf_size - ret);
+        if (len > 0) {
+            av_fifo_generic_read(ps->fifo, buf + ret, len, NULL);
+            pls->prefetch_bytes -= len;
+            ret += len;
+            pthread_cond_broadcast(&pls->prefetch_cond_background);
+            if (mode == READ_NORMAL)
+                break;
+        } else if (ps->eof) {
+            break;
+        } else {
+            pthread_cond_wait(&pls->prefetch_cond_main, &pls->prefetch_mutex);
+        }
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    pls->cur_seg_offset += ret;
+    return ret;
+}
+#endif
+
 /* read from URLContext, limiting read to current segment */
 static int read_from_url(struct playlist *pls, uint8_t *buf, int buf_size,
                          enum ReadFromURLMode mode)
 {
     int ret;
-    struct segment *seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
+
+#if HAVE_PTHREADS
+    if (pls->cur_prefetch)
+        return read_from_prefetch(pls, buf, buf_size, mode);
+#endif
 
      /* limit read if the segment was only a part of a file */
-    if (seg->size >= 0)
-        buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
+    if (pls->cur_seg_size >= 0)
+        buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
     if (mode == READ_COMPLETE)
         ret = ffurl_read_complete(pls->input, buf, buf_size);
@@ -834,8 +1034,7 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
             break;
 
         if (ff_id3v2_match(buf, ID3v2_DEFAULT_MAGIC)) {
-            struct segment *seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
-            int64_t maxsize = seg->size >= 0 ? seg->size : 1024*1024;
+            int64_t maxsize = pls->cur_seg_size >= 0 ? pls->cur_seg_size : 1024*1024;
             int taglen = ff_id3v2_tag_len(buf);
             int tag_got_bytes = FFMIN(taglen, *len);
             int remaining = taglen - tag_got_bytes;
@@ -900,17 +1099,17 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls)
+/* key_url and key cache the last key fetched by the caller, the prefetch
+ * threads use their own instead of the ones of the playlist */
+static int open_url(HLSContext *c, struct playlist *pls, struct segment *seg,
+                    char *key_url, uint8_t *key_buf,
+                    URLContext **in, AVIOInterruptCB *interrupt_callback)
 {
     AVDictionary *opts = NULL;
     AVDictionary *opts2 = NULL;
     int ret;
-    struct segment *seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
 
-    // broker prior HTTP options that should be consistent across requests
-    av_dict_set(&opts, "user-agent", c->user_agent, 0);
-    av_dict_set(&opts, "cookies", c->cookies, 0);
-    av_dict_set(&opts, "headers", c->headers, 0);
+    set_http_options(c, &opts);
     av_dict_set(&opts, "seekable", "0", 0);
 
     // Same opts for key request (ffurl_open mutilates the opts so it cannot be used twice)
@@ -933,16 +1132,16 @@ static int open_input(HLSContext *c, struct playlist *pls)
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = ffurl_open(&pls->input, seg->url, AVIO_FLAG_READ,
-                          &pls->parent->interrupt_callback, &opts);
+        ret = ffurl_open(in, seg->url, AVIO_FLAG_READ,
+                          interrupt_callback, &opts);
 
     } else if (seg->key_type == KEY_AES_128) {
         char iv[33], key[33], url[MAX_URL_SIZE];
-        if (strcmp(seg->key, pls->key_url)) {
+        if (strcmp(seg->key, key_url)) {
             URLContext *uc;
             if (ffurl_open(&uc, seg->key, AVIO_FLAG_READ,
-                           &pls->parent->interrupt_callback, &opts2) == 0) {
-                if (ffurl_read_complete(uc, pls->key, sizeof(pls->key))
+                           interrupt_callback, &opts2) == 0) {
+                if (ffurl_read_complete(uc, key_buf, sizeof(pls->key))
                     != sizeof(pls->key)) {
                     av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
@@ -952,24 +1151,24 @@ static int open_input(HLSContext *c, struct playlist *pls)
                 av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
             }
-            av_strlcpy(pls->key_url, seg->key, sizeof(pls->key_url));
+            av_strlcpy(key_url, seg->key, MAX_URL_SIZE);
         }
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, pls->key, sizeof(pls->key), 0);
+        ff_data_to_hex(key, key_buf, sizeof(pls->key), 0);
         iv[32] = key[32] = '\0';
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
         else
             snprintf(url, sizeof(url), "crypto:%s", seg->url);
-        if ((ret = ffurl_alloc(&pls->input, url, AVIO_FLAG_READ,
-                               &pls->parent->interrupt_callback)) < 0)
+        if ((ret = ffurl_alloc(in, url, AVIO_FLAG_READ,
+                               interrupt_callback)) < 0)
             goto cleanup;
-        av_opt_set(pls->input->priv_data, "key", key, 0);
-        av_opt_set(pls->input->priv_data, "iv", iv, 0);
+        av_opt_set((*in)->priv_data, "key", key, 0);
+        av_opt_set((*in)->priv_data, "iv", iv, 0);
 
-        if ((ret = ffurl_connect(pls->input, &opts)) < 0) {
-            ffurl_close(pls->input);
-            pls->input = NULL;
+        if ((ret = ffurl_connect(*in, &opts)) < 0) {
+            ffurl_close(*in);
+            *in = NULL;
             goto cleanup;
         }
         ret = 0;
@@ -981,22 +1180,31 @@ static int open_input(HLSContext *c, struct playlist *pls)
      * should already be where want it to, but this allows e.g. local testing
      * without a HTTP server. */
     if (ret == 0 && seg->key_type == KEY_NONE) {
-        int seekret = ffurl_seek(pls->input, seg->url_offset, SEEK_SET);
+        int seekret = ffurl_seek(*in, seg->url_offset, SEEK_SET);
         if (seekret < 0) {
             av_log(pls->parent, AV_LOG_ERROR, "Unable to seek to offset %"PRId64" of HLS segment '%s'\n", seg->url_offset, seg->url);
             ret = seekret;
-            ffurl_close(pls->input);
-            pls->input = NULL;
+            ffurl_close(*in);
+            *in = NULL;
         }
     }
 
 cleanup:
     av_dict_free(&opts);
     av_dict_free(&opts2);
-    pls->cur_seg_offset = 0;
     return ret;
 }
 
+static int open_input(HLSContext *c, struct playlist *pls)
+{
+    struct segment *seg = pls->segments[pls->cur_seq_no - pls->start_seq_no];
+
+    pls->cur_seg_offset = 0;
+    pls->cur_seg_size   = seg->size;
+    return open_url(c, pls, seg, pls->key_url, pls->key, &pls->input,
+                    &pls->parent->interrupt_callback);
+}
+
 static int64_t default_reload_interval(struct playlist *pls)
 {
     return pls->n_segments > 0 ?
@@ -1004,6 +1212,330 @@ static int64_t default_reload_interval(struct playlist *pls)
                           pls->target_duration;
 }
 
+#if HAVE_PTHREADS
+static int prefetch_check_interrupt(void *arg)
+{
+    struct prefetch_segment *ps = arg;
+
+    if (ps->pls->prefetch_abort || ps->dropped)
+        return 1;
+    return ff_check_interrupt(&ps->pls->parent->interrupt_callback);
+}
+
+/* reload a playlist from a prefetch thread, without holding the lock
+ * while downloading it */
+static int reload_playlist(HLSContext *c, struct playlist *pls)
+{
+    struct playlist *tmp = av_mallocz(sizeof(struct playlist));
+    int ret;
+
+    if (!tmp)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    tmp->start_seq_no    = pls->start_seq_no;
+    tmp->target_duration = pls->target_duration;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    ret = parse_playlist(c, pls->url, tmp, NULL);
+    if (ret >= 0) {
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        free_segment_list(pls);
+        pls->segments        = tmp->segments;
+        pls->n_segments      = tmp->n_segments;
+        pls->start_seq_no    = tmp->start_seq_no;
+        pls->target_duration = tmp->target_duration;
+        pls->finished        = tmp->finished;
+        pls->type            = tmp->type;
+        pls->last_load_time  = tmp->last_load_time;
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+    } else {
+        free_segment_list(tmp);
+    }
+    av_free(tmp);
+    return ret;
+}
+
+/* download the segment ps into its fifo, called with prefetch_mutex locked */
+static void fetch_segment(HLSContext *c, struct playlist *pls,
+                          struct segment *seg, struct prefetch_segment *ps,
+                          uint8_t *buf, char *key_url, uint8_t *key)
+{
+    AVIOInterruptCB interrupt_callback = { prefetch_check_interrupt, ps };
+    URLContext *in = NULL;
+    int64_t offset = 0;
+    int ret;
+
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+    ret = open_url(c, pls, seg, key_url, key, &in, &interrupt_callback);
+    pthread_mutex_lock(&pls->prefetch_mutex);
+
+    /* the segment is skipped, like when its download fails midway */
+    if (ret < 0 && !ps->dropped && !pls->prefetch_abort)
+        av_log(pls->parent, AV_LOG_WARNING,
+               "Failed to open segment %d of playlist %d\n",
+               ps->seq_no, pls->index);
+
+    while (ret >= 0 && !ps->dropped && !pls->prefetch_abort) {
+        int len = PREFETCH_CHUNK_SIZE;
+
+        /* the segment which is read next is always downloaded, so that the
+         * reader never waits for a download which waits for the reader */
+        if (pls->prefetch_bytes >= c->prefetch_size &&
+            ps != pls->cur_prefetch && ps != pls->prefetch_queue) {
+            pthread_cond_wait(&pls->prefetch_cond_background, &pls->prefetch_mutex);
+            continue;
+        }
+        /* limit read if the segment was only a part of a file */
+        if (ps->size >= 0)
+            len = FFMIN(len, ps->size - offset);
+
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+        ret = len > 0 ? ffurl_read(in, buf, len) : AVERROR_EOF;
+        pthread_mutex_lock(&pls->prefetch_mutex);
+
+        if (ret <= 0 || ps->dropped)
+            break;
+        if (av_fifo_space(ps->fifo) < ret &&
+            av_fifo_grow(ps->fifo, ret) < 0)
+            break;
+        av_fifo_generic_write(ps->fifo, buf, ret, NULL);
+        pls->prefetch_bytes += ret;
+        offset += ret;
+        pthread_cond_signal(&pls->prefetch_cond_main);
+    }
+
+    if (in) {
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+        ffurl_close(in);
+        pthread_mutex_lock(&pls->prefetch_mutex);
+    }
+}
+
+/*
+ * Download the segments following the one being read in the background,
+ * up to prefetch_segments segments and prefetch_size bytes ahead, and
+ * reload live playlists when needed. There is one thread per prefetched
+ * segment, so that the request latencies of consecutive segments overlap
+ * instead of adding up.
+ */
+static void *prefetch_task(void *arg)
+{
+    struct playlist *pls = arg;
+    HLSContext *c = pls->parent->priv_data;
+    uint8_t *buf = av_malloc(PREFETCH_CHUNK_SIZE);
+    /* the key of the last encrypted segment fetched by this thread */
+    char *key_url = av_mallocz(MAX_URL_SIZE);
+    uint8_t key[16];
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    if (!buf || !key_url)
+        pls->prefetch_error = AVERROR(ENOMEM);
+    while (!pls->prefetch_abort) {
+        struct prefetch_segment *ps, **tail;
+        struct segment seg;
+        int64_t reload_interval;
+        int ret;
+
+        if (!buf || !key_url || !pls->prefetch_active || pls->prefetch_eof ||
+            pls->prefetch_error || pls->prefetch_reloading ||
+            pls->nb_prefetched >= c->prefetch_segments) {
+            pthread_cond_wait(&pls->prefetch_cond_background, &pls->prefetch_mutex);
+            continue;
+        }
+
+        /* If this is a live stream and the reload interval has elapsed since
+         * the last playlist reload, reload the playlists now. If there were
+         * no new segments after the last reload, switch to a reload
+         * interval of half the target duration. */
+        reload_interval = pls->prefetch_reloaded ? pls->target_duration / 2 :
+                                                   default_reload_interval(pls);
+        if (!pls->finished &&
+            av_gettime() - pls->last_load_time >= reload_interval) {
+            pls->prefetch_reloading = 1;
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            ret = reload_playlist(c, pls);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+            pls->prefetch_reloading = 0;
+            pthread_cond_broadcast(&pls->prefetch_cond_background);
+            if (ret < 0) {
+                av_log(pls->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
+                       pls->index);
+                pls->prefetch_error = ret;
+                pthread_cond_signal(&pls->prefetch_cond_main);
+                continue;
+            }
+            pls->prefetch_reloaded = 1;
+            continue;
+        }
+        if (pls->prefetch_seq_no < pls->start_seq_no) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "skipping %d segments ahead, expired from playlists\n",
+                   pls->start_seq_no - pls->prefetch_seq_no);
+            pls->prefetch_seq_no = pls->start_seq_no;
+        }
+        if (pls->prefetch_seq_no >= pls->start_seq_no + pls->n_segments) {
+            int64_t reload_time = pls->last_load_time + reload_interval;
+
+            if (pls->finished) {
+                pls->prefetch_eof = 1;
+                pthread_cond_signal(&pls->prefetch_cond_main);
+                continue;
+            }
+            /* wait for the next reload, the other threads wait as well */
+            pls->prefetch_reloading = 1;
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            while (av_gettime() < reload_time && !pls->prefetch_abort) {
+                if (ff_check_interrupt(&pls->parent->interrupt_callback))
+                    break;
+                av_usleep(100*1000);
+            }
+            pthread_mutex_lock(&pls->prefetch_mutex);
+            pls->prefetch_reloading = 0;
+            pthread_cond_broadcast(&pls->prefetch_cond_background);
+            if (av_gettime() < reload_time && !pls->prefetch_abort) {
+                pls->prefetch_error = AVERROR_EXIT;
+                pthread_cond_signal(&pls->prefetch_cond_main);
+            }
+            continue;
+        }
+        pls->prefetch_reloaded = 0;
+
+        /* copy the segment, the list may change while it is downloaded */
+        seg     = *pls->segments[pls->prefetch_seq_no - pls->start_seq_no];
+        seg.url = av_strdup(seg.url);
+        seg.key = seg.key ? av_strdup(seg.key) : NULL;
+        ps      = av_mallocz(sizeof(struct prefetch_segment));
+        if (!seg.url || (!seg.key && seg.key_type != KEY_NONE) || !ps ||
+            !(ps->fifo = av_fifo_alloc(PREFETCH_CHUNK_SIZE))) {
+            av_free(seg.url);
+            av_free(seg.key);
+            av_free(ps);
+            pls->prefetch_error = AVERROR(ENOMEM);
+            pthread_cond_signal(&pls->prefetch_cond_main);
+            continue;
+        }
+        ps->pls     = pls;
+        ps->seq_no  = pls->prefetch_seq_no++;
+        ps->size    = seg.size;
+        ps->filling = 1;
+        for (tail = &pls->prefetch_queue; *tail; tail = &(*tail)->next)
+            ;
+        *tail = ps;
+        pls->nb_prefetched++;
+
+        fetch_segment(c, pls, &seg, ps, buf, key_url, key);
+        av_free(seg.url);
+        av_free(seg.key);
+
+        ps->filling = 0;
+        ps->eof     = 1;
+        if (ps->dropped)
+            free_prefetch_segment(ps);
+        pthread_cond_signal(&pls->prefetch_cond_main);
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    av_free(buf);
+    av_free(key_url);
+    return NULL;
+}
+
+static int start_prefetch(HLSContext *c, struct playlist *pls)
+{
+    int i, ret;
+
+    pls->prefetch_threads = av_malloc_array(c->prefetch_segments,
+                                            sizeof(*pls->prefetch_threads));
+    if (!pls->prefetch_threads)
+        return AVERROR(ENOMEM);
+
+    ret = pthread_mutex_init(&pls->prefetch_mutex, NULL);
+    if (ret)
+        goto fail;
+    ret = pthread_cond_init(&pls->prefetch_cond_main, NULL);
+    if (ret)
+        goto mutex_fail;
+    ret = pthread_cond_init(&pls->prefetch_cond_background, NULL);
+    if (ret)
+        goto cond_main_fail;
+    pls->prefetch_started = 1;
+
+    for (i = 0; i < c->prefetch_segments; i++) {
+        ret = pthread_create(&pls->prefetch_threads[i], NULL, prefetch_task, pls);
+        if (ret) {
+            av_log(pls->parent, AV_LOG_ERROR, "pthread_create failed: %s\n", strerror(ret));
+            /* go on with the threads already started */
+            if (i)
+                break;
+            pls->prefetch_started = 0;
+            pthread_cond_destroy(&pls->prefetch_cond_background);
+            goto cond_main_fail;
+        }
+        pls->nb_prefetch_threads++;
+    }
+    return 0;
+
+cond_main_fail:
+    pthread_cond_destroy(&pls->prefetch_cond_main);
+mutex_fail:
+    pthread_mutex_destroy(&pls->prefetch_mutex);
+fail:
+    av_freep(&pls->prefetch_threads);
+    return AVERROR(ret);
+}
+
+/* take the segment pls->cur_seq_no, or the next available one, from the
+ * prefetch queue */
+static int open_prefetched(HLSContext *c, struct playlist *pls)
+{
+    struct prefetch_segment *ps;
+    int ret = 0;
+
+    if (!pls->prefetch_started && (ret = start_prefetch(c, pls)) < 0)
+        return ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    if (!pls->prefetch_active) {
+        pls->prefetch_active = 1;
+        pls->prefetch_seq_no = pls->cur_seq_no;
+        pls->prefetch_eof    = 0;
+        pls->prefetch_error  = 0;
+        pthread_cond_broadcast(&pls->prefetch_cond_background);
+    }
+
+    while (!(ps = pls->prefetch_queue)) {
+        if (pls->prefetch_error) {
+            /* report the error once, the next call retries */
+            ret = pls->prefetch_error;
+            pls->prefetch_error = 0;
+            pthread_cond_broadcast(&pls->prefetch_cond_background);
+            break;
+        }
+        if (pls->prefetch_eof) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        pthread_cond_wait(&pls->prefetch_cond_main, &pls->prefetch_mutex);
+    }
+
+    if (ps) {
+        pls->prefetch_queue = ps->next;
+        pls->nb_prefetched--;
+        pthread_cond_broadcast(&pls->prefetch_cond_background);
+
+        /* segments may have been skipped if they expired from the playlist */
+        pls->cur_seq_no     = ps->seq_no;
+        pls->cur_prefetch   = ps;
+        pls->cur_seg_offset = 0;
+        pls->cur_seg_size   = ps->size;
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+#endif
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1015,7 +1547,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input) {
+    if (!v->input && !v->cur_prefetch) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1032,9 +1564,21 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            stop_prefetch(v);
             return AVERROR_EOF;
         }
 
+#if HAVE_PTHREADS
+        if (c->prefetch_segments) {
+            ret = open_prefetched(c, v);
+            c->cur_seq_no = v->cur_seq_no;
+            if (ret < 0)
+                return ret;
+            just_opened = 1;
+            goto read;
+        }
+#endif
+
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
@@ -1079,6 +1623,9 @@ reload:
         just_opened = 1;
     }
 
+#if HAVE_PTHREADS
+read:
+#endif
     ret = read_from_url(v, buf, buf_size, READ_NORMAL);
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
@@ -1089,8 +1636,7 @@ reload:
 
         return ret;
     }
-    ffurl_close(v->input);
-    v->input = NULL;
+    close_input(v);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1244,12 +1790,20 @@ static int hls_read_header(AVFormatContext *s)
 
     c->interrupt_callback = &s->interrupt_callback;
 
+#if HAVE_PTHREADS
+    if ((ret = pthread_mutex_init(&c->http_options_mutex, NULL)))
+        return AVERROR(ret);
+#endif
+
     c->first_packet = 1;
     c->first_timestamp = AV_NOPTS_VALUE;
     c->cur_timestamp = AV_NOPTS_VALUE;
 
     // if the URL context is good, read important options we must broker later
     if (u && u->prot->priv_data_class) {
+#if HAVE_PTHREADS
+        pthread_mutex_lock(&c->http_options_mutex);
+#endif
         // get the previous user agent & set back to null if string size is zero
         av_freep(&c->user_agent);
         av_opt_get(u->priv_data, "user-agent", 0, (uint8_t**)&(c->user_agent));
@@ -1267,6 +1821,9 @@ static int hls_read_header(AVFormatContext *s)
         av_opt_get(u->priv_data, "headers", 0, (uint8_t**)&(c->headers));
         if (c->headers && !strlen(c->headers))
             av_freep(&c->headers);
+#if HAVE_PTHREADS
+        pthread_mutex_unlock(&c->http_options_mutex);
+#endif
     }
 
     if ((ret = parse_playlist(c, s->filename, NULL, s->pb)) < 0)
@@ -1429,6 +1986,9 @@ fail:
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&c->http_options_mutex);
+#endif
     return ret;
 }
 
@@ -1452,7 +2012,10 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         if (pls->cur_needed && !pls->needed) {
             pls->needed = 1;
             changed = 1;
+            stop_prefetch(pls);
+            playlist_lock(pls);
             pls->cur_seq_no = select_cur_seq_no(c, pls);
+            playlist_unlock(pls);
             pls->pb.eof_reached = 0;
             if (c->cur_timestamp != AV_NOPTS_VALUE) {
                 /* catch up */
@@ -1462,9 +2025,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
         } else if (first && !pls->cur_needed && pls->needed) {
-            if (pls->input)
-                ffurl_close(pls->input);
-            pls->input = NULL;
+            stop_prefetch(pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -1615,6 +2176,9 @@ static int hls_close(AVFormatContext *s)
     free_playlist_list(c);
     free_variant_list(c);
     free_rendition_list(c);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&c->http_options_mutex);
+#endif
     return 0;
 }
 
@@ -1623,7 +2187,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
 {
     HLSContext *c = s->priv_data;
     struct playlist *seek_pls = NULL;
-    int i, seq_no;
+    int i, seq_no, ret;
     int64_t first_timestamp, seek_timestamp, duration;
 
     if ((flags & AVSEEK_FLAG_BYTE) ||
@@ -1655,7 +2219,12 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     }
     /* check if the timestamp is valid for the playlist with the
      * specified stream index */
-    if (!seek_pls || !find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no))
+    if (!seek_pls)
+        return AVERROR(EIO);
+    playlist_lock(seek_pls);
+    ret = find_timestamp_in_playlist(c, seek_pls, seek_timestamp, &seq_no);
+    playlist_unlock(seek_pls);
+    if (!ret)
         return AVERROR(EIO);
 
     /* set segment now so we do not need to search again below */
@@ -1665,10 +2234,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
-        if (pls->input) {
-            ffurl_close(pls->input);
-            pls->input = NULL;
-        }
+        stop_prefetch(pls);
         av_free_packet(&pls->pkt);
         reset_packet(&pls->pkt);
         pls->pb.eof_reached = 0;
@@ -1684,7 +2250,9 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
 
         if (pls != seek_pls) {
             /* set closest segment seq_no for playlists not handled above */
+            playlist_lock(pls);
             find_timestamp_in_playlist(c, pls, seek_timestamp, &pls->cur_seq_no);
+            playlist_unlock(pls);
             /* seek the playlist to the given position without taking
              * keyframes into account since this playlist does not have the
              * specified stream where we should look for the keyframes */
@@ -1711,9 +2279,29 @@ static int hls_probe(AVProbeData *p)
     return 0;
 }
 
+#define OFFSET(x) offsetof(HLSContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+static const AVOption hls_options[] = {
+    { "prefetch_segments", "number of segments to download ahead in a background thread, 0 to disable",
+      OFFSET(prefetch_segments), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 16, D },
+    { "prefetch_size", "maximum amount of prefetched data per playlist in bytes",
+      OFFSET(prefetch_size), AV_OPT_TYPE_INT, { .i64 = 16 * 1024 * 1024 }, 1, INT_MAX, D },
+    { "http_persistent", "use persistent HTTP connections for playlists and segments",
+      OFFSET(http_persistent), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, D },
+    { NULL },
+};
+
+static const AVClass hls_class = {
+    .class_name = "hls,applehttp",
+    .item_name  = av_default_item_name,
+    .option     = hls_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_hls_demuxer = {
     .name           = "hls,applehttp",
     .long_name      = NULL_IF_CONFIG_SMALL("Apple HTTP Live Streaming"),
+    .priv_class     = &hls_class,
     .priv_data_size = sizeof(HLSContext),
     .read_probe     = hls_probe,
     .read_header    = hls_read_header,
@@ -20,6 +20,8 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
 #include "network.h"
@@ -32,6 +34,9 @@
 #if CONFIG_ZLIB
 #include <zlib.h>
 #endif
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 /* XXX: POST protocol is not completely implemented because ffmpeg uses
    only a subset of it. */
@@ -43,6 +48,10 @@
 #define BUFFER_SIZE MAX_URL_SIZE
 #define MAX_REDIRECTS 8
 
+/* Idle persistent connections kept for reuse by later requests. */
+#define POOL_SIZE         16
+#define POOL_IDLE_TIMEOUT (30 * 1000000LL)
+
 typedef struct {
     const AVClass *class;
     URLContext *hd;
@@ -52,6 +61,10 @@ typedef struct {
     /* Used if "Transfer-Encoding: chunked" otherwise -1. */
     int64_t chunksize;
     int64_t off, end_off, filesize;
+    /* Value of the Content-Length header, -1 if not present. */
+    int64_t content_length;
+    /* Offset at which the response body ends, -1 if unknown. */
+    int64_t body_end;
     char *location;
     HTTPAuthState auth_state;
     HTTPAuthState proxy_auth_state;
@@ -70,6 +83,8 @@ typedef struct {
     int end_header;
     /* A flag which indicates if we use persistent connections. */
     int multiple_requests;
+    /* Lower protocol URL and options the connection was opened with. */
+    char *pool_key;
     uint8_t *post_data;
     int post_datalen;
     int is_akamai;
@@ -102,7 +117,7 @@ static const AVOption options[] = {
 {"content_type", "set a specific content type for the POST messages", OFFSET(content_type), AV_OPT_TYPE_STRING, { 0 }, 0, 0, D|E },
 {"user_agent", "override User-Agent header", OFFSET(user_agent), AV_OPT_TYPE_STRING, {.str = DEFAULT_USER_AGENT}, 0, 0, D },
 {"user-agent", "override User-Agent header", OFFSET(user_agent), AV_OPT_TYPE_STRING, {.str = DEFAULT_USER_AGENT}, 0, 0, D },
-{"multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
+{"multiple_requests", "use persistent connections and reuse idle ones", OFFSET(multiple_requests), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
 {"post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D|E },
 {"mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, {0}, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY  },
 {"cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, {0}, 0, 0, D },
@@ -142,6 +157,173 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+typedef struct HTTPPoolEntry {
+    char *key;
+    URLContext *hd;
+    int64_t idle_since;
+} HTTPPoolEntry;
+
+/* Connections are only shared if they can be protected by a lock. */
+#define POOL_ENABLED (HAVE_PTHREADS || !HAVE_THREADS)
+
+static HTTPPoolEntry pool[POOL_SIZE];
+static int pool_count;
+#if HAVE_PTHREADS
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define pool_lock()   pthread_mutex_lock(&pool_mutex)
+#define pool_unlock() pthread_mutex_unlock(&pool_mutex)
+#else
+#define pool_lock()
+#define pool_unlock()
+#endif
+
+static void pool_remove(int i, HTTPPoolEntry *entry)
+{
+    *entry = pool[i];
+    pool[i] = pool[--pool_count];
+}
+
+static void pool_close_entry(HTTPPoolEntry *entry)
+{
+    ffurl_close(entry->hd);
+    av_free(entry->key);
+}
+
+/**
+ * Check whether an idle connection is still usable. The server must not
+ * have sent anything, so if the socket is readable, it has been closed or
+ * is in an unknown state.
+ */
+static int pool_connection_alive(URLContext *hd)
+{
+    struct pollfd p = { ffurl_get_file_handle(hd), POLLIN, 0 };
+
+    if (p.fd < 0)
+        return 0;
+    return !poll(&p, 1, 0);
+}
+
+/**
+ * Take an idle connection opened with the given key out of the pool.
+ *
+ * @return the connection, or NULL if there is none
+ */
+static URLContext *pool_get(const char *key, const AVIOInterruptCB *int_cb)
+{
+    HTTPPoolEntry entry, expired[POOL_SIZE];
+    URLContext *hd = NULL;
+    int64_t now = av_gettime();
+    int i, nb_expired = 0;
+
+    if (!POOL_ENABLED)
+        return NULL;
+
+    pool_lock();
+    for (i = pool_count - 1; i >= 0; i--) {
+        if (now - pool[i].idle_since > POOL_IDLE_TIMEOUT) {
+            pool_remove(i, &expired[nb_expired++]);
+        } else if (!hd && !strcmp(pool[i].key, key)) {
+            pool_remove(i, &entry);
+            if (pool_connection_alive(entry.hd)) {
+                hd = entry.hd;
+                av_free(entry.key);
+            } else {
+                expired[nb_expired++] = entry;
+            }
+        }
+    }
+    pool_unlock();
+
+    for (i = 0; i < nb_expired; i++)
+        pool_close_entry(&expired[i]);
+
+    /* the connection is now used on behalf of another caller; protocols
+     * wrapping another connection, like tls, pass the callback on to it */
+    if (hd)
+        hd->interrupt_callback = *int_cb;
+    return hd;
+}
+
+/**
+ * Put an idle connection into the pool, evicting the oldest one if
+ * the pool is full. Ownership of both arguments is taken.
+ */
+static void pool_put(char *key, URLContext *hd)
+{
+    HTTPPoolEntry entry = { key, hd, av_gettime() }, evicted = { 0 };
+    int i, oldest = 0;
+
+    if (!POOL_ENABLED) {
+        pool_close_entry(&entry);
+        return;
+    }
+
+    pool_lock();
+    if (pool_count == POOL_SIZE) {
+        for (i = 1; i < pool_count; i++)
+            if (pool[i].idle_since < pool[oldest].idle_since)
+                oldest = i;
+        pool_remove(oldest, &evicted);
+    }
+    pool[pool_count++] = entry;
+    pool_unlock();
+
+    if (evicted.hd)
+        pool_close_entry(&evicted);
+}
+
+void ff_http_close_idle_connections(void)
+{
+    HTTPPoolEntry entry;
+
+    if (!POOL_ENABLED)
+        return;
+
+    pool_lock();
+    while (pool_count > 0) {
+        pool_remove(pool_count - 1, &entry);
+        pool_unlock();
+        pool_close_entry(&entry);
+        pool_lock();
+    }
+    pool_unlock();
+}
+
+/**
+ * Build the key identifying the connections that can be used for a request:
+ * the lower protocol URL and all options not handled by HTTP itself, since
+ * those (e.g. TLS certificate verification) apply to the connection.
+ */
+static int pool_make_key(URLContext *h, const char *url, AVDictionary *options)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionaryEntry *t = NULL;
+    AVBPrint key;
+
+    av_bprint_init(&key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&key, "%s", url);
+    while ((t = av_dict_get(options, "", t, AV_DICT_IGNORE_SUFFIX)))
+        if (!av_opt_find(s, t->key, NULL, 0, 0))
+            av_bprintf(&key, "\n%s=%s", t->key, t->value);
+
+    av_freep(&s->pool_key);
+    return av_bprint_finalize(&key, &s->pool_key);
+}
+
+/**
+ * Check whether the connection can carry another request, i.e. a keep-alive
+ * response has been read completely and nothing else is pending on it.
+ */
+static int http_connection_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    return s->multiple_requests && s->pool_key && !s->willclose &&
+           !(h->flags & AVIO_FLAG_WRITE) && !s->post_data &&
+           s->end_header && s->chunksize < 0 && s->body_end >= 0 &&
+           s->off == s->body_end && s->buf_ptr == s->buf_end;
+}
+
 /* return non zero if error */
 static int http_open_cnx(URLContext *h, AVDictionary **options)
 {
@@ -151,11 +333,14 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
     char path1[MAX_URL_SIZE];
     char buf[1024], urlbuf[MAX_URL_SIZE];
     int port, use_proxy, err, location_changed = 0, redirects = 0, attempts = 0;
+    int reused;
     HTTPAuthType cur_auth_type, cur_proxy_auth_type;
     HTTPContext *s = h->priv_data;
+    int64_t off = s->off;
 
     /* fill the dest addr */
  redo:
+    reused = 0;
     /* needed in any case to build the host string */
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
                  hostname, sizeof(hostname), &port,
@@ -193,16 +378,33 @@ static int http_open_cnx(URLContext *h, AVDictionary **options)
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
     if (!s->hd) {
-        err = ffurl_open(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                         &h->interrupt_callback, options);
-        if (err < 0)
-            goto fail;
+        if (s->multiple_requests) {
+            if (pool_make_key(h, buf, options ? *options : NULL) < 0)
+                goto fail;
+            s->hd  = pool_get(s->pool_key, &h->interrupt_callback);
+            reused = !!s->hd;
+        }
+        if (!s->hd) {
+            err = ffurl_open(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                             &h->interrupt_callback, options);
+            if (err < 0)
+                goto fail;
+        }
     }
 
     cur_auth_type = s->auth_state.auth_type;
     cur_proxy_auth_type = s->auth_state.auth_type;
-    if (http_connect(h, path, local_path, hoststr, auth, proxyauth, &location_changed) < 0)
+    if (http_connect(h, path, local_path, hoststr, auth, proxyauth, &location_changed) < 0) {
+        if (reused) {
+            /* the server may have closed the idle connection just now,
+             * retry on another one */
+            av_log(h, AV_LOG_DEBUG, "Reused connection failed, reconnecting\n");
+            ffurl_closep(&s->hd);
+            s->off = off;
+            goto redo;
+        }
         goto fail;
+    }
     attempts++;
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
@@ -467,8 +669,10 @@ static int process_line(URLContext *h, char *line, int line_count,
             if ((ret = parse_location(s, p)) < 0)
                 return ret;
             *new_location = 1;
-        } else if (!av_strcasecmp(tag, "Content-Length") && s->filesize == -1) {
-            s->filesize = strtoll(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "Content-Length")) {
+            s->content_length = strtoll(p, NULL, 10);
+            if (s->filesize == -1)
+                s->filesize = s->content_length;
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -657,6 +861,9 @@ static int http_read_header(URLContext *h, int *new_location)
     if (s->seekable == -1 && s->is_mediagateway && s->filesize == 2000000000)
         h->is_streamed = 1; /* we can in fact _not_ seek */
 
+    if (s->chunksize < 0 && s->content_length >= 0)
+        s->body_end = s->off + s->content_length;
+
     return err;
 }
 
@@ -791,6 +998,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     s->off = 0;
     s->icy_data_read = 0;
     s->filesize = -1;
+    s->content_length = -1;
+    s->body_end = -1;
     s->willclose = 0;
     s->end_chunked_post = 0;
     s->end_header = 0;
@@ -830,6 +1039,10 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
     } else {
         if (!s->willclose && s->filesize >= 0 && s->off >= s->filesize)
             return AVERROR_EOF;
+        /* on a persistent connection, the server does not close it after
+         * a partial response either */
+        if (!s->willclose && s->body_end >= 0 && s->off >= s->body_end)
+            return AVERROR_EOF;
         len = ffurl_read(s->hd, buf, size);
     }
     if (len > 0) {
@@ -1038,8 +1251,14 @@ static int http_close(URLContext *h)
         ret = http_shutdown(h, h->flags);
     }
 
+    if (s->hd && http_connection_reusable(h)) {
+        pool_put(s->pool_key, s->hd);
+        s->pool_key = NULL;
+        s->hd       = NULL;
+    }
     if (s->hd)
         ffurl_closep(&s->hd);
+    av_freep(&s->pool_key);
     av_dict_free(&s->chained_options);
     return ret;
 }
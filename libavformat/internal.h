@@ -54,6 +54,27 @@ struct AVFormatInternal {
     int nb_interleaved_streams;
 
     int inject_global_side_data;
+
+    /**
+     * Probe cache state, see probecache.c.
+     * Demuxing only.
+     */
+    char *probe_cache_path;
+    uint8_t *probe_cache_data;  ///< cache key, followed by the stream parameters if probe_cache_params is set
+    int probe_cache_size;
+    int probe_cache_params;
+    int probe_cache_nb_index_entries;
+    uint8_t *probe_cache_file;  ///< cache file read by ff_probe_cache_check()
+    int probe_cache_file_size;
+
+    /**
+     * Set before read_header() if the probe cache may hold the index of the
+     * file, cleared if it turns out not to match the streams. Demuxers may
+     * only skip reading the index of the file if ff_probe_cache_load()
+     * returns 1 at the end of read_header().
+     */
+    int probe_cache_hit;
+    int probe_cache_loaded;
 };
 
 #ifdef __GNUC__
@@ -400,6 +421,36 @@ int ff_rfps_add_frame(AVFormatContext *ic, AVStream *st, int64_t dts);
 
 void ff_rfps_calculate(AVFormatContext *ic);
 
+/**
+ * Look up s in the probe cache if AVFormatContext.probe_cache is set, and
+ * set AVFormatInternal.probe_cache_hit if it holds an entry for the file
+ * and the options of s. Called before read_header().
+ *
+ * @return 1 on a cache hit, 0 otherwise, AVERROR_xxx on error
+ */
+int ff_probe_cache_check(AVFormatContext *s);
+
+/**
+ * Restore the stream parameters and index entries from the entry found by
+ * ff_probe_cache_check(), if it matches the streams created by
+ * read_header(). The index entries are merged with those added by
+ * read_header(). Called after read_header(), or by the demuxer once its
+ * streams are created; only the first call has an effect.
+ *
+ * @return 1 if the parameters were restored, 0 if they must be probed,
+ *         AVERROR_xxx on error
+ */
+int ff_probe_cache_load(AVFormatContext *s);
+
+/**
+ * Write the stream parameters and index entries of s to the probe cache.
+ * Only has an effect after ff_probe_cache_load() and only writes the cache
+ * again if the number of index entries changed.
+ *
+ * @return 0 if OK, AVERROR_xxx on error
+ */
+int ff_probe_cache_store(AVFormatContext *s);
+
 /**
  * Flags for AVFormatContext.write_uncoded_frame()
  */
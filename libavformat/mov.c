@@ -3637,8 +3637,10 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #if CONFIG_DV_DEMUXER
         if (mov->dv_demux && sc->dv_audio_container) {
-            avpriv_dv_produce_packet(mov->dv_demux, pkt, pkt->data, pkt->size, pkt->pos);
-            av_free(pkt->data);
+            /* the data may reference the input buffer */
+            AVPacket dv_pkt = *pkt;
+            avpriv_dv_produce_packet(mov->dv_demux, pkt, dv_pkt.data, dv_pkt.size, dv_pkt.pos);
+            av_free_packet(&dv_pkt);
             pkt->size = 0;
             ret = avpriv_dv_get_packet(mov->dv_demux, pkt);
             if (ret < 0)
@@ -3765,5 +3767,5 @@ AVInputFormat ff_mov_demuxer = {
     .read_close     = mov_read_close,
     .read_seek      = mov_read_seek,
     .priv_class     = &mov_class,
-    .flags          = AVFMT_NO_BYTE_SEEK,
+    .flags          = AVFMT_NO_BYTE_SEEK | AVFMT_ZERO_COPY,
 };
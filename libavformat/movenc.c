@@ -60,6 +60,9 @@ static const AVOption options[] = {
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "faststart", "Run a second pass to put the index (moov atom) at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "dash", "Write DASH compatible fragmented MP4", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DASH}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "reserve_moov", "Reserve space for the moov atom at the beginning, estimated from the duration", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RESERVE_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "expected_duration", "Duration used by reserve_moov if the output duration is not set", offsetof(MOVMuxContext, expected_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM},
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
     { "skip_iods", "Skip writing iods atom.", offsetof(MOVMuxContext, iods_skip), AV_OPT_TYPE_INT, {.i64 = 1}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM},
     { "iods_audio_profile", "iods audio profile atom.", offsetof(MOVMuxContext, iods_audio_profile), AV_OPT_TYPE_INT, {.i64 = -1}, -1, 255, AV_OPT_FLAG_ENCODING_PARAM},
@@ -2786,6 +2789,18 @@ static int mov_write_trun_tag(AVIOContext *pb, MOVMuxContext *mov,
     return update_size(pb, pos);
 }
 
+static int mov_write_tfdt_tag(AVIOContext *pb, MOVTrack *track)
+{
+    int64_t pos = avio_tell(pb);
+
+    avio_wb32(pb, 0); /* size placeholder */
+    ffio_wfourcc(pb, "tfdt");
+    avio_w8(pb, 1); /* version */
+    avio_wb24(pb, 0);
+    avio_wb64(pb, track->frag_start);
+    return update_size(pb, pos);
+}
+
 static int mov_write_tfxd_tag(AVIOContext *pb, MOVTrack *track)
 {
     int64_t pos = avio_tell(pb);
@@ -2864,6 +2879,8 @@ static int mov_write_traf_tag(AVIOContext *pb, MOVMuxContext *mov,
     ffio_wfourcc(pb, "traf");
 
     mov_write_tfhd_tag(pb, mov, track, moof_offset);
+    if (mov->flags & FF_MOV_FLAG_DASH)
+        mov_write_tfdt_tag(pb, track);
     mov_write_trun_tag(pb, mov, track, moof_size);
     if (mov->mode == MODE_ISM) {
         mov_write_tfxd_tag(pb, track);
@@ -2999,7 +3016,10 @@ static int mov_write_ftyp_tag(AVIOContext *pb, AVFormatContext *s)
 
     if (mov->major_brand && strlen(mov->major_brand) >= 4)
         ffio_wfourcc(pb, mov->major_brand);
-    else if (mov->mode == MODE_3GP) {
+    else if (mov->flags & FF_MOV_FLAG_DASH) {
+        ffio_wfourcc(pb, "iso5");
+        minor = 1;
+    } else if (mov->mode == MODE_3GP) {
         ffio_wfourcc(pb, has_h264 ? "3gp6"  : "3gp4");
         minor =     has_h264 ?   0x100 :   0x200;
     } else if (mov->mode & MODE_3G2) {
@@ -3022,7 +3042,10 @@ static int mov_write_ftyp_tag(AVIOContext *pb, AVFormatContext *s)
 
     if (mov->mode == MODE_MOV)
         ffio_wfourcc(pb, "qt  ");
-    else if (mov->mode == MODE_ISM) {
+    else if (mov->flags & FF_MOV_FLAG_DASH) {
+        ffio_wfourcc(pb, "iso6");
+        ffio_wfourcc(pb, "dash");
+    } else if (mov->mode == MODE_ISM) {
         ffio_wfourcc(pb, "piff");
         ffio_wfourcc(pb, "iso2");
     } else {
@@ -3847,6 +3870,59 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Estimate an upper bound of the moov size from the expected duration of
+ * the file, assuming the worst case of one chunk and one entry in each
+ * sample table per sample. Returns 0 if no estimate can be made.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t duration = s->duration > 0 ? s->duration : mov->expected_duration;
+    int64_t size = 4096;
+    int i;
+
+    if (duration <= 0 || mov->flags & FF_MOV_FLAG_RTP_HINT)
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        AVCodecContext *enc = track->enc;
+        AVRational rate;
+        int64_t samples;
+        /* stsz, stts, stco/co64 and stsc entries */
+        int entry_size = 4 + 8 + 8 + 12;
+
+        switch (enc->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            rate = s->streams[i]->avg_frame_rate;
+            if (!rate.num || !rate.den)
+                rate = av_make_q(enc->time_base.den,
+                                 enc->time_base.num * enc->ticks_per_frame);
+            /* ctts and stss entries */
+            entry_size += 8 + 4;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            rate = av_make_q(enc->sample_rate,
+                             enc->frame_size > 0 ? enc->frame_size : 1024);
+            break;
+        default:
+            rate = av_make_q(1, 1);
+            break;
+        }
+        if (!rate.num || !rate.den)
+            return 0;
+        samples = av_rescale(duration, rate.num,
+                             rate.den * (int64_t)AV_TIME_BASE) + 1;
+        size += 1024 + track->vos_len + samples * entry_size;
+    }
+    /* chapter and timecode tracks */
+    size += (mov->nb_streams - s->nb_streams + s->nb_chapters) * 1024;
+
+    /* leave some room for the duration being slightly longer */
+    return size + size / 16;
+}
+
 static int mov_write_header(AVFormatContext *s)
 {
     AVIOContext *pb = s->pb;
@@ -3895,6 +3971,13 @@ static int mov_write_header(AVFormatContext *s)
             mov->reserved_moov_size = -1;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV &&
+        mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        av_log(s, AV_LOG_WARNING, "The reserve_moov flag is incompatible "
+               "with fragmentation, disabling it\n");
+        mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+    }
+
     if (!supports_edts(mov) && s->avoid_negative_ts < 0) {
         s->avoid_negative_ts = 2;
     }
@@ -4081,6 +4164,17 @@ static int mov_write_header(AVFormatContext *s)
 
     enable_tracks(s);
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV && mov->reserved_moov_size <= 0) {
+        int64_t size = estimate_moov_size(s);
+        if (size > 0 && size <= INT_MAX) {
+            av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+            mov->reserved_moov_size = size;
+        } else {
+            av_log(s, AV_LOG_WARNING, "Cannot estimate the moov size without "
+                   "a known duration, disabling reserve_moov\n");
+            mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+        }
+    }
 
     if (mov->reserved_moov_size){
         mov->reserved_moov_pos= avio_tell(pb);
@@ -4095,7 +4189,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->reserved_moov_size < 0)
             mov->reserved_moov_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -4310,9 +4404,27 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+
+        if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0) {
+                res = moov_size;
+                goto error;
+            }
+            if (moov_size > mov->reserved_moov_size - 8) {
+                av_log(s, AV_LOG_WARNING, "The moov atom needs %d bytes but "
+                       "only %d were reserved\n", moov_size, mov->reserved_moov_size);
+                /* leave the reserved space as a free atom and fall back to
+                 * faststart or to writing the moov atom at the end */
+                avio_seek(pb, mov->reserved_moov_pos, SEEK_SET);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                mov->reserved_moov_size = -1;
+            }
+        }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_moov_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res == 0) {
@@ -4329,7 +4441,7 @@ static int mov_write_trailer(AVFormatContext *s)
             }
             avio_wb32(pb, size);
             ffio_wfourcc(pb, "free");
-            for (i = 0; i < size; i++)
+            for (i = 8; i < size; i++)
                 avio_w8(pb, 0);
             avio_seek(pb, moov_pos, SEEK_SET);
         } else {
@@ -174,6 +174,7 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_moov_pos;
+    int64_t expected_duration; ///< used by reserve_moov if the duration is unknown
 
     char *major_brand;
 } MOVMuxContext;
@@ -187,6 +188,8 @@ typedef struct MOVMuxContext {
 #define FF_MOV_FLAG_ISML 64
 #define FF_MOV_FLAG_FASTSTART 128
 #define FF_MOV_FLAG_OMIT_TFHD_OFFSET 256
+#define FF_MOV_FLAG_DASH 512
+#define FF_MOV_FLAG_RESERVE_MOOV 1024
 
 int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt);
 
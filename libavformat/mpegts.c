@@ -87,6 +87,8 @@ struct MpegTSFilter {
     int es_id;
     int last_cc; /* last cc code (-1 if first packet) */
     int64_t last_pcr;
+    int discard; /* cached result of discard_pid() */
+    unsigned int discard_gen; /* MpegTSContext.discard_gen when discard was set */
     enum MpegTSFilterType type;
     union {
         MpegTSPESFilter pes_filter;
@@ -148,6 +150,10 @@ struct MpegTSContext {
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
     int current_pid;
+
+    /** incremented whenever the cached discard state of the filters may
+     *  be outdated */
+    unsigned int discard_gen;
 };
 
 static const AVOption mpegtsraw_options[] = {
@@ -353,6 +359,15 @@ static int discard_pid(MpegTSContext *ts, unsigned int pid)
     return !used && discarded;
 }
 
+static int discard_filter(MpegTSContext *ts, MpegTSFilter *f)
+{
+    if (f->discard_gen != ts->discard_gen) {
+        f->discard     = f->pid && discard_pid(ts, f->pid);
+        f->discard_gen = ts->discard_gen;
+    }
+    return f->discard;
+}
+
 /**
  *  Assemble PES packets out of TS packets, and then call the "section_cb"
  *  function when they are complete.
@@ -497,14 +512,14 @@ static void mpegts_close_filter(MpegTSContext *ts, MpegTSFilter *filter)
 static int analyze(const uint8_t *buf, int size, int packet_size, int *index)
 {
     int stat[TS_MAX_PACKET_SIZE];
-    int i;
+    const uint8_t *p, *end = buf + size - 3;
     int best_score = 0;
 
     memset(stat, 0, packet_size * sizeof(*stat));
 
-    for (i = 0; i < size - 3; i++) {
-        if (buf[i] == 0x47 && !(buf[i + 1] & 0x80) && buf[i + 3] != 0x47) {
-            int x = i % packet_size;
+    for (p = buf; p < end && (p = memchr(p, 0x47, end - p)); p++) {
+        if (!(p[1] & 0x80) && p[3] != 0x47) {
+            int x = (p - buf) % packet_size;
             stat[x]++;
             if (stat[x] > best_score) {
                 best_score = stat[x];
@@ -2010,15 +2025,15 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if (pid && discard_pid(ts, pid))
-        return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
     if (ts->auto_guess && tss == NULL && is_start) {
+        if (pid && discard_pid(ts, pid))
+            return 0;
         add_pes_stream(ts, pid, -1);
         tss = ts->pids[pid];
     }
-    if (!tss)
+    if (!tss || discard_filter(ts, tss))
         return 0;
     ts->current_pid = pid;
 
@@ -2094,6 +2109,9 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
             }
         }
 
+        /* the section may have changed the programs */
+        ts->discard_gen++;
+
         // stop find_stream_info from waiting for more streams
         // when all programs have received a PMT
         if (ts->stream->ctx_flags & AVFMTCTX_NOHEADER) {
@@ -2168,6 +2186,16 @@ static int mpegts_resync(AVFormatContext *s)
     int c, i;
 
     for (i = 0; i < MAX_RESYNC_SIZE; i++) {
+        /* search the data already buffered at once */
+        int left = FFMIN(pb->buf_end - pb->buf_ptr, MAX_RESYNC_SIZE - i);
+        if (left > 0) {
+            const uint8_t *sync = memchr(pb->buf_ptr, 0x47, left);
+            int skip = sync ? sync - pb->buf_ptr : left;
+            avio_skip(pb, skip);
+            i += skip;
+            if (i >= MAX_RESYNC_SIZE)
+                break;
+        }
         c = avio_r8(pb);
         if (url_feof(pb))
             return AVERROR_EOF;
@@ -2219,13 +2247,64 @@ static void finished_reading_packet(AVFormatContext *s, int raw_packet_size)
         avio_skip(pb, skip);
 }
 
+/**
+ * Check whether a packet can be dropped without any further parsing,
+ * because nothing would be done with it.
+ */
+static int packet_is_unwanted(MpegTSContext *ts, const uint8_t *packet)
+{
+    int pid = AV_RB16(packet + 1) & 0x1fff;
+    MpegTSFilter *tss = ts->pids[pid];
+
+    if (!tss)
+        return !ts->auto_guess || !(packet[1] & 0x40);
+    if (discard_filter(ts, tss))
+        return 1;
+    if (tss->type == MPEGTS_PES) {
+        PESContext *pes = tss->u.pes_filter.opaque;
+        /* the payload of discarded streams is skipped anyway */
+        if (pes->state == MPEGTS_SKIP &&
+            pes->st && pes->st->discard == AVDISCARD_ALL &&
+            (!pes->sub_st || pes->sub_st->discard == AVDISCARD_ALL)) {
+            tss->last_cc = -1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Skip the run of unwanted packets which are already in the I/O buffer.
+ * When only a few programs or streams of a multiplex are used, this avoids
+ * reading most packets one by one.
+ *
+ * @return the number of packets skipped
+ */
+static int skip_unwanted_packets(MpegTSContext *ts, int max_packets)
+{
+    AVIOContext *pb = ts->stream->pb;
+    const uint8_t *p = pb->buf_ptr;
+    int raw_packet_size = ts->raw_packet_size;
+    int n = 0;
+
+    while (n < max_packets && pb->buf_end - p >= raw_packet_size &&
+           p[0] == 0x47 && packet_is_unwanted(ts, p)) {
+        p += raw_packet_size;
+        n++;
+    }
+    if (n)
+        avio_skip(pb, n * raw_packet_size);
+    return n;
+}
+
 static int handle_packets(MpegTSContext *ts, int nb_packets)
 {
     AVFormatContext *s = ts->stream;
     uint8_t packet[TS_PACKET_SIZE + FF_INPUT_BUFFER_PADDING_SIZE];
     const uint8_t *data;
-    int packet_num, ret = 0;
+    int packet_num, skipped, ret = 0;
 
+    ts->discard_gen++;
     if (avio_tell(s->pb) != ts->last_pos) {
         int i;
         av_dlog(ts->stream, "Skipping after seek\n");
@@ -2257,6 +2336,13 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
         if (ts->stop_parse > 0)
             break;
 
+        skipped = skip_unwanted_packets(ts, nb_packets ? nb_packets - packet_num
+                                                       : INT_MAX);
+        if (skipped) {
+            packet_num += skipped - 1;
+            continue;
+        }
+
         ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             break;
@@ -2627,6 +2713,7 @@ int ff_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
 
     len1 = len;
     ts->pkt = pkt;
+    ts->discard_gen++;
     for (;;) {
         ts->stop_parse = 0;
         if (len < TS_PACKET_SIZE)
@@ -926,6 +926,8 @@ fail:
        avio_flush(s->pb);
     if (ret == 0)
        ret = s->pb ? s->pb->error : 0;
+    if (s->oformat->deinit)
+        s->oformat->deinit(s);
     for (i = 0; i < s->nb_streams; i++) {
         av_freep(&s->streams[i]->priv_data);
         av_freep(&s->streams[i]->index_entries);
@@ -767,7 +767,9 @@ static int nut_read_header(AVFormatContext *s)
 
     s->data_offset = pos - 8;
 
-    if (bc->seekable) {
+    /* the index and duration are restored from the probe cache, unless it
+     * does not match the streams */
+    if (bc->seekable && ff_probe_cache_load(s) <= 0) {
         int64_t orig_pos = avio_tell(bc);
         find_and_decode_index(nut);
         avio_seek(bc, orig_pos, SEEK_SET);
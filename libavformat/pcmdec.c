@@ -79,7 +79,7 @@ AVInputFormat ff_pcm_ ## name_ ## _demuxer = {              \
     .read_header    = pcm_read_header,                      \
     .read_packet    = ff_pcm_read_packet,                   \
     .read_seek      = ff_pcm_read_seek,                     \
-    .flags          = AVFMT_GENERIC_INDEX,                  \
+    .flags          = AVFMT_GENERIC_INDEX | AVFMT_ZERO_COPY, \
     .extensions     = ext,                                  \
     .raw_codec_id   = codec,                                \
     .priv_class     = &name_ ## _demuxer_class,             \
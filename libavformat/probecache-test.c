@@ -0,0 +1,187 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Write a NUT file, then open it several times with the probe cache
+ * enabled, checking that the cache is used and gives the same stream
+ * parameters and index as probing, and that the file is probed again if
+ * the cached streams do not match.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "avformat.h"
+#include "internal.h"
+
+#define NB_PACKETS  100
+#define PACKET_SIZE 1600
+
+static int write_file(const char *filename)
+{
+    AVFormatContext *oc = NULL;
+    uint8_t data[PACKET_SIZE] = { 0 };
+    AVStream *st;
+    AVPacket pkt;
+    int i, ret;
+
+    if ((ret = avformat_alloc_output_context2(&oc, NULL, "nut", filename)) < 0)
+        return ret;
+    if (!(st = avformat_new_stream(oc, NULL))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codec->codec_type  = AVMEDIA_TYPE_AUDIO;
+    st->codec->codec_id    = AV_CODEC_ID_PCM_S16LE;
+    st->codec->sample_rate = 8000;
+    st->codec->channels    = 1;
+    st->time_base          = (AVRational){ 1, 8000 };
+
+    if ((ret = avio_open(&oc->pb, filename, AVIO_FLAG_WRITE)) < 0)
+        goto end;
+    if ((ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+    for (i = 0; i < NB_PACKETS && ret >= 0; i++) {
+        av_init_packet(&pkt);
+        data[0]  = i;
+        pkt.data = data;
+        pkt.size = sizeof(data);
+        pkt.pts  = pkt.dts = i * PACKET_SIZE / 2;
+        pkt.flags |= AV_PKT_FLAG_KEY;
+        ret = av_write_frame(oc, &pkt);
+    }
+    if (ret >= 0)
+        ret = av_write_trailer(oc);
+
+end:
+    if (oc)
+        avio_close(oc->pb);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static int test(const char *name, const char *filename, const char *cache,
+                const char *fflags, char **cache_path)
+{
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    AVStream *st;
+    AVPacket pkt;
+    int hit, ret;
+
+    av_dict_set(&opts, "probe_cache", cache, 0);
+    if (fflags)
+        av_dict_set(&opts, "fflags", fflags, 0);
+    ret = avformat_open_input(&ic, filename, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        goto end;
+    hit = ic->internal->probe_cache_hit;
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto end;
+    if (!*cache_path && ic->internal->probe_cache_path)
+        *cache_path = av_strdup(ic->internal->probe_cache_path);
+
+    st = ic->streams[0];
+    printf("%s: cache %s, duration %"PRId64", %s %d Hz, %d index entries\n",
+           name, hit ? "hit" : "miss", ic->duration,
+           avcodec_get_name(st->codec->codec_id), st->codec->sample_rate,
+           st->nb_index_entries);
+
+    if ((ret = av_seek_frame(ic, 0, 8000 * 5, 0)) < 0 ||
+        (ret = av_read_frame(ic, &pkt)) < 0)
+        goto end;
+    printf("%s: seek to 5s, packet %d pts %"PRId64"\n",
+           name, pkt.data[0], pkt.pts);
+    av_free_packet(&pkt);
+
+end:
+    if (ret < 0)
+        printf("%s: failed (%s)\n", name, av_err2str(ret));
+    avformat_close_input(&ic);
+    return ret;
+}
+
+/* change the codec of the stream in the cache key, keeping the checksum valid */
+static int change_cached_codec(const char *cache_path)
+{
+    static const uint8_t streams[] = {
+        0, 0, 0, 1,                                 /* nb_streams */
+        0, 0, 0, AVMEDIA_TYPE_AUDIO,
+        AV_CODEC_ID_PCM_S16LE >> 24, AV_CODEC_ID_PCM_S16LE >> 16 & 0xff,
+        AV_CODEC_ID_PCM_S16LE >> 8 & 0xff, AV_CODEC_ID_PCM_S16LE & 0xff,
+    };
+    uint8_t buf[4096];
+    FILE *f;
+    int i, size;
+
+    if (!(f = fopen(cache_path, "r+b")))
+        return AVERROR(errno);
+    size = fread(buf, 1, sizeof(buf), f);
+    for (i = 0; i + sizeof(streams) <= size; i++)
+        if (!memcmp(buf + i, streams, sizeof(streams)))
+            break;
+    if (size < 4 || size == sizeof(buf) || i + sizeof(streams) > size) {
+        fclose(f);
+        return AVERROR_INVALIDDATA;
+    }
+    AV_WB32(buf + i + 8, AV_CODEC_ID_PCM_S16BE);
+    AV_WB32(buf + size - 4, av_adler32_update(0, buf, size - 4));
+    rewind(f);
+    fwrite(buf, 1, size, f);
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char filename[1024], *cache_path = NULL;
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <directory>\n", argv[0]);
+        return 1;
+    }
+
+    av_register_all();
+
+    snprintf(filename, sizeof(filename), "%s/probecache.nut", argv[1]);
+    if ((ret = write_file(filename)) < 0) {
+        printf("Could not write %s: %s\n", filename, av_err2str(ret));
+        return 1;
+    }
+
+    ret = test("probe",         filename, argv[1], NULL,     &cache_path) < 0 ||
+          test("cached",        filename, argv[1], NULL,     &cache_path) < 0;
+    if (!ret && change_cached_codec(cache_path) < 0) {
+        printf("Could not change the cache %s\n", cache_path);
+        ret = 1;
+    }
+    ret = ret ||
+          test("other streams", filename, argv[1], NULL,     &cache_path) < 0 ||
+          test("other options", filename, argv[1], "+genpts", &cache_path) < 0;
+
+    remove(filename);
+    if (cache_path)
+        remove(cache_path);
+    av_free(cache_path);
+    return ret;
+}
@@ -0,0 +1,536 @@
+/*
+ * Persistent cache of stream parameters and index entries
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Persistent cache of the avformat_find_stream_info() results.
+ *
+ * A cache file is named after the MD5 of the URL and starts with a key made
+ * of the URL, the demuxer name, the file size and modification time, the
+ * demuxing options and the stream layout returned by read_header(). It is
+ * followed by the stream parameters, the index entries of every stream and
+ * an Adler-32 checksum of everything before it. Files are written to a
+ * temporary name and renamed, so concurrent readers never see a partially
+ * written cache.
+ *
+ * The part of the key known before read_header() is checked first, so that
+ * demuxers can skip reading the index of the file when the cache has it.
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "libavutil/adler32.h"
+#include "libavutil/avstring.h"
+#include "libavutil/md5.h"
+#include "libavutil/opt.h"
+#include "libavutil/random_seed.h"
+#include "libavcodec/bytestream.h"
+#include "avformat.h"
+#include "avio_internal.h"
+#include "internal.h"
+
+#define PROBE_CACHE_TAG     MKBETAG('F', 'F', 'P', 'C')
+#define PROBE_CACHE_VERSION 3
+
+#define INDEX_ENTRY_SIZE 24
+
+static int get_cache_path(AVFormatContext *s, int64_t *size, int64_t *mtime)
+{
+    const char *proto = avio_find_protocol_name(s->filename);
+    const char *filename = s->filename;
+    uint8_t md5[16];
+    char hex[2 * sizeof(md5) + 1];
+    struct stat st;
+
+    if (!s->pb || !s->pb->seekable || (s->flags & AVFMT_FLAG_CUSTOM_IO) ||
+        (s->iformat->flags & AVFMT_NOFILE))
+        return AVERROR(ENOSYS);
+    if (!proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+
+    av_strstart(filename, "file:", &filename);
+    if (stat(filename, &st) < 0)
+        return AVERROR(errno);
+    *size  = st.st_size;
+    *mtime = st.st_mtime;
+
+    av_md5_sum(md5, s->filename, strlen(s->filename));
+    ff_data_to_hex(hex, md5, sizeof(md5), 1);
+    hex[2 * sizeof(md5)] = 0;
+
+    s->internal->probe_cache_path = av_asprintf("%s/%s.ffpc", s->probe_cache, hex);
+    if (!s->internal->probe_cache_path)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+static void put_str(AVIOContext *pb, const char *str)
+{
+    int len = strlen(str);
+
+    avio_wb32(pb, len);
+    avio_write(pb, str, len);
+}
+
+/**
+ * Write the demuxing options of obj, which can change the stream parameters
+ * or the index found.
+ */
+static int write_options(AVIOContext *pb, void *obj)
+{
+    const AVOption *o = NULL;
+    uint8_t *val;
+    int ret;
+
+    while ((o = av_opt_next(obj, o))) {
+        if (o->type == AV_OPT_TYPE_CONST ||
+            !(o->flags & AV_OPT_FLAG_DECODING_PARAM) ||
+            !strcmp(o->name, "probe_cache"))
+            continue;
+        if ((ret = av_opt_get(obj, o->name, 0, &val)) < 0)
+            return ret;
+        put_str(pb, o->name);
+        put_str(pb, val ? (char *)val : "");
+        av_free(val);
+    }
+    return 0;
+}
+
+/* the part of the key known before read_header() */
+static int write_key(AVIOContext *pb, AVFormatContext *s,
+                     int64_t size, int64_t mtime)
+{
+    int ret;
+
+    avio_wb32(pb, PROBE_CACHE_TAG);
+    avio_wb32(pb, PROBE_CACHE_VERSION);
+    /* the probed parameters depend on the parsers and decoders */
+    avio_wb32(pb, LIBAVFORMAT_VERSION_INT);
+    avio_wb32(pb, LIBAVCODEC_VERSION_INT);
+    put_str(pb, s->filename);
+    put_str(pb, s->iformat->name);
+    avio_wb64(pb, size);
+    avio_wb64(pb, mtime);
+
+    if ((ret = write_options(pb, s)) < 0)
+        return ret;
+    if (s->iformat->priv_class && s->priv_data &&
+        (ret = write_options(pb, s->priv_data)) < 0)
+        return ret;
+    return 0;
+}
+
+static void write_streams(AVIOContext *pb, AVFormatContext *s)
+{
+    int i;
+
+    avio_wb32(pb, s->nb_streams);
+    for (i = 0; i < s->nb_streams; i++) {
+        avio_wb32(pb, s->streams[i]->codec->codec_type);
+        avio_wb32(pb, s->streams[i]->codec->codec_id);
+    }
+}
+
+static void write_params(AVIOContext *pb, AVFormatContext *s)
+{
+    int i;
+
+    avio_wb64(pb, s->start_time);
+    avio_wb64(pb, s->duration);
+    avio_wb32(pb, s->bit_rate);
+    avio_wb32(pb, s->duration_estimation_method);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecContext *avctx = st->codec;
+
+        avio_wb32(pb, st->r_frame_rate.num);
+        avio_wb32(pb, st->r_frame_rate.den);
+        avio_wb32(pb, st->avg_frame_rate.num);
+        avio_wb32(pb, st->avg_frame_rate.den);
+        avio_wb32(pb, st->sample_aspect_ratio.num);
+        avio_wb32(pb, st->sample_aspect_ratio.den);
+        avio_wb64(pb, st->start_time);
+        avio_wb64(pb, st->duration);
+        avio_wb64(pb, st->nb_frames);
+        avio_wb32(pb, st->codec_info_nb_frames);
+
+        avio_wb32(pb, avctx->codec_type);
+        avio_wb32(pb, avctx->codec_id);
+        avio_wb32(pb, avctx->codec_tag);
+        avio_wb32(pb, avctx->bit_rate);
+        avio_wb32(pb, avctx->time_base.num);
+        avio_wb32(pb, avctx->time_base.den);
+        avio_wb32(pb, avctx->ticks_per_frame);
+        avio_wb32(pb, avctx->width);
+        avio_wb32(pb, avctx->height);
+        avio_wb32(pb, avctx->sample_aspect_ratio.num);
+        avio_wb32(pb, avctx->sample_aspect_ratio.den);
+        avio_wb32(pb, avctx->pix_fmt);
+        avio_wb32(pb, avctx->has_b_frames);
+        avio_wb32(pb, avctx->field_order);
+        avio_wb32(pb, avctx->color_range);
+        avio_wb32(pb, avctx->color_primaries);
+        avio_wb32(pb, avctx->color_trc);
+        avio_wb32(pb, avctx->colorspace);
+        avio_wb32(pb, avctx->chroma_sample_location);
+        avio_wb32(pb, avctx->sample_rate);
+        avio_wb32(pb, avctx->channels);
+        avio_wb64(pb, avctx->channel_layout);
+        avio_wb32(pb, avctx->sample_fmt);
+        avio_wb32(pb, avctx->frame_size);
+        avio_wb32(pb, avctx->block_align);
+        avio_wb32(pb, avctx->bits_per_coded_sample);
+        avio_wb32(pb, avctx->bits_per_raw_sample);
+        avio_wb32(pb, avctx->profile);
+        avio_wb32(pb, avctx->level);
+        avio_wb32(pb, avctx->extradata_size);
+        avio_write(pb, avctx->extradata, avctx->extradata_size);
+    }
+}
+
+static int read_params(AVFormatContext *s, GetByteContext *gb)
+{
+    int i, ret;
+
+    s->start_time                 = bytestream2_get_be64(gb);
+    s->duration                   = bytestream2_get_be64(gb);
+    s->bit_rate                   = bytestream2_get_be32(gb);
+    s->duration_estimation_method = bytestream2_get_be32(gb);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecContext *avctx = st->codec;
+        int extradata_size;
+
+        st->r_frame_rate.num         = bytestream2_get_be32(gb);
+        st->r_frame_rate.den         = bytestream2_get_be32(gb);
+        st->avg_frame_rate.num       = bytestream2_get_be32(gb);
+        st->avg_frame_rate.den       = bytestream2_get_be32(gb);
+        st->sample_aspect_ratio.num  = bytestream2_get_be32(gb);
+        st->sample_aspect_ratio.den  = bytestream2_get_be32(gb);
+        st->start_time               = bytestream2_get_be64(gb);
+        st->duration                 = bytestream2_get_be64(gb);
+        st->nb_frames                = bytestream2_get_be64(gb);
+        st->codec_info_nb_frames     = bytestream2_get_be32(gb);
+
+        avctx->codec_type             = bytestream2_get_be32(gb);
+        avctx->codec_id               = bytestream2_get_be32(gb);
+        avctx->codec_tag              = bytestream2_get_be32(gb);
+        avctx->bit_rate               = bytestream2_get_be32(gb);
+        avctx->time_base.num          = bytestream2_get_be32(gb);
+        avctx->time_base.den          = bytestream2_get_be32(gb);
+        avctx->ticks_per_frame        = bytestream2_get_be32(gb);
+        avctx->width                  = bytestream2_get_be32(gb);
+        avctx->height                 = bytestream2_get_be32(gb);
+        avctx->sample_aspect_ratio.num = bytestream2_get_be32(gb);
+        avctx->sample_aspect_ratio.den = bytestream2_get_be32(gb);
+        avctx->pix_fmt                = bytestream2_get_be32(gb);
+        avctx->has_b_frames           = bytestream2_get_be32(gb);
+        avctx->field_order            = bytestream2_get_be32(gb);
+        avctx->color_range            = bytestream2_get_be32(gb);
+        avctx->color_primaries        = bytestream2_get_be32(gb);
+        avctx->color_trc              = bytestream2_get_be32(gb);
+        avctx->colorspace             = bytestream2_get_be32(gb);
+        avctx->chroma_sample_location = bytestream2_get_be32(gb);
+        avctx->sample_rate            = bytestream2_get_be32(gb);
+        avctx->channels               = bytestream2_get_be32(gb);
+        avctx->channel_layout         = bytestream2_get_be64(gb);
+        avctx->sample_fmt             = bytestream2_get_be32(gb);
+        avctx->frame_size             = bytestream2_get_be32(gb);
+        avctx->block_align            = bytestream2_get_be32(gb);
+        avctx->bits_per_coded_sample  = bytestream2_get_be32(gb);
+        avctx->bits_per_raw_sample    = bytestream2_get_be32(gb);
+        avctx->profile                = bytestream2_get_be32(gb);
+        avctx->level                  = bytestream2_get_be32(gb);
+
+        extradata_size = bytestream2_get_be32(gb);
+        if (extradata_size < 0 ||
+            extradata_size > bytestream2_get_bytes_left(gb))
+            return AVERROR_INVALIDDATA;
+        av_freep(&avctx->extradata);
+        avctx->extradata_size = 0;
+        if (extradata_size) {
+            if ((ret = ff_alloc_extradata(avctx, extradata_size)) < 0)
+                return ret;
+            bytestream2_get_bufferu(gb, avctx->extradata, extradata_size);
+        }
+    }
+
+    return 0;
+}
+
+static int read_index(AVFormatContext *s, GetByteContext *gb)
+{
+    int i, j, total = 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        int nb_entries = bytestream2_get_be32(gb);
+
+        if (nb_entries < 0 ||
+            nb_entries > bytestream2_get_bytes_left(gb) / INDEX_ENTRY_SIZE)
+            return AVERROR_INVALIDDATA;
+        total += nb_entries;
+
+        /* merged with the entries added by read_header(), if any */
+        for (j = 0; j < nb_entries; j++) {
+            int64_t pos       = bytestream2_get_be64(gb);
+            int64_t timestamp = bytestream2_get_be64(gb);
+            int size_flags    = bytestream2_get_be32(gb);
+            int min_distance  = bytestream2_get_be32(gb);
+
+            if (ff_add_index_entry(&st->index_entries, &st->nb_index_entries,
+                                   &st->index_entries_allocated_size,
+                                   pos, timestamp, size_flags >> 2,
+                                   min_distance, size_flags & 3) < 0)
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return total;
+}
+
+static int read_file(AVFormatContext *s, const char *path,
+                     uint8_t **buf, int *buf_size)
+{
+    AVIOContext *pb;
+    int64_t size;
+    int ret;
+
+    if ((ret = avio_open2(&pb, path, AVIO_FLAG_READ,
+                          &s->interrupt_callback, NULL)) < 0)
+        return ret;
+
+    size = avio_size(pb);
+    if (size < 0 || size > INT_MAX - FF_INPUT_BUFFER_PADDING_SIZE) {
+        ret = size < 0 ? size : AVERROR_INVALIDDATA;
+        goto end;
+    }
+    if (!(*buf = av_mallocz(size + FF_INPUT_BUFFER_PADDING_SIZE))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avio_read(pb, *buf, size)) != size) {
+        av_freep(buf);
+        ret = ret < 0 ? ret : AVERROR_INVALIDDATA;
+        goto end;
+    }
+    *buf_size = size;
+    ret       = 0;
+
+end:
+    avio_close(pb);
+    return ret;
+}
+
+int ff_probe_cache_check(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    AVIOContext *pb;
+    uint8_t *key, *buf = NULL;
+    int64_t size, mtime;
+    int key_size, buf_size, ret;
+
+    if (!s->probe_cache)
+        return 0;
+    if (get_cache_path(s, &size, &mtime) < 0)
+        return 0;
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+    ret      = write_key(pb, s, size, mtime);
+    key_size = avio_close_dyn_buf(pb, &key);
+    if (ret < 0 || !key) {
+        av_free(key);
+        return ret < 0 ? ret : AVERROR(ENOMEM);
+    }
+    internal->probe_cache_data = key;
+    internal->probe_cache_size = key_size;
+
+    if (read_file(s, internal->probe_cache_path, &buf, &buf_size) < 0)
+        return 0;
+
+    if (buf_size < key_size + 4 || memcmp(buf, key, key_size) ||
+        av_adler32_update(0, buf, buf_size - 4) != AV_RB32(buf + buf_size - 4)) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring stale probe cache %s\n",
+               internal->probe_cache_path);
+        av_free(buf);
+        return 0;
+    }
+    internal->probe_cache_file      = buf;
+    internal->probe_cache_file_size = buf_size;
+    internal->probe_cache_hit       = 1;
+    return 1;
+}
+
+int ff_probe_cache_load(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    AVIOContext *pb;
+    GetByteContext gb;
+    uint8_t *key, *buf = internal->probe_cache_file;
+    int key_size, buf_size = internal->probe_cache_file_size, ret;
+
+    if (internal->probe_cache_loaded)
+        return internal->probe_cache_hit;
+    internal->probe_cache_loaded = 1;
+
+    internal->probe_cache_file = NULL;
+    internal->probe_cache_hit  = 0;
+    internal->probe_cache_nb_index_entries = -1;
+    if (!internal->probe_cache_data) {
+        av_free(buf);
+        return 0;
+    }
+
+    /* Streams of formats without header only appear while probing, they
+     * cannot be recreated from the cache. */
+    if (s->ctx_flags & AVFMTCTX_NOHEADER) {
+        av_freep(&internal->probe_cache_data);
+        av_free(buf);
+        return 0;
+    }
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        goto fail;
+    avio_write(pb, internal->probe_cache_data, internal->probe_cache_size);
+    write_streams(pb, s);
+    key_size = avio_close_dyn_buf(pb, &key);
+    if (!key) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    av_free(internal->probe_cache_data);
+    internal->probe_cache_data = key;
+    internal->probe_cache_size = key_size;
+
+    if (!buf)
+        return 0;
+    /* the checksum was verified by ff_probe_cache_check() */
+    if (buf_size < key_size + 4 || memcmp(buf, key, key_size)) {
+        av_log(s, AV_LOG_VERBOSE, "Ignoring stale probe cache %s\n",
+               internal->probe_cache_path);
+        av_free(buf);
+        return 0;
+    }
+
+    bytestream2_init(&gb, buf + key_size, buf_size - key_size - 4);
+    if ((ret = read_params(s, &gb)) < 0)
+        goto fail;
+    /* keep the key and parameters for updating the index on close */
+    av_freep(&internal->probe_cache_data);
+    internal->probe_cache_data   = buf;
+    internal->probe_cache_size   = key_size + bytestream2_tell(&gb);
+    internal->probe_cache_params = 1;
+
+    if ((ret = read_index(s, &gb)) < 0)
+        return ret;
+    internal->probe_cache_nb_index_entries = ret;
+    internal->probe_cache_hit              = 1;
+
+    av_log(s, AV_LOG_VERBOSE, "Stream parameters loaded from %s\n",
+           internal->probe_cache_path);
+    return 1;
+fail:
+    av_free(buf);
+    return ret;
+}
+
+int ff_probe_cache_store(AVFormatContext *s)
+{
+    AVFormatInternal *internal = s->internal;
+    AVIOContext *pb;
+    uint8_t *buf;
+    char *tmp;
+    int i, size, ret, nb_index_entries = 0;
+
+    if (!internal->probe_cache_data)
+        return 0;
+
+    if (!internal->probe_cache_params) {
+        if ((ret = avio_open_dyn_buf(&pb)) < 0)
+            return ret;
+        avio_write(pb, internal->probe_cache_data, internal->probe_cache_size);
+        write_params(pb, s);
+        size = avio_close_dyn_buf(pb, &buf);
+        if (!buf)
+            return AVERROR(ENOMEM);
+        av_free(internal->probe_cache_data);
+        internal->probe_cache_data   = buf;
+        internal->probe_cache_size   = size;
+        internal->probe_cache_params = 1;
+    }
+
+    for (i = 0; i < s->nb_streams; i++)
+        nb_index_entries += s->streams[i]->nb_index_entries;
+    if (nb_index_entries == internal->probe_cache_nb_index_entries)
+        return 0;
+
+    if ((ret = avio_open_dyn_buf(&pb)) < 0)
+        return ret;
+    avio_write(pb, internal->probe_cache_data, internal->probe_cache_size);
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        int j;
+
+        avio_wb32(pb, st->nb_index_entries);
+        for (j = 0; j < st->nb_index_entries; j++) {
+            AVIndexEntry *e = &st->index_entries[j];
+            avio_wb64(pb, e->pos);
+            avio_wb64(pb, e->timestamp);
+            avio_wb32(pb, e->size << 2 | e->flags);
+            avio_wb32(pb, e->min_distance);
+        }
+    }
+    avio_wb32(pb, 0);
+    size = avio_close_dyn_buf(pb, &buf);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    AV_WB32(buf + size - 4, av_adler32_update(0, buf, size - 4));
+
+    tmp = av_asprintf("%s.%08x", internal->probe_cache_path, av_get_random_seed());
+    if (!tmp) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avio_open2(&pb, tmp, AVIO_FLAG_WRITE,
+                          &s->interrupt_callback, NULL)) < 0)
+        goto end;
+    avio_write(pb, buf, size);
+    avio_flush(pb);
+    ret = pb->error;
+    avio_close(pb);
+    if (ret >= 0 && rename(tmp, internal->probe_cache_path) < 0)
+        ret = AVERROR(errno);
+    if (ret < 0)
+        remove(tmp);
+    else
+        internal->probe_cache_nb_index_entries = nb_index_entries;
+
+end:
+    if (ret < 0)
+        av_log(s, AV_LOG_WARNING, "Could not write probe cache %s: %s\n",
+               internal->probe_cache_path, av_err2str(ret));
+    av_free(tmp);
+    av_free(buf);
+    return ret;
+}
@@ -0,0 +1,221 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Exchange RTP and RTCP packets between two read-write RTP and UDP
+ * contexts on the loopback interface, as RTSP does.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/random_seed.h"
+#include "libavutil/time.h"
+#include "avformat.h"
+#include "rtpproto.h"
+#include "url.h"
+
+#define FLAGS (AVIO_FLAG_READ_WRITE | AVIO_FLAG_NONBLOCK)
+
+static const uint8_t rtp_packet[] = {
+    0x80, 0x60, 0x12, 0x34, 0x00, 0x00, 0x10, 0x00,
+    0xde, 0xad, 0xbe, 0xef, 'f',  'f',  'm',  'p',
+};
+
+static const uint8_t rtcp_packet[] = {
+    0x80, 0xc8, 0x00, 0x06, 0xde, 0xad, 0xbe, 0xef,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x10,
+};
+
+/* wait up to about a second for a datagram */
+static int read_packet(URLContext *h, uint8_t *buf, int size)
+{
+    int i, ret = AVERROR(EAGAIN);
+
+    for (i = 0; i < 1000 && ret == AVERROR(EAGAIN); i++) {
+        ret = ffurl_read(h, buf, size);
+        if (ret == AVERROR(EAGAIN))
+            av_usleep(1000);
+    }
+    return ret;
+}
+
+static int transfer(const char *name, URLContext *src, URLContext *dst,
+                    const uint8_t *pkt, int size)
+{
+    uint8_t buf[1500];
+    int ret;
+
+    if ((ret = ffurl_write(src, pkt, size)) != size) {
+        printf("%s: write failed (%d)\n", name, ret);
+        return 1;
+    }
+    ret = read_packet(dst, buf, sizeof(buf));
+    if (ret != size || memcmp(buf, pkt, size)) {
+        printf("%s: received %d bytes, expected %d\n", name, ret, size);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+/*
+ * Open two contexts sending to each other on random ports, using ports
+ * port and port + 1 for a and port + 2 and port + 3 for b.
+ */
+static int open_pair(const char *proto, const char *options,
+                     URLContext **a, URLContext **b)
+{
+    char url[100];
+    int i, port;
+
+    for (i = 0; i < 10; i++) {
+        port = 20000 + (av_get_random_seed() % 20000 & ~3);
+        snprintf(url, sizeof(url), "%s://127.0.0.1:%d?localport=%d%s",
+                 proto, port + 2, port, options);
+        if (ffurl_open(a, url, FLAGS, NULL, NULL) < 0)
+            continue;
+        snprintf(url, sizeof(url), "%s://127.0.0.1:%d?localport=%d%s",
+                 proto, port, port + 2, options);
+        if (ffurl_open(b, url, FLAGS, NULL, NULL) >= 0)
+            return 0;
+        ffurl_close(*a);
+        *a = NULL;
+    }
+    printf("%s: cannot open the contexts\n", proto);
+    return AVERROR(EIO);
+}
+
+static int test_rtp(void)
+{
+    URLContext *a = NULL, *b = NULL;
+    int ret;
+
+    if (open_pair("rtp", "", &a, &b) < 0)
+        return 1;
+
+    ret = transfer("rtp a->b",  a, b, rtp_packet,  sizeof(rtp_packet))  ||
+          transfer("rtcp a->b", a, b, rtcp_packet, sizeof(rtcp_packet)) ||
+          transfer("rtp b->a",  b, a, rtp_packet,  sizeof(rtp_packet))  ||
+          transfer("rtcp b->a", b, a, rtcp_packet, sizeof(rtcp_packet));
+
+    ffurl_close(a);
+    ffurl_close(b);
+    return ret;
+}
+
+/* like test_rtp(), with the receiving thread of the UDP protocol */
+static int test_udp(void)
+{
+    URLContext *a = NULL, *b = NULL;
+    int ret;
+
+    if (open_pair("udp", "&fifo_size=64", &a, &b) < 0)
+        return 1;
+
+    ret = transfer("udp a->b", a, b, rtp_packet,  sizeof(rtp_packet)) ||
+          transfer("udp b->a", b, a, rtcp_packet, sizeof(rtcp_packet));
+
+    ffurl_close(a);
+    ffurl_close(b);
+    return ret;
+}
+
+#define TX_PACKETS     16
+#define TX_PACKET_SIZE 1000
+#define TX_BITRATE     8000000
+
+/*
+ * Send datagrams through the paced sending thread of the UDP protocol,
+ * with a buffer smaller than a datagram, and check that they arrive in
+ * order and no faster than the bitrate.
+ */
+static int test_udp_tx(void)
+{
+    URLContext *a = NULL, *b = NULL;
+    uint8_t pkt[TX_PACKET_SIZE], buf[1500];
+    char url[200];
+    int64_t start, duration;
+    int i, j, port, ret, err = 1;
+
+    for (i = 0; i < 10 && !a; i++) {
+        port = 20000 + (av_get_random_seed() % 20000 & ~3);
+        snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d",
+                 port, port + 2);
+        if (ffurl_open(&b, url, FLAGS, NULL, NULL) < 0)
+            continue;
+        snprintf(url, sizeof(url), "udp://127.0.0.1:%d?localport=%d"
+                 "&fifo_size=1&bitrate=%d&send_batch=4",
+                 port + 2, port, TX_BITRATE);
+        if (ffurl_open(&a, url, AVIO_FLAG_WRITE, NULL, NULL) < 0) {
+            ffurl_close(b);
+            b = NULL;
+        }
+    }
+    if (!a) {
+        printf("udp tx: cannot open the contexts\n");
+        return 1;
+    }
+
+    start = av_gettime();
+    for (i = 0; i < TX_PACKETS; i++) {
+        memset(pkt, i, sizeof(pkt));
+        if ((ret = ffurl_write(a, pkt, sizeof(pkt))) != sizeof(pkt)) {
+            printf("udp tx: write failed (%d)\n", ret);
+            goto fail;
+        }
+    }
+    for (i = 0; i < TX_PACKETS; i++) {
+        ret = read_packet(b, buf, sizeof(buf));
+        for (j = 0; j < ret && buf[j] == i; j++)
+            ;
+        if (ret != sizeof(pkt) || j != ret) {
+            printf("udp tx: packet %d: received %d bytes\n", i, ret);
+            goto fail;
+        }
+    }
+    duration = av_gettime() - start;
+
+    /* the last datagram is sent (TX_PACKETS - 1) datagrams after the first */
+    if (duration < (TX_PACKETS - 1) * TX_PACKET_SIZE * 8LL * 1000000 / TX_BITRATE) {
+        printf("udp tx: sent faster than the bitrate\n");
+        goto fail;
+    }
+    printf("udp tx: ok\n");
+    err = 0;
+
+fail:
+    ffurl_close(a);
+    ffurl_close(b);
+    return err;
+}
+
+int main(void)
+{
+    int ret;
+
+    av_register_all();
+    avformat_network_init();
+
+    ret = test_rtp() || test_udp() || test_udp_tx();
+
+    avformat_network_deinit();
+    return ret;
+}
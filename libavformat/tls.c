@@ -344,9 +344,21 @@ fail:
     return ret;
 }
 
+/**
+ * Make the TCP connection use the interrupt callback of the TLS context,
+ * which is replaced when the connection is handed to another caller, e.g.
+ * by the HTTP connection pool.
+ */
+static void sync_interrupt_callback(URLContext *h)
+{
+    TLSContext *c = h->priv_data;
+    c->tcp->interrupt_callback = h->interrupt_callback;
+}
+
 static int tls_read(URLContext *h, uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
+    sync_interrupt_callback(h);
     while (1) {
         int ret = TLS_read(c, buf, size);
         if (ret > 0)
@@ -362,6 +374,7 @@ static int tls_read(URLContext *h, uint8_t *buf, int size)
 static int tls_write(URLContext *h, const uint8_t *buf, int size)
 {
     TLSContext *c = h->priv_data;
+    sync_interrupt_callback(h);
     while (1) {
         int ret = TLS_write(c, buf, size);
         if (ret > 0)
@@ -374,9 +387,16 @@ static int tls_write(URLContext *h, const uint8_t *buf, int size)
     return 0;
 }
 
+static int tls_get_file_handle(URLContext *h)
+{
+    TLSContext *c = h->priv_data;
+    return ffurl_get_file_handle(c->tcp);
+}
+
 static int tls_close(URLContext *h)
 {
     TLSContext *c = h->priv_data;
+    sync_interrupt_callback(h);
     TLS_shutdown(c);
     TLS_free(c);
     ffurl_close(c->tcp);
@@ -390,6 +410,7 @@ URLProtocol ff_tls_protocol = {
     .url_read       = tls_read,
     .url_write      = tls_write,
     .url_close      = tls_close,
+    .url_get_file_handle = tls_get_file_handle,
     .priv_data_size = sizeof(TLSContext),
     .flags          = URL_PROTOCOL_FLAG_NETWORK,
     .priv_data_class = &tls_class,
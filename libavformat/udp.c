@@ -25,6 +25,7 @@
  */
 
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg and sendmmsg */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -56,6 +57,17 @@
 #define UDP_TX_BUF_SIZE 32768
 #define UDP_MAX_PKT_SIZE 65536
 
+#if HAVE_PTHREAD_CANCEL && HAVE_RECVMMSG && defined(MSG_WAITFORONE)
+#define UDP_RECV_BATCH 1
+#else
+#define UDP_RECV_BATCH 0
+#endif
+#if HAVE_PTHREAD_CANCEL && HAVE_SENDMMSG
+#define UDP_SEND_BATCH 1
+#else
+#define UDP_SEND_BATCH 0
+#endif
+
 typedef struct {
     const AVClass *class;
     int udp_fd;
@@ -69,7 +81,7 @@ typedef struct {
     int dest_addr_len;
     int is_connected;
 
-    /* Circular Buffer variables for use in UDP receive code */
+    /* Circular Buffer variables for use in UDP receive and paced send code */
     int circular_buffer_size;
     AVFifoBuffer *fifo;
     int circular_buffer_error;
@@ -78,6 +90,8 @@ typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int thread_started;
+    int thread_is_output;   ///< the thread sends the queued datagrams instead of receiving
+    int close_req;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
@@ -85,8 +99,33 @@ typedef struct {
     int packet_size;
     int timeout;
     struct sockaddr_storage local_addr_storage;
+
+    /* batched receiving in the circular buffer thread */
+    int recv_batch;
+#if UDP_RECV_BATCH
+    struct mmsghdr *msgs;
+    struct iovec *iov;
+    uint8_t *batch_buf;
+    uint8_t *control_buf;
+#endif
+    int64_t overrun_count;      ///< datagrams dropped because the circular buffer was full
+    int64_t kernel_drop_count;  ///< datagrams dropped by the kernel, if reported
+
+    /* paced sending in the circular buffer thread */
+    int64_t bitrate;
+    int64_t burst_bits;
+    int send_batch;
+    uint8_t *tx_buf;
+    int tx_buf_size;
+    int *tx_sizes;
+#if UDP_SEND_BATCH
+    struct mmsghdr *tx_msgs;
+    struct iovec *tx_iov;
+#endif
 } UDPContext;
 
+#define UDP_CONTROL_SIZE 64
+
 #define OFFSET(x) offsetof(UDPContext, x)
 #define D AV_OPT_FLAG_DECODING_PARAM
 #define E AV_OPT_FLAG_ENCODING_PARAM
@@ -99,9 +138,15 @@ static const AVOption options[] = {
 {"ttl", "set the time to live value (for multicast only)", OFFSET(ttl), AV_OPT_TYPE_INT, {.i64 = 16}, 0, INT_MAX, E },
 {"connect", "set if connect() should be called on socket", OFFSET(is_connected), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D|E },
 /* TODO 'sources', 'block' option */
-{"fifo_size", "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
+{"fifo_size", "set the UDP circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D|E },
 {"overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, D },
 {"timeout", "set raise error timeout (only in read mode)", OFFSET(timeout), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, D },
+{"recv_batch", "set the maximum number of datagrams read per system call by the circular buffer thread", OFFSET(recv_batch), AV_OPT_TYPE_INT, {.i64 = 32}, 1, 1024, D },
+{"overrun_count", "number of datagrams dropped because the circular buffer was full", OFFSET(overrun_count), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+{"kernel_drop_count", "number of datagrams dropped by the kernel because the socket receive buffer was full", OFFSET(kernel_drop_count), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, D | AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+{"bitrate", "send at this constant rate in bits per second from a separate thread", OFFSET(bitrate), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, E },
+{"burst_bits", "set the number of bits that may be sent ahead of the constant rate", OFFSET(burst_bits), AV_OPT_TYPE_INT64, {.i64 = 0}, 0, INT64_MAX, E },
+{"send_batch", "set the maximum number of datagrams sent per system call by the paced sending thread", OFFSET(send_batch), AV_OPT_TYPE_INT, {.i64 = 32}, 1, 1024, E },
 {NULL}
 };
 
@@ -442,7 +487,105 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if UDP_RECV_BATCH
+static int udp_recv_batch_init(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int i;
+
+    s->msgs        = av_mallocz_array(s->recv_batch, sizeof(*s->msgs));
+    s->iov         = av_mallocz_array(s->recv_batch, sizeof(*s->iov));
+    s->batch_buf   = av_malloc_array(s->recv_batch, UDP_MAX_PKT_SIZE + 4);
+    s->control_buf = av_mallocz_array(s->recv_batch, UDP_CONTROL_SIZE);
+    if (!s->msgs || !s->iov || !s->batch_buf || !s->control_buf)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < s->recv_batch; i++) {
+        s->iov[i].iov_base = s->batch_buf + i * (UDP_MAX_PKT_SIZE + 4) + 4;
+        s->iov[i].iov_len  = UDP_MAX_PKT_SIZE;
+        s->msgs[i].msg_hdr.msg_iov    = &s->iov[i];
+        s->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+#ifdef SO_RXQ_OVFL
+    {
+        /* let the kernel report its drop counter along with the datagrams */
+        int on = 1;
+        if (setsockopt(s->udp_fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+            log_net_error(h, AV_LOG_DEBUG, "setsockopt(SO_RXQ_OVFL)");
+    }
+#endif
+    return 0;
+}
+#endif
+
+static void udp_recv_batch_free(UDPContext *s)
+{
+#if UDP_RECV_BATCH
+    av_freep(&s->msgs);
+    av_freep(&s->iov);
+    av_freep(&s->batch_buf);
+    av_freep(&s->control_buf);
+#endif
+}
+
 #if HAVE_PTHREAD_CANCEL
+/**
+ * Return the buffer of the idx-th datagram read by udp_recv_packets().
+ * It starts with the size of the datagram as 32-bit little endian.
+ */
+static uint8_t *udp_recv_packet_buf(UDPContext *s, int idx)
+{
+#if UDP_RECV_BATCH
+    if (s->msgs)
+        return s->batch_buf + idx * (UDP_MAX_PKT_SIZE + 4);
+#endif
+    return s->tmp;
+}
+
+/**
+ * Read as many datagrams as are available, up to the batch size, but
+ * block until at least one is.
+ * @return the number of datagrams read or a negative value on error
+ */
+static int udp_recv_packets(UDPContext *s)
+{
+    int len;
+
+#if UDP_RECV_BATCH
+    if (s->msgs) {
+        int i, nb_pkts;
+
+        for (i = 0; i < s->recv_batch; i++) {
+            s->msgs[i].msg_hdr.msg_control    = s->control_buf + i * UDP_CONTROL_SIZE;
+            s->msgs[i].msg_hdr.msg_controllen = UDP_CONTROL_SIZE;
+        }
+        nb_pkts = recvmmsg(s->udp_fd, s->msgs, s->recv_batch, MSG_WAITFORONE, NULL);
+        if (nb_pkts < 0)
+            return nb_pkts;
+
+        for (i = 0; i < nb_pkts; i++) {
+            struct msghdr *hdr = &s->msgs[i].msg_hdr;
+#ifdef SO_RXQ_OVFL
+            struct cmsghdr *cmsg;
+
+            for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg))
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+                    s->kernel_drop_count = AV_RN32(CMSG_DATA(cmsg));
+#endif
+            AV_WL32(udp_recv_packet_buf(s, i), s->msgs[i].msg_len);
+        }
+        return nb_pkts;
+    }
+#endif
+
+    len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
+    if (len < 0)
+        return len;
+    AV_WL32(s->tmp, len);
+    return 1;
+}
+
 static void *circular_buffer_task( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -457,40 +600,46 @@ static void *circular_buffer_task( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int i, nb_pkts;
 
         pthread_mutex_unlock(&s->mutex);
         /* Blocking operations are always cancellation points;
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recv(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0);
+        nb_pkts = udp_recv_packets(s);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
+        if (nb_pkts < 0) {
             if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
                 s->circular_buffer_error = ff_neterrno();
                 goto end;
             }
             continue;
         }
-        AV_WL32(s->tmp, len);
 
-        if(av_fifo_space(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+        for (i = 0; i < nb_pkts; i++) {
+            uint8_t *pkt = udp_recv_packet_buf(s, i);
+            int len      = AV_RL32(pkt);
+
+            if(av_fifo_space(s->fifo) < len + 4) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    s->overrun_count++;
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->overrun_count++;
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
             }
+            av_fifo_generic_write(s->fifo, pkt, len+4, NULL);
         }
-        av_fifo_generic_write(s->fifo, s->tmp, len+4, NULL);
         pthread_cond_signal(&s->cond);
     }
 
@@ -499,7 +648,149 @@ end:
     pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
+
+static int udp_send_batch_init(UDPContext *s)
+{
+    s->tx_buf_size = s->send_batch * s->packet_size + UDP_MAX_PKT_SIZE;
+    s->tx_buf      = av_malloc(s->tx_buf_size);
+    s->tx_sizes    = av_malloc_array(s->send_batch, sizeof(*s->tx_sizes));
+    if (!s->tx_buf || !s->tx_sizes)
+        return AVERROR(ENOMEM);
+#if UDP_SEND_BATCH
+    s->tx_msgs = av_mallocz_array(s->send_batch, sizeof(*s->tx_msgs));
+    s->tx_iov  = av_mallocz_array(s->send_batch, sizeof(*s->tx_iov));
+    if (!s->tx_msgs || !s->tx_iov)
+        return AVERROR(ENOMEM);
+#endif
+    return 0;
+}
+
+/**
+ * Send the datagrams staged in tx_buf.
+ * @return 0 on success or a negative network error
+ */
+static int udp_send_packets(UDPContext *s, int nb_pkts)
+{
+    uint8_t *buf = s->tx_buf;
+    int i, ret;
+
+#if UDP_SEND_BATCH
+    for (i = 0; i < nb_pkts; i++) {
+        struct msghdr *hdr = &s->tx_msgs[i].msg_hdr;
+        s->tx_iov[i].iov_base = buf;
+        s->tx_iov[i].iov_len  = s->tx_sizes[i];
+        hdr->msg_iov    = &s->tx_iov[i];
+        hdr->msg_iovlen = 1;
+        if (!s->is_connected) {
+            hdr->msg_name    = &s->dest_addr;
+            hdr->msg_namelen = s->dest_addr_len;
+        }
+        buf += s->tx_sizes[i];
+    }
+    for (i = 0; i < nb_pkts; i += ret) {
+        ret = sendmmsg(s->udp_fd, s->tx_msgs + i, nb_pkts - i, 0);
+        if (ret < 0) {
+            if (ff_neterrno() == AVERROR(EINTR))
+                ret = 0;
+            else
+                return ff_neterrno();
+        }
+    }
+#else
+    for (i = 0; i < nb_pkts; i++) {
+        if (!s->is_connected)
+            ret = sendto(s->udp_fd, buf, s->tx_sizes[i], 0,
+                         (struct sockaddr *) &s->dest_addr,
+                         s->dest_addr_len);
+        else
+            ret = send(s->udp_fd, buf, s->tx_sizes[i], 0);
+        if (ret < 0)
+            return ff_neterrno();
+        buf += s->tx_sizes[i];
+    }
 #endif
+    return 0;
+}
+
+/**
+ * Send the datagrams queued by udp_write() at a constant bitrate.
+ * All datagrams that are due are sent together.
+ */
+static void *circular_buffer_task_tx(void *_URLContext)
+{
+    URLContext *h = _URLContext;
+    UDPContext *s = h->priv_data;
+    int64_t start_time = av_gettime();
+    int64_t sent_bits  = 0;
+    int64_t burst_time = av_rescale(s->burst_bits, 1000000, s->bitrate);
+
+    pthread_mutex_lock(&s->mutex);
+    while (1) {
+        int64_t now, send_time;
+        int nb_pkts = 0, size = 0, ret;
+
+        if (!av_fifo_size(s->fifo)) {
+            if (s->close_req)
+                break;
+            pthread_cond_wait(&s->cond, &s->mutex);
+            /* do not try to catch up after running out of data */
+            now = av_gettime();
+            if (start_time + av_rescale(sent_bits, 1000000, s->bitrate) < now) {
+                start_time = now;
+                sent_bits  = 0;
+            }
+            continue;
+        }
+
+        now       = av_gettime();
+        send_time = start_time + av_rescale(sent_bits, 1000000, s->bitrate);
+        if (send_time > now + burst_time) {
+            pthread_mutex_unlock(&s->mutex);
+            av_usleep(send_time - now - burst_time);
+            pthread_mutex_lock(&s->mutex);
+            continue;
+        }
+
+        /* any datagram fits into the space left at the end of tx_buf */
+        while (nb_pkts < s->send_batch && av_fifo_size(s->fifo) &&
+               size <= s->tx_buf_size - UDP_MAX_PKT_SIZE &&
+               start_time + av_rescale(sent_bits, 1000000, s->bitrate) <= now + burst_time) {
+            uint8_t tmp[4];
+            int len;
+
+            av_fifo_generic_read(s->fifo, tmp, 4, NULL);
+            len = AV_RL32(tmp);
+            av_fifo_generic_read(s->fifo, s->tx_buf + size, len, NULL);
+            s->tx_sizes[nb_pkts++] = len;
+            size      += len;
+            sent_bits += len * 8;
+        }
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+
+        ret = udp_send_packets(s, nb_pkts);
+
+        pthread_mutex_lock(&s->mutex);
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            break;
+        }
+    }
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+#endif
+
+static void udp_send_batch_free(UDPContext *s)
+{
+    av_freep(&s->tx_buf);
+    av_freep(&s->tx_sizes);
+#if UDP_SEND_BATCH
+    av_freep(&s->tx_msgs);
+    av_freep(&s->tx_iov);
+#endif
+}
 
 static int parse_source_list(char *buf, char **sources, int *num_sources,
                              int max_sources)
@@ -587,6 +878,22 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                        "'circular_buffer_size' option was set but it is not supported "
                        "on this build (pthread support is required)\n");
         }
+        if (av_find_info_tag(buf, sizeof(buf), "recv_batch", p)) {
+            s->recv_batch = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            s->bitrate = strtoll(buf, NULL, 10);
+            if (!HAVE_PTHREAD_CANCEL)
+                av_log(h, AV_LOG_WARNING,
+                       "'bitrate' option was set but it is not supported "
+                       "on this build (pthread support is required)\n");
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
+            s->burst_bits = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "send_batch", p)) {
+            s->send_batch = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_strlcpy(localaddr, buf, sizeof(localaddr));
         }
@@ -727,11 +1034,27 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     s->udp_fd = udp_fd;
 
 #if HAVE_PTHREAD_CANCEL
-    if (!is_output && s->circular_buffer_size) {
+    if (s->circular_buffer_size && (!is_output || s->bitrate > 0)) {
         int ret;
 
+        /* udp_write() waits until a whole datagram fits into the buffer */
+        if (is_output && s->circular_buffer_size < UDP_MAX_PKT_SIZE + 4) {
+            s->circular_buffer_size = (UDP_MAX_PKT_SIZE + 4 + 187) / 188 * 188;
+            av_log(h, AV_LOG_WARNING,
+                   "'fifo_size' is too small to hold a datagram, using %d\n",
+                   s->circular_buffer_size / 188);
+        }
+
         /* start the task going */
         s->fifo = av_fifo_alloc(s->circular_buffer_size);
+        if (!s->fifo)
+            goto fail;
+#if UDP_RECV_BATCH
+        if (!is_output && s->recv_batch > 1 && udp_recv_batch_init(h) < 0)
+            goto fail;
+#endif
+        if (is_output && udp_send_batch_init(s) < 0)
+            goto fail;
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -742,7 +1065,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             av_log(h, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", strerror(ret));
             goto cond_fail;
         }
-        ret = pthread_create(&s->circular_buffer_thread, NULL, circular_buffer_task, h);
+        s->thread_is_output = is_output;
+        ret = pthread_create(&s->circular_buffer_thread, NULL,
+                             is_output ? circular_buffer_task_tx : circular_buffer_task, h);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed : %s\n", strerror(ret));
             goto thread_fail;
@@ -762,6 +1087,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_free(s->fifo);
+    s->fifo = NULL;
+    udp_recv_batch_free(s);
+    udp_send_batch_free(s);
     for (i = 0; i < num_include_sources; i++)
         av_freep(&include_sources[i]);
     for (i = 0; i < num_exclude_sources; i++)
@@ -776,7 +1104,7 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     int avail, nonblock = h->flags & AVIO_FLAG_NONBLOCK;
 
 #if HAVE_PTHREAD_CANCEL
-    if (s->fifo) {
+    if (s->fifo && !s->thread_is_output) {
         pthread_mutex_lock(&s->mutex);
         do {
             avail = av_fifo_size(s->fifo);
@@ -833,6 +1161,36 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
 
+#if HAVE_PTHREAD_CANCEL
+    if (s->fifo && s->thread_is_output) {
+        uint8_t tmp[4];
+
+        if (size > UDP_MAX_PKT_SIZE)
+            return AVERROR(EINVAL);
+
+        pthread_mutex_lock(&s->mutex);
+        /* the sending thread returns space as it sends */
+        while (!s->circular_buffer_error && av_fifo_space(s->fifo) < size + 4) {
+            if (h->flags & AVIO_FLAG_NONBLOCK) {
+                pthread_mutex_unlock(&s->mutex);
+                return AVERROR(EAGAIN);
+            }
+            pthread_cond_wait(&s->cond, &s->mutex);
+        }
+        if (s->circular_buffer_error) {
+            int err = s->circular_buffer_error;
+            pthread_mutex_unlock(&s->mutex);
+            return err;
+        }
+        AV_WL32(tmp, size);
+        av_fifo_generic_write(s->fifo, tmp, 4, NULL);
+        av_fifo_generic_write(s->fifo, (uint8_t *)buf, size, NULL);
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        return size;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
@@ -854,20 +1212,36 @@ static int udp_close(URLContext *h)
     UDPContext *s = h->priv_data;
     int ret;
 
+#if HAVE_PTHREAD_CANCEL
+    /* let the sending thread flush the queued datagrams */
+    if (s->thread_started && s->thread_is_output) {
+        pthread_mutex_lock(&s->mutex);
+        s->close_req = 1;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        ret = pthread_join(s->circular_buffer_thread, NULL);
+        if (ret != 0)
+            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+    }
+#endif
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr,(struct sockaddr *)&s->local_addr_storage);
     closesocket(s->udp_fd);
 #if HAVE_PTHREAD_CANCEL
     if (s->thread_started) {
-        pthread_cancel(s->circular_buffer_thread);
-        ret = pthread_join(s->circular_buffer_thread, NULL);
-        if (ret != 0)
-            av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+        if (!s->thread_is_output) {
+            pthread_cancel(s->circular_buffer_thread);
+            ret = pthread_join(s->circular_buffer_thread, NULL);
+            if (ret != 0)
+                av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", strerror(ret));
+        }
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
     }
 #endif
     av_fifo_free(s->fifo);
+    udp_recv_batch_free(s);
+    udp_send_batch_free(s);
     return 0;
 }
 
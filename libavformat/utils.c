@@ -26,8 +26,13 @@
 
 #include "config.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/cpu.h"
 #include "libavutil/dict.h"
 #include "libavutil/internal.h"
 #include "libavutil/mathematics.h"
@@ -44,6 +49,7 @@
 #include "audiointerleave.h"
 #include "avformat.h"
 #include "avio_internal.h"
+#include "http.h"
 #include "id3v2.h"
 #include "internal.h"
 #include "metadata.h"
@@ -218,6 +224,16 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     pkt->size = 0;
     pkt->pos  = avio_tell(s);
 
+    /* hand out the buffered data directly if possible, sizes from broken
+     * files are limited by the chunked reading below */
+    if (size <= SANE_CHUNK_SIZE / 10 && (pkt->buf = ffio_read_ref(s, size))) {
+        pkt->data = pkt->buf->data;
+        pkt->size = pkt->buf->size;
+        if (pkt->size < size)
+            pkt->flags |= AV_PKT_FLAG_CORRUPT;
+        return pkt->size;
+    }
+
     return append_packet_chunked(s, pkt, size);
 }
 
@@ -545,6 +561,13 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
     if ((ret = init_input(s, filename, &tmp)) < 0)
         goto fail;
     s->probe_score = ret;
+
+    if (s->pb && (s->flags & AVFMT_FLAG_ZERO_COPY) &&
+        (s->iformat->flags & AVFMT_ZERO_COPY) &&
+        !(s->flags & AVFMT_FLAG_CUSTOM_IO))
+        if ((ret = ffio_enable_buffer_ref(s->pb)) < 0)
+            goto fail;
+
     avio_skip(s->pb, s->skip_initial_bytes);
 
     /* Check filename in case an image number is expected. */
@@ -576,9 +599,12 @@ int avformat_open_input(AVFormatContext **ps, const char *filename,
     if (s->pb)
         ff_id3v2_read(s, ID3v2_DEFAULT_MAGIC, &id3v2_extra_meta, 0);
 
-    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header)
+    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header) {
+        ff_probe_cache_check(s);
         if ((ret = s->iformat->read_header(s)) < 0)
             goto fail;
+        ff_probe_cache_load(s);
+    }
 
     if (id3v2_extra_meta) {
         if (!strcmp(s->iformat->name, "mp3") || !strcmp(s->iformat->name, "aac") ||
@@ -2636,18 +2662,13 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
     return 1;
 }
 
-/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
-static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
-                            AVDictionary **options)
+/* Open the decoder used to analyze st if this has not been tried yet.
+ * returns 0 if a decoder is available, a negative error otherwise */
+static int open_info_decoder(AVFormatContext *s, AVStream *st,
+                             AVDictionary **options)
 {
     const AVCodec *codec;
-    int got_picture = 1, ret = 0;
-    AVFrame *frame = av_frame_alloc();
-    AVSubtitle subtitle;
-    AVPacket pkt = *avpkt;
-
-    if (!frame)
-        return AVERROR(ENOMEM);
+    int ret;
 
     if (!avcodec_is_open(st->codec) &&
         st->info->found_decoder <= 0 &&
@@ -2658,8 +2679,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
 
         if (!codec) {
             st->info->found_decoder = -st->codec->codec_id;
-            ret                     = -1;
-            goto fail;
+            return -1;
         }
 
         /* Force thread count to 1 since the H.264 decoder will not extract
@@ -2670,16 +2690,29 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
             av_dict_free(&thread_opt);
         if (ret < 0) {
             st->info->found_decoder = -st->codec->codec_id;
-            goto fail;
+            return ret;
         }
         st->info->found_decoder = 1;
     } else if (!st->info->found_decoder)
         st->info->found_decoder = 1;
 
-    if (st->info->found_decoder < 0) {
-        ret = -1;
+    return st->info->found_decoder < 0 ? -1 : 0;
+}
+
+/* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
+                            AVDictionary **options)
+{
+    int got_picture = 1, ret = 0;
+    AVFrame *frame = av_frame_alloc();
+    AVSubtitle subtitle;
+    AVPacket pkt = *avpkt;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    if ((ret = open_info_decoder(s, st, options)) < 0)
         goto fail;
-    }
 
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
@@ -3040,6 +3073,232 @@ void ff_rfps_calculate(AVFormatContext *ic)
     }
 }
 
+static void update_found_stats(AVFormatContext *ic, int64_t start)
+{
+    int i;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        if (st->info->found_time == AV_NOPTS_VALUE &&
+            has_codec_parameters(st, NULL)) {
+            st->info->found_time      = av_gettime() - start;
+            st->info->found_bytes     = st->info->codec_info_bytes;
+            st->info->found_nb_frames = st->codec_info_nb_frames;
+        }
+    }
+}
+
+#if HAVE_PTHREADS
+#define MAX_INFO_THREADS 16
+
+typedef struct InfoDecodeJob {
+    AVPacket pkt;
+    int nb_frames;              ///< codec_info_nb_frames when pkt was read
+} InfoDecodeJob;
+
+/**
+ * Decodes the packets read by avformat_find_stream_info() on a pool of
+ * threads. Packets are collected in batches holding at most one packet per
+ * stream; a batch is decoded while the demuxing thread waits, so that
+ * every codec context is only ever accessed by one thread at a time.
+ */
+typedef struct InfoThreadContext {
+    AVFormatContext *ic;
+    AVDictionary **options;
+    int orig_nb_streams;
+
+    InfoDecodeJob *jobs;
+    int jobs_size;
+    int nb_queued;              ///< packets collected by the demuxing thread
+    int nb_jobs;                ///< packets of the batch being decoded
+    int next_job;
+    int nb_done;
+    int abort_request;
+
+    pthread_t threads[MAX_INFO_THREADS];
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_job;
+    pthread_cond_t cond_done;
+} InfoThreadContext;
+
+static AVDictionary **info_options(InfoThreadContext *c, int stream_index)
+{
+    return c->options && stream_index < c->orig_nb_streams ?
+           &c->options[stream_index] : NULL;
+}
+
+static void *info_decode_task(void *arg)
+{
+    InfoThreadContext *c = arg;
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        InfoDecodeJob *job;
+        AVStream *st;
+        int64_t start;
+
+        while (!c->abort_request && c->next_job >= c->nb_jobs)
+            pthread_cond_wait(&c->cond_job, &c->mutex);
+        if (c->abort_request)
+            break;
+        job = &c->jobs[c->next_job++];
+        pthread_mutex_unlock(&c->mutex);
+
+        st    = c->ic->streams[job->pkt.stream_index];
+        start = av_gettime();
+        /* the demuxing thread has already counted this packet */
+        st->codec_info_nb_frames = job->nb_frames;
+        try_decode_frame(c->ic, st, &job->pkt,
+                         info_options(c, job->pkt.stream_index));
+        st->codec_info_nb_frames++;
+        st->info->decode_time += av_gettime() - start;
+
+        pthread_mutex_lock(&c->mutex);
+        if (++c->nb_done == c->nb_jobs)
+            pthread_cond_signal(&c->cond_done);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+/* Start the decoding threads, on failure packets are decoded by the
+ * calling thread as usual. */
+static void info_threads_init(InfoThreadContext *c, AVFormatContext *ic,
+                              AVDictionary **options, int orig_nb_streams)
+{
+    int i, ret, nb_threads = ic->analyze_threads;
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+    nb_threads = FFMIN(nb_threads, MAX_INFO_THREADS);
+    if (nb_threads <= 1)
+        return;
+
+    c->ic              = ic;
+    c->options         = options;
+    c->orig_nb_streams = orig_nb_streams;
+
+    if ((ret = pthread_mutex_init(&c->mutex, NULL))) {
+        av_log(ic, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", av_err2str(AVERROR(ret)));
+        return;
+    }
+    if ((ret = pthread_cond_init(&c->cond_job, NULL))) {
+        av_log(ic, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(AVERROR(ret)));
+        goto cond_job_fail;
+    }
+    if ((ret = pthread_cond_init(&c->cond_done, NULL))) {
+        av_log(ic, AV_LOG_ERROR, "pthread_cond_init failed : %s\n", av_err2str(AVERROR(ret)));
+        goto cond_done_fail;
+    }
+
+    for (i = 0; i < nb_threads; i++) {
+        if ((ret = pthread_create(&c->threads[i], NULL, info_decode_task, c))) {
+            av_log(ic, AV_LOG_WARNING, "pthread_create failed : %s\n", av_err2str(AVERROR(ret)));
+            break;
+        }
+        c->nb_threads++;
+    }
+    if (c->nb_threads)
+        return;
+
+    pthread_cond_destroy(&c->cond_done);
+cond_done_fail:
+    pthread_cond_destroy(&c->cond_job);
+cond_job_fail:
+    pthread_mutex_destroy(&c->mutex);
+}
+
+static void info_threads_uninit(InfoThreadContext *c)
+{
+    int i;
+
+    if (!c->nb_threads)
+        return;
+
+    pthread_mutex_lock(&c->mutex);
+    c->abort_request = 1;
+    pthread_cond_broadcast(&c->cond_job);
+    pthread_mutex_unlock(&c->mutex);
+
+    for (i = 0; i < c->nb_threads; i++)
+        pthread_join(c->threads[i], NULL);
+    c->nb_threads = 0;
+
+    for (i = 0; i < c->nb_queued; i++)
+        av_free_packet(&c->jobs[i].pkt);
+    av_freep(&c->jobs);
+
+    pthread_cond_destroy(&c->cond_done);
+    pthread_cond_destroy(&c->cond_job);
+    pthread_mutex_destroy(&c->mutex);
+}
+
+/* Decode all queued packets and wait until they are done. */
+static void info_decode_queued(InfoThreadContext *c)
+{
+    int i;
+
+    if (!c->nb_queued)
+        return;
+
+    /* avcodec_open2() must not be called concurrently */
+    for (i = 0; i < c->nb_queued; i++) {
+        int stream_index = c->jobs[i].pkt.stream_index;
+        open_info_decoder(c->ic, c->ic->streams[stream_index],
+                          info_options(c, stream_index));
+    }
+
+    pthread_mutex_lock(&c->mutex);
+    c->nb_jobs  = c->nb_queued;
+    c->next_job = 0;
+    c->nb_done  = 0;
+    pthread_cond_broadcast(&c->cond_job);
+    while (c->nb_done < c->nb_jobs)
+        pthread_cond_wait(&c->cond_done, &c->mutex);
+    c->nb_jobs = 0;
+    pthread_mutex_unlock(&c->mutex);
+
+    for (i = 0; i < c->nb_queued; i++)
+        av_free_packet(&c->jobs[i].pkt);
+    c->nb_queued = 0;
+}
+
+/* Queue pkt for decoding, the current batch is decoded first if it
+ * already holds a packet of the same stream. */
+static int info_queue_packet(InfoThreadContext *c, AVPacket *pkt)
+{
+    AVStream *st = c->ic->streams[pkt->stream_index];
+    InfoDecodeJob *job;
+    int i, ret;
+
+    for (i = 0; i < c->nb_queued; i++)
+        if (c->jobs[i].pkt.stream_index == pkt->stream_index) {
+            info_decode_queued(c);
+            break;
+        }
+
+    if (c->nb_queued == c->jobs_size) {
+        int size = FFMAX(2 * c->jobs_size, 8);
+        InfoDecodeJob *jobs = av_realloc_array(c->jobs, size, sizeof(*jobs));
+        if (!jobs)
+            return AVERROR(ENOMEM);
+        c->jobs      = jobs;
+        c->jobs_size = size;
+    }
+
+    job = &c->jobs[c->nb_queued];
+    av_init_packet(&job->pkt);
+    if ((ret = av_packet_ref(&job->pkt, pkt)) < 0)
+        return ret;
+    job->nb_frames = st->codec_info_nb_frames;
+    c->nb_queued++;
+
+    return 0;
+}
+#endif
+
 int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
 {
     int i, count, ret = 0, j;
@@ -3050,11 +3309,22 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     // new streams might appear, no options for those
     int orig_nb_streams = ic->nb_streams;
     int flush_codecs    = ic->probesize > 0;
+    int64_t start       = av_gettime();
+    int cached          = 0;
+#if HAVE_PTHREADS
+    InfoThreadContext tc = { 0 };
+#endif
 
     if (ic->pb)
         av_log(ic, AV_LOG_DEBUG, "Before avformat_find_stream_info() pos: %"PRId64" bytes read:%"PRId64" seeks:%d\n",
                avio_tell(ic->pb), ic->pb->bytes_read, ic->pb->seek_count);
 
+    if (ic->internal->probe_cache_hit) {
+        cached = 1;
+        compute_chapters_end(ic);
+        goto find_stream_info_err;
+    }
+
     for (i = 0; i < ic->nb_streams; i++) {
         const AVCodec *codec;
         AVDictionary *thread_opt = NULL;
@@ -3115,6 +3385,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+#if HAVE_PTHREADS
+    info_threads_init(&tc, ic, options, orig_nb_streams);
+#endif
+
     count     = 0;
     read_size = 0;
     for (;;) {
@@ -3124,6 +3398,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
             break;
         }
 
+        update_found_stats(ic, start);
+
         /* check if one codec still needs to be handled */
         for (i = 0; i < ic->nb_streams; i++) {
             int fps_analyze_framecount = 20;
@@ -3209,6 +3485,7 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         st = ic->streams[pkt->stream_index];
         if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
             read_size += pkt->size;
+        st->info->codec_info_bytes += pkt->size;
 
         if (pkt->dts != AV_NOPTS_VALUE && st->codec_info_nb_frames > 1) {
             /* check for non-increasing dts */
@@ -3279,8 +3556,10 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         if (st->parser && st->parser->parser->split && !st->codec->extradata) {
             int i = st->parser->parser->split(st->codec, pkt->data, pkt->size);
             if (i > 0 && i < FF_MAX_EXTRADATA_SIZE) {
-                if (ff_alloc_extradata(st->codec, i))
-                    return AVERROR(ENOMEM);
+                if (ff_alloc_extradata(st->codec, i)) {
+                    ret = AVERROR(ENOMEM);
+                    goto find_stream_info_err;
+                }
                 memcpy(st->codec->extradata, pkt->data,
                        st->codec->extradata_size);
             }
@@ -3295,13 +3574,29 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+#if HAVE_PTHREADS
+        if (tc.nb_threads) {
+            if ((ret = info_queue_packet(&tc, pkt)) < 0)
+                goto find_stream_info_err;
+        } else
+#endif
+        {
+            int64_t t = av_gettime();
+            try_decode_frame(ic, st, pkt,
+                             (options && pkt->stream_index < orig_nb_streams) ?
+                             &options[pkt->stream_index] : NULL);
+            st->info->decode_time += av_gettime() - t;
+        }
 
         st->codec_info_nb_frames++;
         count++;
     }
 
+#if HAVE_PTHREADS
+    if (tc.nb_threads)
+        info_decode_queued(&tc);
+#endif
+
     if (flush_codecs) {
         AVPacket empty_pkt = { 0 };
         int err = 0;
@@ -3433,10 +3728,30 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     }
 
     compute_chapters_end(ic);
+    update_found_stats(ic, start);
+    ff_probe_cache_store(ic);
 
 find_stream_info_err:
+#if HAVE_PTHREADS
+    info_threads_uninit(&tc);
+#endif
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
+        if (st->info && !cached) {
+            av_log(ic, AV_LOG_VERBOSE,
+                   "Stream #%d: %d packets (%"PRId64" bytes) analyzed, "
+                   "%"PRId64" us spent decoding, ",
+                   i, st->codec_info_nb_frames, st->info->codec_info_bytes,
+                   st->info->decode_time);
+            if (st->info->found_time != AV_NOPTS_VALUE)
+                av_log(ic, AV_LOG_VERBOSE,
+                       "parameters found after %d packets (%"PRId64" bytes) "
+                       "and %"PRId64" us\n",
+                       st->info->found_nb_frames, st->info->found_bytes,
+                       st->info->found_time);
+            else
+                av_log(ic, AV_LOG_VERBOSE, "parameters not found\n");
+        }
         if (ic->streams[i]->codec->codec_type != AVMEDIA_TYPE_AUDIO)
             ic->streams[i]->codec->thread_count = 0;
         if (st->info)
@@ -3583,6 +3898,10 @@ void avformat_free_context(AVFormatContext *s)
     if (!s)
         return;
 
+    /* av_write_trailer() frees the private data after calling deinit */
+    if (s->oformat && s->oformat->deinit && s->priv_data)
+        s->oformat->deinit(s);
+
     av_opt_free(s);
     if (s->iformat && s->iformat->priv_class && s->priv_data)
         av_opt_free(s->priv_data);
@@ -3606,6 +3925,11 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_freep(&s->streams);
+    if (s->internal) {
+        av_freep(&s->internal->probe_cache_path);
+        av_freep(&s->internal->probe_cache_data);
+        av_freep(&s->internal->probe_cache_file);
+    }
     av_freep(&s->internal);
     av_free(s);
 }
@@ -3634,6 +3958,8 @@ void avformat_close_input(AVFormatContext **ps)
 
     flush_packet_queue(s);
 
+    ff_probe_cache_store(s);
+
     if (s->iformat)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
@@ -3675,7 +4001,8 @@ AVStream *avformat_new_stream(AVFormatContext *s, const AVCodec *c)
         av_free(st);
         return NULL;
     }
-    st->info->last_dts = AV_NOPTS_VALUE;
+    st->info->last_dts   = AV_NOPTS_VALUE;
+    st->info->found_time = AV_NOPTS_VALUE;
 
     st->codec = avcodec_alloc_context3(c);
     if (s->iformat)
@@ -4377,6 +4704,9 @@ int avformat_network_init(void)
 int avformat_network_deinit(void)
 {
 #if CONFIG_NETWORK
+#if CONFIG_HTTP_PROTOCOL || CONFIG_HTTPS_PROTOCOL
+    ff_http_close_idle_connections();
+#endif
     ff_network_close();
     ff_tls_deinit();
 #endif
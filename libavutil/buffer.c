@@ -203,7 +203,16 @@ int av_buffer_realloc(AVBufferRef **pbuf, int size)
     return 0;
 }
 
-AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
+#if HAVE_PTHREADS
+/* one thread-specific key for the caches of all pools */
+static pthread_mutex_t cache_key_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t cache_key;
+static int cache_key_state;     /* 0: not created yet, 1: created, -1: failed */
+static uint64_t next_pool_id;
+#endif
+
+AVBufferPool *av_buffer_pool_init2(int size, AVBufferRef* (*alloc)(int size),
+                                   int flags)
 {
     AVBufferPool *pool = av_mallocz(sizeof(*pool));
     if (!pool)
@@ -212,23 +221,54 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+#if HAVE_PTHREADS
+    if (flags & AV_BUFFER_POOL_FLAG_THREAD_CACHE) {
+        pthread_mutex_lock(&cache_key_lock);
+        if (!cache_key_state)
+            cache_key_state = pthread_key_create(&cache_key, av_free) ? -1 : 1;
+        /* do without caches if no key is left */
+        pool->use_caches = cache_key_state > 0;
+        pool->id         = ++next_pool_id;
+        pthread_mutex_unlock(&cache_key_lock);
+    }
+#endif
+
     avpriv_atomic_int_set(&pool->refcount, 1);
 
     return pool;
 }
 
+AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
+{
+    return av_buffer_pool_init2(size, alloc, 0);
+}
+
+static void free_entries(BufferPoolEntry *buf)
+{
+    while (buf) {
+        BufferPoolEntry *next = buf->next;
+
+        buf->free(buf->opaque, buf->data);
+        av_free(buf);
+        buf = next;
+    }
+}
+
 /*
  * This function gets called when the pool has been uninited and
  * all the buffers returned to it.
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
+    BufferPoolCache *cache = pool->caches;
 
-        buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+    free_entries(pool->pool);
+    while (cache) {
+        BufferPoolCache *next = cache->c.next;
+
+        free_entries(cache->c.list);
+        av_free(cache);
+        cache = next;
     }
     av_freep(&pool);
 }
@@ -246,14 +286,14 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
-/* remove the whole buffer list from the pool and return it */
-static BufferPoolEntry *get_pool(AVBufferPool *pool)
+/* remove the whole buffer list from a list head and return it */
+static BufferPoolEntry *get_list(BufferPoolEntry * volatile *list)
 {
-    BufferPoolEntry *cur = *(void * volatile *)&pool->pool, *last = NULL;
+    BufferPoolEntry *cur = *(void * volatile *)list, *last = NULL;
 
     while (cur != last) {
         last = cur;
-        cur = avpriv_atomic_ptr_cas((void * volatile *)&pool->pool, last, NULL);
+        cur = avpriv_atomic_ptr_cas((void * volatile *)list, last, NULL);
         if (!cur)
             return NULL;
     }
@@ -261,36 +301,116 @@ static BufferPoolEntry *get_pool(AVBufferPool *pool)
     return cur;
 }
 
-static void add_to_pool(BufferPoolEntry *buf)
+static void add_to_list(BufferPoolEntry * volatile *list, BufferPoolEntry *buf)
 {
-    AVBufferPool *pool;
     BufferPoolEntry *cur, *end = buf;
 
     if (!buf)
         return;
-    pool = buf->pool;
 
     while (end->next)
         end = end->next;
 
-    while (avpriv_atomic_ptr_cas((void * volatile *)&pool->pool, NULL, buf)) {
-        /* pool is not empty, retrieve it and append it to our list */
-        cur = get_pool(pool);
+    while (avpriv_atomic_ptr_cas((void * volatile *)list, NULL, buf)) {
+        /* list is not empty, retrieve it and append it to ours */
+        cur = get_list(list);
         end->next = cur;
         while (end->next)
             end = end->next;
     }
 }
 
+/* remove the first entry of a list, returning the rest to it */
+static BufferPoolEntry *take_entry(BufferPoolEntry * volatile *list)
+{
+    BufferPoolEntry *buf = get_list(list);
+
+    if (buf) {
+        add_to_list(list, buf->next);
+        buf->next = NULL;
+    }
+    return buf;
+}
+
+/*
+ * Return the cache of the calling thread, creating it if create is set.
+ * The caches are only freed with the pool, so a thread that exits leaves
+ * at most BUFFER_POOL_CACHE_SIZE buffers unused until then, or until a new
+ * thread with the same ID takes its cache over.
+ */
+static BufferPoolCache *get_cache(AVBufferPool *pool, int create)
+{
+#if HAVE_PTHREADS
+    BufferPoolThreadCaches *tc;
+    BufferPoolCache *cache, *head;
+    pthread_t self;
+    int i;
+
+    if (!pool->use_caches)
+        return NULL;
+
+    tc = pthread_getspecific(cache_key);
+    if (!tc) {
+        tc = av_mallocz(sizeof(*tc));
+        if (!tc)
+            return NULL;
+        if (pthread_setspecific(cache_key, tc)) {
+            av_free(tc);
+            return NULL;
+        }
+    }
+    for (i = 0; i < BUFFER_POOL_THREAD_CACHES; i++)
+        if (tc->entries[i].pool == pool && tc->entries[i].id == pool->id)
+            break;
+    if (i < BUFFER_POOL_THREAD_CACHES && (tc->entries[i].cache || !create))
+        return tc->entries[i].cache;
+
+    self = pthread_self();
+    for (cache = pool->caches; cache; cache = cache->c.next)
+        if (pthread_equal(cache->c.owner, self))
+            break;
+    if (!cache && create && (cache = av_mallocz(sizeof(*cache)))) {
+        cache->c.owner = self;
+        do {
+            head = pool->caches;
+            cache->c.next = head;
+        } while (avpriv_atomic_ptr_cas((void * volatile *)&pool->caches,
+                                       head, cache) != head);
+    }
+
+    if (i == BUFFER_POOL_THREAD_CACHES)
+        i = tc->next++ % BUFFER_POOL_THREAD_CACHES;
+    tc->entries[i].pool  = pool;
+    tc->entries[i].id    = pool->id;
+    tc->entries[i].cache = cache;
+    return cache;
+#else
+    return NULL;
+#endif
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
+    /* threads that never take buffers from the pool return them directly */
+    BufferPoolCache *cache = get_cache(pool, 0);
 
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    add_to_pool(buf);
+    if (cache) {
+        buf->next     = cache->c.list;
+        cache->c.list = buf;
+        /* move the cached entries to the shared list in one go */
+        if (++cache->c.nb_entries > BUFFER_POOL_CACHE_SIZE) {
+            add_to_list(&pool->pool, cache->c.list);
+            cache->c.list       = NULL;
+            cache->c.nb_entries = 0;
+        }
+    } else {
+        add_to_list(&pool->pool, buf);
+    }
     if (!avpriv_atomic_int_add_and_fetch(&pool->refcount, -1))
         buffer_pool_free(pool);
 }
@@ -329,30 +449,210 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
     AVBufferRef *ret;
-    BufferPoolEntry *buf;
+    BufferPoolEntry *buf = NULL;
+    BufferPoolCache *cache = get_cache(pool, 1);
+
+    if (cache && cache->c.list) {
+        buf           = cache->c.list;
+        cache->c.list = buf->next;
+        cache->c.nb_entries--;
+        buf->next     = NULL;
+    }
 
     /* check whether the pool is empty */
-    buf = get_pool(pool);
-    if (!buf && pool->refcount <= pool->nb_allocated) {
+    if (!buf)
+        buf = take_entry(&pool->pool);
+    /* free buffers may be held in the caches of other threads, so only wait
+     * for them to be returned when there are no caches */
+    if (!buf && !pool->caches && pool->refcount <= pool->nb_allocated) {
         av_log(NULL, AV_LOG_DEBUG, "Pool race dectected, spining to avoid overallocation and eventual OOM\n");
         while (!buf && avpriv_atomic_int_get(&pool->refcount) <= avpriv_atomic_int_get(&pool->nb_allocated))
-            buf = get_pool(pool);
+            buf = take_entry(&pool->pool);
     }
 
     if (!buf)
         return pool_alloc_buffer(pool);
 
-    /* keep the first entry, return the rest of the list to the pool */
-    add_to_pool(buf->next);
-    buf->next = NULL;
-
     ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
                            buf, 0);
     if (!ret) {
-        add_to_pool(buf);
+        add_to_list(&pool->pool, buf);
         return NULL;
     }
     avpriv_atomic_int_add_and_fetch(&pool->refcount, 1);
+    avpriv_atomic_int_add_and_fetch(cache ? &cache->c.hits : &pool->hits, 1);
 
     return ret;
 }
+
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats)
+{
+    BufferPoolCache *cache;
+
+    stats->hits   = (unsigned)avpriv_atomic_int_get(&pool->hits);
+    stats->misses = (unsigned)avpriv_atomic_int_get(&pool->nb_allocated);
+    for (cache = pool->caches; cache; cache = cache->c.next)
+        stats->hits += (unsigned)avpriv_atomic_int_get(&cache->c.hits);
+
+    /* the caller holds one reference, each buffer in use one more */
+    stats->bytes_outstanding = (int64_t)pool->size *
+                               (avpriv_atomic_int_get(&pool->refcount) - 1);
+}
+
+#ifdef TEST
+#include "avassert.h"
+
+#define NB_BUFFERS 20
+
+static void test_pool(int flags)
+{
+    AVBufferPool *pool = av_buffer_pool_init2(1024, NULL, flags);
+    AVBufferRef *bufs[NB_BUFFERS];
+    AVBufferPoolStats stats;
+    int i;
+
+    av_assert0(pool);
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_assert0(bufs[i] = av_buffer_pool_get(pool));
+    av_buffer_pool_get_stats(pool, &stats);
+    av_assert0(stats.hits == 0 && stats.misses == NB_BUFFERS);
+    av_assert0(stats.bytes_outstanding == NB_BUFFERS * 1024);
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_buffer_unref(&bufs[i]);
+    av_buffer_pool_get_stats(pool, &stats);
+    av_assert0(stats.bytes_outstanding == 0);
+
+    /* all buffers must be reused, wherever they were returned to */
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_assert0(bufs[i] = av_buffer_pool_get(pool));
+    av_buffer_pool_get_stats(pool, &stats);
+    av_assert0(stats.hits == NB_BUFFERS && stats.misses == NB_BUFFERS);
+
+    /* the pool must outlive its buffers */
+    av_buffer_pool_uninit(&pool);
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_buffer_unref(&bufs[i]);
+}
+
+#if HAVE_PTHREADS
+#define NB_THREADS    4
+#define NB_ITERATIONS 1000
+
+static void *test_pool_thread(void *arg)
+{
+    AVBufferPool *pool = arg;
+    AVBufferRef *bufs[4];
+    int i, j;
+
+    for (i = 0; i < NB_ITERATIONS; i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(bufs); j++)
+            av_assert0(bufs[j] = av_buffer_pool_get(pool));
+        for (j = 0; j < FF_ARRAY_ELEMS(bufs); j++)
+            av_buffer_unref(&bufs[j]);
+    }
+    return NULL;
+}
+
+static void test_pool_threads(int flags)
+{
+    AVBufferPool *pool = av_buffer_pool_init2(1024, NULL, flags);
+    pthread_t threads[NB_THREADS];
+    AVBufferPoolStats stats;
+    int i;
+
+    av_assert0(pool);
+
+    for (i = 0; i < NB_THREADS; i++)
+        av_assert0(!pthread_create(&threads[i], NULL, test_pool_thread, pool));
+    for (i = 0; i < NB_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    av_buffer_pool_get_stats(pool, &stats);
+    av_assert0(stats.hits + stats.misses == NB_THREADS * NB_ITERATIONS * 4);
+    av_assert0(stats.bytes_outstanding == 0);
+
+    av_buffer_pool_uninit(&pool);
+}
+
+static void *test_release_thread(void *arg)
+{
+    AVBufferRef **bufs = arg;
+    int i;
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_buffer_unref(&bufs[i]);
+    return NULL;
+}
+
+/* buffers released by a thread that does not take any must not stay in it */
+static void test_release_other_thread(void)
+{
+    AVBufferPool *pool = av_buffer_pool_init2(1024, NULL,
+                                              AV_BUFFER_POOL_FLAG_THREAD_CACHE);
+    AVBufferRef *bufs[NB_BUFFERS];
+    AVBufferPoolStats stats;
+    pthread_t thread;
+    int i;
+
+    av_assert0(pool);
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_assert0(bufs[i] = av_buffer_pool_get(pool));
+    av_assert0(!pthread_create(&thread, NULL, test_release_thread, bufs));
+    pthread_join(thread, NULL);
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_assert0(bufs[i] = av_buffer_pool_get(pool));
+    av_buffer_pool_get_stats(pool, &stats);
+    av_assert0(stats.hits == NB_BUFFERS && stats.misses == NB_BUFFERS);
+
+    for (i = 0; i < NB_BUFFERS; i++)
+        av_buffer_unref(&bufs[i]);
+    av_buffer_pool_uninit(&pool);
+}
+#endif
+
+/* more pools with caches than a thread keeps track of, and than there are
+ * thread-specific keys */
+static void test_many_pools(void)
+{
+    static AVBufferPool *pools[1100];
+    AVBufferRef *buf;
+    int i, j;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(pools); i++) {
+        av_assert0(pools[i] = av_buffer_pool_init2(16, NULL,
+                                                   AV_BUFFER_POOL_FLAG_THREAD_CACHE));
+        av_assert0(pools[i]->use_caches == HAVE_PTHREADS);
+    }
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < FF_ARRAY_ELEMS(pools); i++) {
+            av_assert0(buf = av_buffer_pool_get(pools[i]));
+            av_buffer_unref(&buf);
+        }
+    }
+    for (i = 0; i < FF_ARRAY_ELEMS(pools); i++) {
+        AVBufferPoolStats stats;
+
+        av_buffer_pool_get_stats(pools[i], &stats);
+        av_assert0(stats.hits == 1 && stats.misses == 1);
+        av_buffer_pool_uninit(&pools[i]);
+    }
+}
+
+int main(void)
+{
+    test_pool(0);
+    test_pool(AV_BUFFER_POOL_FLAG_THREAD_CACHE);
+    test_many_pools();
+#if HAVE_PTHREADS
+    test_pool_threads(0);
+    test_pool_threads(AV_BUFFER_POOL_FLAG_THREAD_CACHE);
+    test_release_other_thread();
+#endif
+
+    return 0;
+}
+#endif
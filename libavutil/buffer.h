@@ -237,6 +237,15 @@ int av_buffer_realloc(AVBufferRef **buf, int size);
  */
 typedef struct AVBufferPool AVBufferPool;
 
+/**
+ * Keep released buffers in per-thread caches, which are returned to the
+ * shared list in batches. This avoids contention when many threads get and
+ * release buffers from the same pool, at the cost of some buffers possibly
+ * staying cached in a thread that no longer uses the pool. Ignored when the
+ * platform has no thread-specific storage.
+ */
+#define AV_BUFFER_POOL_FLAG_THREAD_CACHE (1 << 0)
+
 /**
  * Allocate and initialize a buffer pool.
  *
@@ -248,6 +257,19 @@ typedef struct AVBufferPool AVBufferPool;
  */
 AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size));
 
+/**
+ * Allocate and initialize a buffer pool with the given flags.
+ *
+ * @param size size of each buffer in this pool
+ * @param alloc a function that will be used to allocate new buffers when the
+ * pool is empty. May be NULL, then the default allocator will be used
+ * (av_buffer_alloc()).
+ * @param flags a combination of AV_BUFFER_POOL_FLAG_*
+ * @return newly created buffer pool on success, NULL on error.
+ */
+AVBufferPool *av_buffer_pool_init2(int size, AVBufferRef* (*alloc)(int size),
+                                   int flags);
+
 /**
  * Mark the pool as being available for freeing. It will actually be freed only
  * once all the allocated buffers associated with the pool are released. Thus it
@@ -267,6 +289,22 @@ void av_buffer_pool_uninit(AVBufferPool **pool);
  */
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
 
+/**
+ * Usage statistics of a buffer pool.
+ */
+typedef struct AVBufferPoolStats {
+    uint64_t hits;              ///< number of buffers reused from the pool
+    uint64_t misses;            ///< number of buffers newly allocated
+    int64_t  bytes_outstanding; ///< total size of the buffers currently in use
+} AVBufferPoolStats;
+
+/**
+ * Get the usage statistics of a buffer pool.
+ * The values are only a snapshot when other threads use the pool
+ * concurrently.
+ */
+void av_buffer_pool_get_stats(AVBufferPool *pool, AVBufferPoolStats *stats);
+
 /**
  * @}
  */
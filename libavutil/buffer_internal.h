@@ -21,6 +21,12 @@
 
 #include <stdint.h>
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "buffer.h"
 
 /**
@@ -71,6 +77,52 @@ typedef struct BufferPoolEntry {
     struct BufferPoolEntry * volatile next;
 } BufferPoolEntry;
 
+/**
+ * Number of entries a cache holds before they are moved to the shared list.
+ */
+#define BUFFER_POOL_CACHE_SIZE 8
+
+/**
+ * Cache of the buffers returned by one thread. Only the owning thread
+ * accesses it, except for the hit counter, which is read atomically by
+ * av_buffer_pool_get_stats(). Padded to a cache line so that the caches of
+ * different threads do not share a line.
+ */
+typedef union BufferPoolCache {
+    struct {
+        BufferPoolEntry *list;
+        int nb_entries;
+        volatile int hits;
+        /* next cache of the same pool, for statistics and freeing */
+        union BufferPoolCache *next;
+#if HAVE_PTHREADS
+        pthread_t owner;
+#endif
+    } c;
+    uint8_t padding[64];
+} BufferPoolCache;
+
+/**
+ * Number of pools whose cache a thread finds without searching.
+ */
+#define BUFFER_POOL_THREAD_CACHES 4
+
+/**
+ * Caches of the pools recently used by a thread, stored under a single
+ * thread-specific key for all pools. A pool is identified by its address
+ * and id, as the address may be reused by a later pool, whose cache is
+ * then searched again. A NULL cache means that the thread has none for
+ * the pool.
+ */
+typedef struct BufferPoolThreadCaches {
+    struct {
+        const AVBufferPool *pool;
+        uint64_t id;
+        BufferPoolCache *cache;
+    } entries[BUFFER_POOL_THREAD_CACHES];
+    int next;
+} BufferPoolThreadCaches;
+
 struct AVBufferPool {
     BufferPoolEntry * volatile pool;
 
@@ -87,8 +139,20 @@ struct AVBufferPool {
 
     volatile int nb_allocated;
 
+    /*
+     * Number of buffers reused by threads without a cache. Threads with a
+     * cache count their hits in it, so that they do not contend on this.
+     */
+    volatile int hits;
+
     int size;
     AVBufferRef* (*alloc)(int size);
+
+    int use_caches;
+    /* unique for the process, see BufferPoolThreadCaches */
+    uint64_t id;
+    /* list of all the caches created for this pool */
+    BufferPoolCache * volatile caches;
 };
 
 #endif /* AVUTIL_BUFFER_INTERNAL_H */
@@ -29,6 +29,14 @@
 #include "libavutil/avassert.h"
 #include "swresample_internal.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/* Without pthreads, the filter bank cache is only safe if there are no
+ * threads at all. */
+#define FILTER_BANK_CACHE (HAVE_PTHREADS || !HAVE_THREADS)
+
 
 typedef struct ResampleContext {
     const AVClass *av_class;
@@ -50,6 +58,9 @@ typedef struct ResampleContext {
     enum AVSampleFormat format;
     int felem_size;
     int filter_shift;
+    struct FilterBank *bank;        ///< shared filter bank, NULL if filter_bank is owned
+    int nb_threads;
+    struct ResampleThreads *threads;
 } ResampleContext;
 
 /**
@@ -195,9 +206,175 @@ static int build_filter(ResampleContext *c, void *filter, double factor, int tap
     return 0;
 }
 
+static int build_filter_bank(ResampleContext *c)
+{
+    int phase_count = 1 << c->phase_shift;
+
+    c->filter_bank = av_calloc(c->filter_alloc, (phase_count+1)*c->felem_size);
+    if (!c->filter_bank)
+        return AVERROR(ENOMEM);
+    if (build_filter(c, (void*)c->filter_bank, c->factor, c->filter_length, c->filter_alloc, phase_count, 1<<c->filter_shift, c->filter_type, c->kaiser_beta)) {
+        av_freep(&c->filter_bank);
+        return AVERROR(ENOMEM);
+    }
+    memcpy(c->filter_bank + (c->filter_alloc*phase_count+1)*c->felem_size, c->filter_bank, (c->filter_alloc-1)*c->felem_size);
+    memcpy(c->filter_bank + (c->filter_alloc*phase_count  )*c->felem_size, c->filter_bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
+    return 0;
+}
+
+#if FILTER_BANK_CACHE
+/**
+ * Filter banks are shared by all resamplers using the same parameters,
+ * building them takes much longer than resampling a short stream.
+ * Unused banks are kept for later contexts as long as their total size
+ * stays below MAX_UNUSED_FILTER_BANKS_SIZE, the least recently used ones
+ * are freed first.
+ */
+typedef struct FilterBank {
+    enum AVSampleFormat format;
+    int phase_shift;
+    int filter_length;
+    enum SwrFilterType filter_type;
+    int kaiser_beta;
+    double factor;
+
+    uint8_t *data;
+    int64_t size;
+    int refcount;
+    unsigned last_use;
+} FilterBank;
+
+#define MAX_FILTER_BANKS 32
+#define MAX_UNUSED_FILTER_BANKS_SIZE (16 << 20)
+
+static FilterBank *filter_banks[MAX_FILTER_BANKS];
+static int nb_filter_banks;
+static unsigned filter_bank_clock;
+#if HAVE_PTHREADS
+static pthread_mutex_t filter_bank_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void lock_filter_banks(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&filter_bank_mutex);
+#endif
+}
+
+static void unlock_filter_banks(void)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&filter_bank_mutex);
+#endif
+}
+
+/* Remove the least recently used unused bank from the cache. */
+static int drop_unused_filter_bank(void)
+{
+    int i, lru = -1;
+
+    for (i = 0; i < nb_filter_banks; i++)
+        if (!filter_banks[i]->refcount &&
+            (lru < 0 || filter_banks[i]->last_use < filter_banks[lru]->last_use))
+            lru = i;
+    if (lru < 0)
+        return 0;
+
+    av_freep(&filter_banks[lru]->data);
+    av_freep(&filter_banks[lru]);
+    filter_banks[lru] = filter_banks[--nb_filter_banks];
+    return 1;
+}
+
+static void trim_filter_banks(void)
+{
+    for (;;) {
+        int64_t unused_size = 0;
+        int i;
+
+        for (i = 0; i < nb_filter_banks; i++)
+            if (!filter_banks[i]->refcount)
+                unused_size += filter_banks[i]->size;
+        if (unused_size <= MAX_UNUSED_FILTER_BANKS_SIZE || !drop_unused_filter_bank())
+            break;
+    }
+}
+#endif
+
+static int init_filter_bank(ResampleContext *c)
+{
+#if FILTER_BANK_CACHE
+    FilterBank *bank;
+    int i, ret;
+
+    lock_filter_banks();
+    for (i = 0; i < nb_filter_banks; i++) {
+        bank = filter_banks[i];
+        if (bank->format        == c->format        &&
+            bank->phase_shift   == c->phase_shift   &&
+            bank->filter_length == c->filter_length &&
+            bank->filter_type   == c->filter_type   &&
+            bank->kaiser_beta   == c->kaiser_beta   &&
+            bank->factor        == c->factor) {
+            bank->refcount++;
+            bank->last_use = ++filter_bank_clock;
+            c->filter_bank = bank->data;
+            c->bank        = bank;
+            unlock_filter_banks();
+            return 0;
+        }
+    }
+
+    if ((ret = build_filter_bank(c)) < 0)
+        goto end;
+
+    /* if every cached bank is in use, the new one stays private */
+    if (nb_filter_banks == MAX_FILTER_BANKS && !drop_unused_filter_bank())
+        goto end;
+    if (!(bank = av_mallocz(sizeof(*bank))))
+        goto end;
+    bank->format        = c->format;
+    bank->phase_shift   = c->phase_shift;
+    bank->filter_length = c->filter_length;
+    bank->filter_type   = c->filter_type;
+    bank->kaiser_beta   = c->kaiser_beta;
+    bank->factor        = c->factor;
+    bank->data          = c->filter_bank;
+    bank->size          = (int64_t)c->filter_alloc * ((1 << c->phase_shift) + 1) * c->felem_size;
+    bank->refcount      = 1;
+    bank->last_use      = ++filter_bank_clock;
+    filter_banks[nb_filter_banks++] = bank;
+    c->bank = bank;
+end:
+    unlock_filter_banks();
+    return ret;
+#else
+    return build_filter_bank(c);
+#endif
+}
+
+static void free_filter_bank(ResampleContext *c)
+{
+#if FILTER_BANK_CACHE
+    if (c->bank) {
+        lock_filter_banks();
+        c->bank->refcount--;
+        trim_filter_banks();
+        unlock_filter_banks();
+        c->bank        = NULL;
+        c->filter_bank = NULL;
+        return;
+    }
+#endif
+    av_freep(&c->filter_bank);
+}
+
+static void resample_threads_free(ResampleContext *c);
+static void resample_free(ResampleContext **c);
+
 static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_rate, int filter_size, int phase_shift, int linear,
                                     double cutoff0, enum AVSampleFormat format, enum SwrFilterType filter_type, int kaiser_beta,
-                                    double precision, int cheby){
+                                    double precision, int cheby, int threads){
     double cutoff = cutoff0? cutoff0 : 0.97;
     double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
     int phase_count= 1<<phase_shift;
@@ -205,6 +382,7 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
     if (!c || c->phase_shift != phase_shift || c->linear!=linear || c->factor != factor
            || c->filter_length != FFMAX((int)ceil(filter_size/factor), 1) || c->format != format
            || c->filter_type != filter_type || c->kaiser_beta != kaiser_beta) {
+        resample_free(&c);
         c = av_mallocz(sizeof(*c));
         if (!c)
             return NULL;
@@ -240,17 +418,16 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
         c->factor        = factor;
         c->filter_length = FFMAX((int)ceil(filter_size/factor), 1);
         c->filter_alloc  = FFALIGN(c->filter_length, 8);
-        c->filter_bank   = av_calloc(c->filter_alloc, (phase_count+1)*c->felem_size);
         c->filter_type   = filter_type;
         c->kaiser_beta   = kaiser_beta;
-        if (!c->filter_bank)
+        if (init_filter_bank(c) < 0)
             goto error;
-        if (build_filter(c, (void*)c->filter_bank, factor, c->filter_length, c->filter_alloc, phase_count, 1<<c->filter_shift, filter_type, kaiser_beta))
-            goto error;
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count+1)*c->felem_size, c->filter_bank, (c->filter_alloc-1)*c->felem_size);
-        memcpy(c->filter_bank + (c->filter_alloc*phase_count  )*c->felem_size, c->filter_bank + (c->filter_alloc - 1)*c->felem_size, c->felem_size);
     }
 
+    if (c->nb_threads != threads)
+        resample_threads_free(c);
+    c->nb_threads = threads;
+
     c->compensation_distance= 0;
     if(!av_reduce(&c->src_incr, &c->dst_incr, out_rate, in_rate * (int64_t)phase_count, INT32_MAX/2))
         goto error;
@@ -261,15 +438,15 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
 
     return c;
 error:
-    av_freep(&c->filter_bank);
-    av_free(c);
+    resample_free(&c);
     return NULL;
 }
 
 static void resample_free(ResampleContext **c){
     if(!*c)
         return;
-    av_freep(&(*c)->filter_bank);
+    resample_threads_free(*c);
+    free_filter_bank(*c);
     av_freep(c);
 }
 
@@ -325,35 +502,210 @@ static int set_compensation(ResampleContext *c, int sample_delta, int compensati
 
 #endif // HAVE_MMXEXT_INLINE
 
-static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size, int *consumed){
-    int i, ret= -1;
-    int av_unused mm_flags = av_get_cpu_flags();
-    int need_emms= 0;
-
-    for(i=0; i<dst->ch_count; i++){
+static int resample_channel(ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size,
+                            int *consumed, int i, int update_ctx, int mm_flags, int *need_emms){
+    int ret= -1;
 #if HAVE_MMXEXT_INLINE
 #if HAVE_SSE2_INLINE
-             if(c->format == AV_SAMPLE_FMT_S16P && (mm_flags&AV_CPU_FLAG_SSE2)) ret= swri_resample_int16_sse2 (c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
-        else
+         if(c->format == AV_SAMPLE_FMT_S16P && (mm_flags&AV_CPU_FLAG_SSE2)) ret= swri_resample_int16_sse2 (c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, update_ctx);
+    else
 #endif
-             if(c->format == AV_SAMPLE_FMT_S16P && (mm_flags&AV_CPU_FLAG_MMX2 )){
-                 ret= swri_resample_int16_mmx2 (c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
-                 need_emms= 1;
-             } else
+         if(c->format == AV_SAMPLE_FMT_S16P && (mm_flags&AV_CPU_FLAG_MMX2 )){
+             ret= swri_resample_int16_mmx2 (c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, update_ctx);
+             *need_emms= 1;
+         } else
 #endif
-             if(c->format == AV_SAMPLE_FMT_S16P) ret= swri_resample_int16(c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
-        else if(c->format == AV_SAMPLE_FMT_S32P) ret= swri_resample_int32(c, (int32_t*)dst->ch[i], (const int32_t*)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
+         if(c->format == AV_SAMPLE_FMT_S16P) ret= swri_resample_int16(c, (int16_t*)dst->ch[i], (const int16_t*)src->ch[i], consumed, src_size, dst_size, update_ctx);
+    else if(c->format == AV_SAMPLE_FMT_S32P) ret= swri_resample_int32(c, (int32_t*)dst->ch[i], (const int32_t*)src->ch[i], consumed, src_size, dst_size, update_ctx);
 #if HAVE_SSE_INLINE
-        else if(c->format == AV_SAMPLE_FMT_FLTP && (mm_flags&AV_CPU_FLAG_SSE))
-                                                 ret= swri_resample_float_sse (c, (float*)dst->ch[i], (const float*)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
+    else if(c->format == AV_SAMPLE_FMT_FLTP && (mm_flags&AV_CPU_FLAG_SSE))
+                                             ret= swri_resample_float_sse (c, (float*)dst->ch[i], (const float*)src->ch[i], consumed, src_size, dst_size, update_ctx);
 #endif
-        else if(c->format == AV_SAMPLE_FMT_FLTP) ret= swri_resample_float(c, (float  *)dst->ch[i], (const float  *)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
+    else if(c->format == AV_SAMPLE_FMT_FLTP) ret= swri_resample_float(c, (float  *)dst->ch[i], (const float  *)src->ch[i], consumed, src_size, dst_size, update_ctx);
 #if HAVE_SSE2_INLINE
-        else if(c->format == AV_SAMPLE_FMT_DBLP && (mm_flags&AV_CPU_FLAG_SSE2))
-                                                 ret= swri_resample_double_sse2(c,(double *)dst->ch[i], (const double *)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
+    else if(c->format == AV_SAMPLE_FMT_DBLP && (mm_flags&AV_CPU_FLAG_SSE2))
+                                             ret= swri_resample_double_sse2(c,(double *)dst->ch[i], (const double *)src->ch[i], consumed, src_size, dst_size, update_ctx);
 #endif
-        else if(c->format == AV_SAMPLE_FMT_DBLP) ret= swri_resample_double(c,(double *)dst->ch[i], (const double *)src->ch[i], consumed, src_size, dst_size, i+1==dst->ch_count);
+    else if(c->format == AV_SAMPLE_FMT_DBLP) ret= swri_resample_double(c,(double *)dst->ch[i], (const double *)src->ch[i], consumed, src_size, dst_size, update_ctx);
+    return ret;
+}
+
+#if HAVE_PTHREADS
+#define MAX_RESAMPLE_THREADS 16
+
+/* Below this many filter taps per call, threading costs more than it saves. */
+#define MIN_THREADED_WORK (1 << 15)
+
+/**
+ * Threads resampling the channels of one multiple_resample() call.
+ * All channels but the last are resampled from a copy of the context made
+ * before the call, the calling thread resamples the last one with the real
+ * context, which updates the resampler state.
+ */
+typedef struct ResampleThreads {
+    pthread_t threads[MAX_RESAMPLE_THREADS];
+    int nb_threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_job;
+    pthread_cond_t cond_done;
+    int abort_request;
+
+    ResampleContext ctx;
+    AudioData *dst, *src;
+    int dst_size, src_size;
+    int mm_flags;
+    int nb_channels;
+    int next_channel;
+    int nb_done;
+} ResampleThreads;
+
+/* Resample queued channels until there are none left, called with the
+ * mutex held. */
+static void resample_queued_channels(ResampleThreads *t)
+{
+    while (t->next_channel < t->nb_channels) {
+        int ch = t->next_channel++;
+        int consumed, need_emms = 0;
+
+        pthread_mutex_unlock(&t->mutex);
+        resample_channel(&t->ctx, t->dst, t->dst_size, t->src, t->src_size,
+                         &consumed, ch, 0, t->mm_flags, &need_emms);
+        if (need_emms)
+            emms_c();
+        pthread_mutex_lock(&t->mutex);
+
+        if (++t->nb_done == t->nb_channels)
+            pthread_cond_signal(&t->cond_done);
     }
+}
+
+static void *resample_worker(void *arg)
+{
+    ResampleThreads *t = arg;
+
+    pthread_mutex_lock(&t->mutex);
+    while (!t->abort_request) {
+        resample_queued_channels(t);
+        if (!t->abort_request)
+            pthread_cond_wait(&t->cond_job, &t->mutex);
+    }
+    pthread_mutex_unlock(&t->mutex);
+
+    return NULL;
+}
+
+static int resample_threads_init(ResampleContext *c)
+{
+    ResampleThreads *t = av_mallocz(sizeof(*t));
+    int i, nb_threads = FFMIN(c->nb_threads, MAX_RESAMPLE_THREADS);
+
+    if (!t)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&t->mutex, NULL))
+        goto fail;
+    if (pthread_cond_init(&t->cond_job, NULL))
+        goto cond_job_fail;
+    if (pthread_cond_init(&t->cond_done, NULL))
+        goto cond_done_fail;
+
+    /* the calling thread takes part in the work */
+    for (i = 0; i < nb_threads - 1; i++) {
+        if (pthread_create(&t->threads[i], NULL, resample_worker, t))
+            break;
+        t->nb_threads++;
+    }
+    if (t->nb_threads) {
+        c->threads = t;
+        return 0;
+    }
+
+    pthread_cond_destroy(&t->cond_done);
+cond_done_fail:
+    pthread_cond_destroy(&t->cond_job);
+cond_job_fail:
+    pthread_mutex_destroy(&t->mutex);
+fail:
+    av_free(t);
+    return AVERROR(EINVAL);
+}
+
+static void resample_threads_free(ResampleContext *c)
+{
+    ResampleThreads *t = c->threads;
+    int i;
+
+    if (!t)
+        return;
+
+    pthread_mutex_lock(&t->mutex);
+    t->abort_request = 1;
+    pthread_cond_broadcast(&t->cond_job);
+    pthread_mutex_unlock(&t->mutex);
+
+    for (i = 0; i < t->nb_threads; i++)
+        pthread_join(t->threads[i], NULL);
+
+    pthread_cond_destroy(&t->cond_done);
+    pthread_cond_destroy(&t->cond_job);
+    pthread_mutex_destroy(&t->mutex);
+    av_freep(&c->threads);
+}
+
+static int threaded_resample(ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size,
+                             int *consumed, int mm_flags){
+    ResampleThreads *t = c->threads;
+    int ret, need_emms = 0;
+
+    pthread_mutex_lock(&t->mutex);
+    t->ctx          = *c;
+    t->dst          = dst;
+    t->src          = src;
+    t->dst_size     = dst_size;
+    t->src_size     = src_size;
+    t->mm_flags     = mm_flags;
+    t->nb_channels  = dst->ch_count - 1;
+    t->next_channel = 0;
+    t->nb_done      = 0;
+    pthread_cond_broadcast(&t->cond_job);
+    pthread_mutex_unlock(&t->mutex);
+
+    ret = resample_channel(c, dst, dst_size, src, src_size, consumed,
+                           dst->ch_count - 1, 1, mm_flags, &need_emms);
+    if (need_emms)
+        emms_c();
+
+    pthread_mutex_lock(&t->mutex);
+    resample_queued_channels(t);
+    while (t->nb_done < t->nb_channels)
+        pthread_cond_wait(&t->cond_done, &t->mutex);
+    t->nb_channels = 0;
+    pthread_mutex_unlock(&t->mutex);
+
+    return ret;
+}
+#else
+static void resample_threads_free(ResampleContext *c)
+{
+}
+#endif
+
+static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, AudioData *src, int src_size, int *consumed){
+    int i, ret= -1;
+    int av_unused mm_flags = av_get_cpu_flags();
+    int need_emms= 0;
+
+#if HAVE_PTHREADS
+    if (c->nb_threads > 1 && dst->ch_count > 1 &&
+        (int64_t)dst_size * c->filter_length >= MIN_THREADED_WORK) {
+        if (!c->threads && resample_threads_init(c) < 0)
+            c->nb_threads = 1;
+        if (c->threads)
+            return threaded_resample(c, dst, dst_size, src, src_size, consumed, mm_flags);
+    }
+#endif
+
+    for(i=0; i<dst->ch_count; i++)
+        ret= resample_channel(c, dst, dst_size, src, src_size, consumed, i, i+1==dst->ch_count, mm_flags, &need_emms);
     if(need_emms)
         emms_c();
     return ret;
@@ -23,6 +23,8 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/opt.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
 #include "swresample.h"
 
 #undef time
@@ -219,6 +221,100 @@ static void audiogen(void *data, enum AVSampleFormat sample_fmt,
     }
 }
 
+#define BENCH_CONTEXTS 100
+#define BENCH_SECONDS   10
+#define BENCH_FRAME   1024
+
+static int bench_convert(int channels, int threads, uint8_t **out, uint8_t **in,
+                         int in_samples, int64_t *duration){
+    SwrContext *ctx = swr_alloc_set_opts(NULL, (1ULL << channels) - 1, AV_SAMPLE_FMT_FLTP, 44100,
+                                               (1ULL << channels) - 1, AV_SAMPLE_FMT_FLTP, 48000, 0, NULL);
+    int64_t t;
+    int i, ch, count = 0, ret;
+
+    if (!ctx)
+        return AVERROR(ENOMEM);
+    av_opt_set_int(ctx, "resample_threads", threads, 0);
+    if ((ret = swr_init(ctx)) < 0)
+        goto end;
+
+    t = av_gettime();
+    for (i = 0; i + BENCH_FRAME <= in_samples; i += BENCH_FRAME) {
+        const uint8_t *src[SWR_CH_MAX];
+        uint8_t *dst[SWR_CH_MAX];
+        for (ch = 0; ch < channels; ch++) {
+            src[ch] = in [ch] + i     * sizeof(float);
+            dst[ch] = out[ch] + count * sizeof(float);
+        }
+        if ((ret = swr_convert(ctx, dst, 2 * BENCH_FRAME, src, BENCH_FRAME)) < 0)
+            goto end;
+        count += ret;
+    }
+    *duration = av_gettime() - t;
+    ret = count;
+end:
+    swr_free(&ctx);
+    return ret;
+}
+
+/* Time the creation of short lived contexts, which mostly consists of
+ * building the filter bank, and the conversion of a long stream with one
+ * and with several threads. */
+static int bench(int channels, int threads){
+    uint8_t **in = NULL, **out = NULL, **out2 = NULL;
+    int in_samples = 48000 * BENCH_SECONDS;
+    int64_t t, single, multi;
+    int i, ch, count;
+
+    if (channels < 1 || channels > SWR_CH_MAX) {
+        fprintf(stderr, "Unsupported number of channels %d\n", channels);
+        return 1;
+    }
+
+    t = av_gettime();
+    for (i = 0; i < BENCH_CONTEXTS; i++) {
+        SwrContext *ctx = swr_alloc_set_opts(NULL, (1ULL << channels) - 1, AV_SAMPLE_FMT_FLTP, 44100,
+                                                   (1ULL << channels) - 1, AV_SAMPLE_FMT_FLTP, 48000, 0, NULL);
+        if (!ctx || swr_init(ctx) < 0) {
+            fprintf(stderr, "Failed to init context\n");
+            return 1;
+        }
+        swr_free(&ctx);
+    }
+    fprintf(stderr, "init: %"PRId64" us per context\n", (av_gettime() - t) / BENCH_CONTEXTS);
+
+    if (av_samples_alloc_array_and_samples(&in,  NULL, channels,     in_samples, AV_SAMPLE_FMT_FLTP, 0) < 0 ||
+        av_samples_alloc_array_and_samples(&out, NULL, channels, 2 * in_samples, AV_SAMPLE_FMT_FLTP, 0) < 0 ||
+        av_samples_alloc_array_and_samples(&out2,NULL, channels, 2 * in_samples, AV_SAMPLE_FMT_FLTP, 0) < 0) {
+        fprintf(stderr, "Failed to allocate samples\n");
+        return 1;
+    }
+    for (ch = 0; ch < channels; ch++)
+        for (i = 0; i < in_samples; i++)
+            ((float*)in[ch])[i] = sin(i * (ch + 1) * 2 * M_PI * 100 / 48000) * 0.5;
+
+    count = bench_convert(channels, 1, out, in, in_samples, &single);
+    if (count < 0 || bench_convert(channels, threads, out2, in, in_samples, &multi) != count) {
+        fprintf(stderr, "Conversion failed\n");
+        return 1;
+    }
+    fprintf(stderr, "convert: %d channels, %d s, 1 thread: %"PRId64" us, %d threads: %"PRId64" us\n",
+            channels, BENCH_SECONDS, single, threads, multi);
+    for (ch = 0; ch < channels; ch++)
+        if (memcmp(out[ch], out2[ch], count * sizeof(float))) {
+            fprintf(stderr, "Output of channel %d differs\n", ch);
+            return 1;
+        }
+
+    av_freep(&in[0]);
+    av_freep(&in);
+    av_freep(&out[0]);
+    av_freep(&out);
+    av_freep(&out2[0]);
+    av_freep(&out2);
+    return 0;
+}
+
 int main(int argc, char **argv){
     int in_sample_rate, out_sample_rate, ch ,i, flush_count;
     uint64_t in_ch_layout, out_ch_layout;
@@ -245,9 +341,13 @@ int main(int argc, char **argv){
     if (argc > 1) {
         if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
             av_log(NULL, AV_LOG_INFO, "Usage: swresample-test [<num_tests>[ <test>]]  \n"
+                   "       swresample-test bench [<channels>[ <threads>]]\n"
                    "num_tests           Default is %d\n", num_tests);
             return 0;
         }
+        if (!strcmp(argv[1], "bench"))
+            return bench(argc > 2 ? strtol(argv[2], NULL, 0) : 16,
+                         argc > 3 ? strtol(argv[3], NULL, 0) : 0);
         num_tests = strtol(argv[1], NULL, 0);
         if(num_tests < 0) {
             num_tests = -num_tests;
@@ -341,6 +341,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     const int srcW                   = c->srcW;
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstEnd                 = c->band_h ? c->band_y + c->band_h : dstH;
     const int chrDstW                = c->chrDstW;
     const int chrSrcW                = c->chrSrcW;
     const int lumXInc                = c->lumXInc;
@@ -444,7 +445,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = c->band_y;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -454,7 +455,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     }
     lastDstY = dstY;
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         uint8_t *dest[4]  = {
             dst[0] + dstStride[0] * dstY,
@@ -914,6 +915,51 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
     }
 }
 
+typedef struct ScaleBandArg {
+    const uint8_t *src[4];
+    int srcStride[4];
+    uint8_t *dst[4];
+    int dstStride[4];
+} ScaleBandArg;
+
+static int scale_band(SwsContext *c, void *arg, int jobnr, int nb_jobs)
+{
+    const ScaleBandArg *a = arg;
+    SwsContext *band      = c->slice_ctx[jobnr];
+    const uint8_t *src[4] = { a->src[0], a->src[1], a->src[2], a->src[3] };
+    uint8_t *dst[4]       = { a->dst[0], a->dst[1], a->dst[2], a->dst[3] };
+    int srcStride[4]      = { a->srcStride[0], a->srcStride[1],
+                              a->srcStride[2], a->srcStride[3] };
+    int dstStride[4]      = { a->dstStride[0], a->dstStride[1],
+                              a->dstStride[2], a->dstStride[3] };
+
+    return band->swscale(band, src, srcStride, 0, band->srcH, dst, dstStride);
+}
+
+/**
+ * Scale a whole picture with the slice threads, each of them rendering one
+ * band of the destination from the complete source.
+ */
+static int swscale_threaded(SwsContext *c, const uint8_t *src[],
+                            int srcStride[], uint8_t *dst[], int dstStride[])
+{
+    ScaleBandArg arg;
+    int i;
+
+    memcpy(arg.src,       src,       sizeof(arg.src));
+    memcpy(arg.srcStride, srcStride, sizeof(arg.srcStride));
+    memcpy(arg.dst,       dst,       sizeof(arg.dst));
+    memcpy(arg.dstStride, dstStride, sizeof(arg.dstStride));
+
+    if (usePal(c->srcFormat))
+        for (i = 0; i < c->nb_slice_ctx; i++)
+            memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+
+    c->thread_execute(c, scale_band, &arg, c->nb_slice_ctx);
+
+    return c->dstH;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -1080,8 +1126,11 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
         if (srcSliceY + srcSliceH == c->srcH)
             c->sliceDir = 0;
 
-        ret = c->swscale(c, src2, srcStride2, srcSliceY, srcSliceH, dst2,
-                          dstStride2);
+        if (c->thread_execute && srcSliceY == 0 && srcSliceH == c->srcH)
+            ret = swscale_threaded(c, src2, srcStride2, dst2, dstStride2);
+        else
+            ret = c->swscale(c, src2, srcStride2, srcSliceY, srcSliceH, dst2,
+                             dstStride2);
     } else {
         // slices go from bottom to top => we flip the image internally
         int srcStride2[4] = { -srcStride[0], -srcStride[1], -srcStride[2],
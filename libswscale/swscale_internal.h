@@ -75,6 +75,8 @@ typedef int (*SwsFunc)(struct SwsContext *context, const uint8_t *src[],
                        int srcStride[], int srcSliceY, int srcSliceH,
                        uint8_t *dst[], int dstStride[]);
 
+typedef int (sws_action_func)(struct SwsContext *c, void *arg, int jobnr, int nb_jobs);
+
 /**
  * Write one line of horizontally scaled data to planar output
  * without any additional vertical scaling (or point-scaling).
@@ -604,6 +606,23 @@ typedef struct SwsContext {
     int needs_hcscale; ///< Set if there are chroma planes to be converted.
 
     SwsDither dither;
+
+    /**
+     * @name Slice threading.
+     * The destination picture is split in nb_slice_ctx horizontal bands,
+     * each rendered by its own context from the whole source picture, so
+     * the output is identical to the single threaded one.
+     */
+    //@{
+    int nb_threads;               ///< Number of threads requested by the user, 0 for automatic.
+    struct SwsContext **slice_ctx;///< Contexts rendering the bands of the destination picture.
+    int nb_slice_ctx;
+    int band_y;                   ///< First destination line rendered by this context.
+    int band_h;                   ///< Number of destination lines rendered by this context, 0 for all of them.
+    void *thread;
+    void (*thread_execute)(struct SwsContext *c, sws_action_func *func,
+                           void *arg, int nb_jobs);
+    //@}
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -619,6 +638,9 @@ void updateMMXDitherTables(SwsContext *c, int dstY, int lumBufIndex, int chrBufI
 
 av_cold void ff_sws_init_range_convert(SwsContext *c);
 
+int ff_sws_thread_init(SwsContext *c);
+void ff_sws_thread_free(SwsContext *c);
+
 SwsFunc ff_yuv2rgb_init_x86(SwsContext *c);
 SwsFunc ff_yuv2rgb_init_ppc(SwsContext *c);
 SwsFunc ff_yuv2rgb_init_bfin(SwsContext *c);
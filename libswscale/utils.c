@@ -983,7 +983,12 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
 {
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
-    int need_reinit = 0;
+    int need_reinit = 0, i;
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
+
     memmove(c->srcColorspaceTable, inv_table, sizeof(int) * 4);
     memmove(c->dstColorspaceTable, table, sizeof(int) * 4);
 
@@ -1115,6 +1120,67 @@ SwsContext *sws_alloc_context(void)
     return c;
 }
 
+#if HAVE_THREADS
+static av_cold int init_slice_contexts(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
+{
+    int i, ret, nb_threads, band_h;
+
+    if ((ret = ff_sws_thread_init(c)) <= 1)
+        return FFMIN(ret, 0);
+    nb_threads = ret;
+
+    /* bands start on a chroma line so each one is output exactly once */
+    band_h = FFALIGN((c->dstH + nb_threads - 1) / nb_threads,
+                     1 << c->chrDstVSubSample);
+    nb_threads = (c->dstH + band_h - 1) / band_h;
+    if (nb_threads <= 1) {
+        ff_sws_thread_free(c);
+        return 0;
+    }
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+    c->nb_slice_ctx = nb_threads;
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *s = sws_alloc_context();
+        if (!s)
+            return AVERROR(ENOMEM);
+        c->slice_ctx[i] = s;
+
+        s->srcW          = c->srcW;
+        s->srcH          = c->srcH;
+        s->dstW          = c->dstW;
+        s->dstH          = c->dstH;
+        s->srcFormat     = c->srcFormat;
+        s->dstFormat     = c->dstFormat;
+        s->srcRange      = c->srcRange;
+        s->dstRange      = c->dstRange;
+        s->flags         = c->flags & ~SWS_PRINT_INFO;
+        s->param[0]      = c->param[0];
+        s->param[1]      = c->param[1];
+        s->src_h_chr_pos = c->src_h_chr_pos;
+        s->src_v_chr_pos = c->src_v_chr_pos;
+        s->dst_h_chr_pos = c->dst_h_chr_pos;
+        s->dst_v_chr_pos = c->dst_v_chr_pos;
+        s->dither        = c->dither;
+
+        if ((ret = sws_init_context(s, srcFilter, dstFilter)) < 0)
+            return ret;
+        sws_setColorspaceDetails(s, c->srcColorspaceTable, c->srcRange,
+                                 c->dstColorspaceTable, c->dstRange,
+                                 c->brightness, c->contrast, c->saturation);
+
+        s->band_y = i * band_h;
+        s->band_h = FFMIN(band_h, c->dstH - s->band_y);
+    }
+
+    return 0;
+}
+#endif
+
 av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
 {
@@ -1650,6 +1716,12 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
     }
 
     c->swscale = ff_getSwsFunc(c);
+
+#if HAVE_THREADS
+    /* error diffusion carries state from one line to the next */
+    if (c->nb_threads != 1 && c->dither != SWS_DITHER_ED)
+        return init_slice_contexts(c, srcFilter, dstFilter);
+#endif
     return 0;
 fail: // FIXME replace things by appropriate error codes
     return -1;
@@ -2007,6 +2079,15 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+#if HAVE_THREADS
+    ff_sws_thread_free(c);
+#endif
+    if (c->slice_ctx) {
+        for (i = 0; i < c->nb_slice_ctx; i++)
+            sws_freeContext(c->slice_ctx[i]);
+        av_freep(&c->slice_ctx);
+    }
+
     if (c->lumPixBuf) {
         for (i = 0; i < c->vLumBufSize; i++)
             av_freep(&c->lumPixBuf[i]);
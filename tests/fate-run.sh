@@ -166,6 +166,7 @@ video_filter(){
     filters=$1
     shift
     label=${test#filter-}
+    label=${label%-threads}
     raw_src="${target_path}/tests/vsynth1/%02d.pgm"
     printf '%-20s' $label
     ffmpeg $DEC_OPTS -f image2 -vcodec pgmyuv -i $raw_src \
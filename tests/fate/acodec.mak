@@ -96,6 +96,12 @@ FATE_ACODEC-$(call ENCDEC, FLAC, FLAC) += fate-acodec-flac
 fate-acodec-flac: FMT = flac
 fate-acodec-flac: CODEC = flac -compression_level 2
 
+# the threaded encoder must give the same bitstream as the serial one
+FATE_ACODEC-$(call ENCDEC, FLAC, FLAC) += fate-acodec-flac-8 fate-acodec-flac-thread
+fate-acodec-flac-8: CMD = md5 -i $(SRC) -c:a flac -compression_level 8 -flags +bitexact -f flac
+fate-acodec-flac-thread: CMD = md5 -i $(SRC) -c:a flac -compression_level 8 -threads 2 -thread_type slice -flags +bitexact -f flac
+fate-acodec-flac-thread: REF = $(SRC_PATH)/tests/ref/acodec/flac-8
+
 FATE_ACODEC-$(call ENCDEC, G723_1, G723_1) += fate-acodec-g723_1
 fate-acodec-g723_1: tests/data/asynth-8000-1.wav
 fate-acodec-g723_1: SRC = tests/data/asynth-8000-1.wav
@@ -0,0 +1,19 @@
+OBJDIRS += tests/data/dash
+
+tests/data/dash/out.mpd: TAG = GEN
+tests/data/dash/out.mpd: ffmpeg$(EXESUF) | tests/data/dash
+	$(M)$(TARGET_EXEC) ./$< \
+        -f lavfi -i "testsrc=s=160x120:r=25:d=6" \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=6" \
+        -flags +bitexact -c:v mpeg4 -g 25 -c:a mp2fixed \
+        -f dash -min_seg_duration 2000000 -y $@ 2>/dev/null
+
+DASH_DIR = $(TARGET_PATH)/tests/data/dash
+
+FATE_DASH-$(call ALLYES, DASH_MUXER MOV_DEMUXER CONCAT_PROTOCOL LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER MP2FIXED_ENCODER) += fate-dash-video fate-dash-audio
+fate-dash-video fate-dash-audio: tests/data/dash/out.mpd
+fate-dash-video: CMD = framecrc -i "concat:$(DASH_DIR)/init-stream0.m4s|$(DASH_DIR)/chunk-stream0-00001.m4s|$(DASH_DIR)/chunk-stream0-00002.m4s|$(DASH_DIR)/chunk-stream0-00003.m4s" -c copy
+fate-dash-audio: CMD = framecrc -i "concat:$(DASH_DIR)/init-stream1.m4s|$(DASH_DIR)/chunk-stream1-00001.m4s|$(DASH_DIR)/chunk-stream1-00002.m4s|$(DASH_DIR)/chunk-stream1-00003.m4s" -c copy
+
+FATE_FFMPEG += $(FATE_DASH-yes)
+fate-dash: $(FATE_DASH-yes)
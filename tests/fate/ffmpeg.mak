@@ -21,6 +21,52 @@ fate-ffmpeg-filter_complex: CMD = framecrc -filter_complex color=d=1:r=5
 FATE_FFMPEG-$(CONFIG_COLOR_FILTER) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5
 
+FATE_FFMPEG-$(call ALLYES, TESTSRC_FILTER SPLIT_FILTER SCALE_FILTER HFLIP_FILTER) += fate-ffmpeg-filter_branch_threads
+fate-ffmpeg-filter_branch_threads: CMD = framecrc -filter_branch_threads \
+  -filter_complex "sws_flags=+accurate_rnd+bitexact\;testsrc=s=320x240:d=1:r=5,split=3[a][b][c]\;[a]scale=160:120[o1]\;[b]hflip[o2]\;[c]scale=80:60,hflip[o3]" \
+  -map "[o1]" -map "[o2]" -map "[o3]" -c:v rawvideo
+
+FATE_FFMPEG-$(call ALLYES, TESTSRC_FILTER SPLIT_FILTER SCALE_FILTER SINE_FILTER) += fate-ffmpeg-output_threads
+fate-ffmpeg-output_threads: CMD = framecrc -output_threads \
+  -filter_complex "sws_flags=+accurate_rnd+bitexact\;testsrc=s=160x120:d=2:r=5,split=2[a][b]\;[b]scale=80:60[c]\;sine=d=1:sample_rate=8000[s]" \
+  -map "[a]" -map "[c]" -map "[s]" -c:v rawvideo -c:a pcm_s16le -shortest
+
+# the input changes size and pixel format, which reconfigures the filtergraphs
+# while the output threads encode the frames filtered with the previous ones
+FATE_FFMPEG-$(call ALLYES, CONCAT_PROTOCOL IMAGE2PIPE_DEMUXER PPM_DECODER SCALE_FILTER) += fate-ffmpeg-reinit fate-ffmpeg-reinit-output_threads
+fate-ffmpeg-reinit fate-ffmpeg-reinit-output_threads: $(VREF)
+fate-ffmpeg-reinit: CMD = framecrc $(FFMPEG_REINIT_OPTS)
+fate-ffmpeg-reinit-output_threads: CMD = framecrc -output_threads $(FFMPEG_REINIT_OPTS)
+fate-ffmpeg-reinit-output_threads: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-reinit
+FFMPEG_REINIT_OPTS = -f image2pipe -c:v ppm \
+  -i "concat:$(TARGET_PATH)/tests/vsynth1/01.pgm|$(TARGET_PATH)/tests/vsynth1/02.pgm|$(SRC_PATH)/tests/lena.pnm|$(TARGET_PATH)/tests/vsynth1/03.pgm|$(SRC_PATH)/tests/lena.pnm|$(SRC_PATH)/tests/lena.pnm|$(TARGET_PATH)/tests/vsynth1/04.pgm|$(TARGET_PATH)/tests/vsynth1/05.pgm" \
+  -map 0:v -map 0:v -sws_flags +accurate_rnd+bitexact -s 160x120 -c:v rawvideo
+
+FATE_FFMPEG-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER) += fate-ffmpeg-zerocopy
+fate-ffmpeg-zerocopy: tests/data/asynth-22050-6.wav
+fate-ffmpeg-zerocopy: CMD = framecrc -fflags +zerocopy -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -c copy
+
+FATE_FFMPEG-$(call ALLYES, WAV_DEMUXER PCM_S16LE_DECODER PCM_S16LE_ENCODER) += fate-ffmpeg-zerocopy-seek
+fate-ffmpeg-zerocopy-seek: tests/data/asynth-22050-6.wav
+fate-ffmpeg-zerocopy-seek: CMD = framecrc -fflags +zerocopy -ss 1.5 -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -c:a pcm_s16le
+
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER) += fate-ffmpeg-zerocopy-rawvideo
+fate-ffmpeg-zerocopy-rawvideo: tests/data/vsynth1.yuv
+fate-ffmpeg-zerocopy-rawvideo: CMD = framecrc -fflags +zerocopy -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -c copy
+
+FATE_FFMPEG-$(call ALLYES, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER RAWVIDEO_DECODER MOV_MUXER MOV_DEMUXER RAWVIDEO_MUXER) += fate-ffmpeg-zerocopy-mov
+fate-ffmpeg-zerocopy-mov: tests/data/vsynth1.yuv
+fate-ffmpeg-zerocopy-mov: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt yuv420p" tests/data/vsynth1.yuv mov "-c:v rawvideo -pix_fmt uyvy422" rawvideo "-pix_fmt yuv420p" "" "-fflags +zerocopy"
+fate-ffmpeg-zerocopy-mov: CMP_UNIT = 1
+
+FATE_FFMPEG-$(call ALLYES, ASYNC_PROTOCOL FILE_PROTOCOL WAV_DEMUXER PCM_S16LE_DECODER) += fate-ffmpeg-async
+fate-ffmpeg-async: tests/data/asynth-22050-6.wav
+fate-ffmpeg-async: CMD = framecrc -readahead_size 65536 -i async:$(TARGET_PATH)/tests/data/asynth-22050-6.wav -c copy
+
+FATE_FFMPEG-$(call ALLYES, FIFO_MUXER PIPE_PROTOCOL WAV_DEMUXER PCM_S16LE_DECODER) += fate-ffmpeg-fifo
+fate-ffmpeg-fifo: tests/data/asynth-22050-6.wav
+fate-ffmpeg-fifo: CMD = ffmpeg -i $(TARGET_PATH)/tests/data/asynth-22050-6.wav -map 0 -c copy -flags +bitexact -f fifo -fifo_format framecrc -queue_size 4 -
+
 FATE_FFMPEG-$(CONFIG_RAWVIDEO_DEMUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth2.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -0,0 +1,17 @@
+tests/data/hls-list.m3u8: TAG = GEN
+tests/data/hls-list.m3u8: ffmpeg$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) ./$< \
+        -f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" \
+        -flags +bitexact -c:a mp2fixed -f hls -hls_time 1 -hls_list_size 0 \
+        -y $@ 2>/dev/null
+
+FATE_HLS-$(call ALLYES, HLS_DEMUXER HLS_MUXER MPEGTS_DEMUXER MPEGTS_MUXER LAVFI_INDEV AEVALSRC_FILTER MP2FIXED_ENCODER) += fate-hls-demux
+fate-hls-demux: tests/data/hls-list.m3u8
+fate-hls-demux: CMD = framecrc -i $(TARGET_PATH)/tests/data/hls-list.m3u8 -c copy
+
+FATE_HLS-$(call ALLYES, HLS_DEMUXER HLS_MUXER MPEGTS_DEMUXER MPEGTS_MUXER LAVFI_INDEV AEVALSRC_FILTER MP2FIXED_ENCODER) += fate-hls-prefetch
+fate-hls-prefetch: tests/data/hls-list.m3u8
+fate-hls-prefetch: CMD = framecrc -prefetch_segments 2 -prefetch_size 4096 -i $(TARGET_PATH)/tests/data/hls-list.m3u8 -c copy
+
+FATE_FFMPEG += $(FATE_HLS-yes)
+fate-hls: $(FATE_HLS-yes)
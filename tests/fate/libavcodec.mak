@@ -1,3 +1,9 @@
+FATE_LIBAVCODEC-$(CONFIG_DIRAC_DECODER) += fate-dirac-dwt
+fate-dirac-dwt: libavcodec/dirac_dwt-test$(EXESUF)
+fate-dirac-dwt: CMD = run libavcodec/dirac_dwt-test
+fate-dirac-dwt: CMP = null
+fate-dirac-dwt: REF = /dev/null
+
 FATE_LIBAVCODEC-$(CONFIG_GOLOMB) += fate-golomb
 fate-golomb: libavcodec/golomb-test$(EXESUF)
 fate-golomb: CMD = run libavcodec/golomb-test
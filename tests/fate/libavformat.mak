@@ -1,7 +1,27 @@
+FATE_LIBAVFORMAT-$(call ALLYES, FIFO_MUXER NULL_MUXER) += fate-fifomux
+fate-fifomux: libavformat/fifomux-test$(EXESUF)
+fate-fifomux: CMD = run libavformat/fifomux-test
+
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += fate-httppool
+fate-httppool: libavformat/httppool-test$(EXESUF)
+fate-httppool: CMD = run libavformat/httppool-test
+
+FATE_LIBAVFORMAT-$(filter $(HAVE_PTHREADS), $(CONFIG_HTTPS_PROTOCOL)) += fate-httppool-https
+fate-httppool-https: libavformat/httppool-test$(EXESUF) | tests/data
+fate-httppool-https: CMD = run libavformat/httppool-test $(TARGET_PATH)/tests/data
+
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/noproxy-test$(EXESUF)
 fate-noproxy: CMD = run libavformat/noproxy-test
 
+FATE_LIBAVFORMAT-$(call ALLYES, NUT_MUXER NUT_DEMUXER) += fate-probecache
+fate-probecache: libavformat/probecache-test$(EXESUF) | tests/data
+fate-probecache: CMD = run libavformat/probecache-test $(TARGET_PATH)/tests/data
+
+FATE_LIBAVFORMAT-$(CONFIG_RTP_PROTOCOL) += fate-rtpproto
+fate-rtpproto: libavformat/rtpproto-test$(EXESUF)
+fate-rtpproto: CMD = run libavformat/rtpproto-test
+
 FATE_LIBAVFORMAT-yes += fate-srtp
 fate-srtp: libavformat/srtp-test$(EXESUF)
 fate-srtp: CMD = run libavformat/srtp-test
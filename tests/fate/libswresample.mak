@@ -370,5 +370,14 @@ FATE_SWR_RESAMPLE-$(call FILTERDEMDECENCMUX, ARESAMPLE, WAV, PCM_S16LE, PCM_S16L
 fate-swr-resample: $(FATE_SWR_RESAMPLE-yes)
 FATE_SWR += $(FATE_SWR_RESAMPLE-yes)
 
+# resampling the channels in parallel must give the same output
+FATE_SWR_THREADS-$(call FILTERDEMDECENCMUX, ARESAMPLE, WAV, PCM_S16LE, PCM_S16LE, FRAMECRC) += fate-swr-stereo fate-swr-stereo-threads
+fate-swr-stereo fate-swr-stereo-threads: tests/data/asynth-44100-2.wav
+fate-swr-stereo: CMD = framecrc -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -af aresample=48000 -c:a pcm_s16le
+fate-swr-stereo-threads: CMD = framecrc -i $(TARGET_PATH)/tests/data/asynth-44100-2.wav -af aresample=48000:resample_threads=4 -c:a pcm_s16le
+fate-swr-stereo-threads: REF = $(SRC_PATH)/tests/ref/fate/swr-stereo
+fate-swr-threads: $(FATE_SWR_THREADS-yes)
+FATE_SWR += $(FATE_SWR_THREADS-yes)
+
 FATE_FFMPEG += $(FATE_SWR)
 fate-swr: $(FATE_SWR)
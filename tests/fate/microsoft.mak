@@ -60,6 +60,22 @@ fate-vc1_sa20021: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA20021.vc1
 FATE_VC1-$(CONFIG_MOV_DEMUXER) += fate-vc1-ism
 fate-vc1-ism: CMD = framecrc -i $(TARGET_SAMPLES)/isom/vc1-wmapro.ism -an
 
+# the frame threaded decoder must give the same output
+FATE_VC1-$(CONFIG_VC1_DEMUXER) += fate-vc1_sa00040-threads
+fate-vc1_sa00040-threads: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA00040.vc1
+fate-vc1_sa00040-threads: REF = $(SRC_PATH)/tests/ref/fate/vc1_sa00040
+
+FATE_VC1-$(CONFIG_VC1_DEMUXER) += fate-vc1_sa10091-threads
+fate-vc1_sa10091-threads: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA10091.vc1
+fate-vc1_sa10091-threads: REF = $(SRC_PATH)/tests/ref/fate/vc1_sa10091
+
+FATE_VC1-$(CONFIG_VC1_DEMUXER) += fate-vc1_sa20021-threads
+fate-vc1_sa20021-threads: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA20021.vc1
+fate-vc1_sa20021-threads: REF = $(SRC_PATH)/tests/ref/fate/vc1_sa20021
+
+fate-vc1_%-threads: THREADS = 4
+fate-vc1_%-threads: THREAD_TYPE = frame
+
 FATE_MICROSOFT-$(CONFIG_VC1_DECODER) += $(FATE_VC1-yes)
 fate-vc1: $(FATE_VC1-yes)
 
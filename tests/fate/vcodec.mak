@@ -95,19 +95,35 @@ FATE_VCODEC-$(call ENCDEC, JPEGLS, AVI) += jpegls
 fate-vsynth%-jpegls:             ENCOPTS = -sws_flags neighbor+full_chroma_int
 fate-vsynth%-jpegls:             DECOPTS = -sws_flags area
 
-FATE_VCODEC-$(call ENCDEC, JPEG2000, AVI) += jpeg2000 jpeg2000-97
+FATE_VCODEC-$(call ENCDEC, JPEG2000, AVI) += jpeg2000 jpeg2000-97       \
+                                             jpeg2000-thread            \
+                                             jpeg2000-97-thread
 fate-vsynth%-jpeg2000:                ENCOPTS = -qscale 7 -strict experimental -pred 1 -pix_fmt rgb24
 fate-vsynth%-jpeg2000:                DECINOPTS = -vcodec jpeg2000
 fate-vsynth%-jpeg2000-97:             ENCOPTS = -qscale 7 -strict experimental -pix_fmt rgb24
 fate-vsynth%-jpeg2000-97:             DECINOPTS = -vcodec jpeg2000
+fate-vsynth%-jpeg2000-thread:         ENCOPTS = -qscale 7 -strict experimental -pred 1 -pix_fmt rgb24
+fate-vsynth%-jpeg2000-thread:         DECINOPTS = -vcodec jpeg2000
+fate-vsynth%-jpeg2000-97-thread:      ENCOPTS = -qscale 7 -strict experimental -pix_fmt rgb24
+fate-vsynth%-jpeg2000-97-thread:      DECINOPTS = -vcodec jpeg2000
+fate-vsynth%-jpeg2000-thread fate-vsynth%-jpeg2000-97-thread: THREADS = 4
+fate-vsynth%-jpeg2000-thread fate-vsynth%-jpeg2000-97-thread: THREAD_TYPE = slice
 
 FATE_VCODEC-$(call ENCDEC, LJPEG MJPEG, AVI) += ljpeg
 fate-vsynth%-ljpeg:              ENCOPTS = -strict -1
 
-FATE_VCODEC-$(call ENCDEC, MJPEG, AVI)  += mjpeg mjpeg-422 mjpeg-444
+FATE_VCODEC-$(call ENCDEC, MJPEG, AVI)  += mjpeg mjpeg-422 mjpeg-444 \
+                                           mjpeg-thread mjpeg-frame-thread
 fate-vsynth%-mjpeg:              ENCOPTS = -qscale 9 -pix_fmt yuvj420p
 fate-vsynth%-mjpeg-422:          ENCOPTS = -qscale 9 -pix_fmt yuvj422p
 fate-vsynth%-mjpeg-444:          ENCOPTS = -qscale 9 -pix_fmt yuvj444p
+fate-vsynth%-mjpeg-thread:       ENCOPTS = -qscale 9 -pix_fmt yuvj420p \
+                                           -threads 2 -thread_type slice
+fate-vsynth%-mjpeg-thread:       THREADS = 2
+fate-vsynth%-mjpeg-thread:       THREAD_TYPE = slice
+fate-vsynth%-mjpeg-frame-thread: ENCOPTS = -qscale 9 -pix_fmt yuvj420p
+fate-vsynth%-mjpeg-frame-thread: THREADS = 4
+fate-vsynth%-mjpeg-frame-thread: THREAD_TYPE = frame
 
 FATE_VCODEC-$(call ENCDEC, MPEG1VIDEO, MPEG1VIDEO MPEGVIDEO) += mpeg1 mpeg1b
 fate-vsynth%-mpeg1:              FMT     = mpeg1video
@@ -93,8 +93,11 @@ fate-delphine-cin-video: CMD = framecrc -i $(TARGET_SAMPLES)/delphine-cin/LOGO-p
 FATE_VIDEO-$(call DEMDEC, ANM, ANM) += fate-deluxepaint-anm
 fate-deluxepaint-anm: CMD = framecrc -i $(TARGET_SAMPLES)/deluxepaint-anm/INTRO1.ANM -pix_fmt rgb24
 
-FATE_VIDEO-$(call DEMDEC, DIRAC, DIRAC) += fate-dirac
-fate-dirac: CMD = framecrc -i $(TARGET_SAMPLES)/dirac/vts.profile-main.drc
+FATE_VIDEO-$(call DEMDEC, DIRAC, DIRAC) += fate-dirac fate-dirac-thread
+fate-dirac fate-dirac-thread: CMD = framecrc -i $(TARGET_SAMPLES)/dirac/vts.profile-main.drc
+fate-dirac-thread: THREADS = 4
+fate-dirac-thread: THREAD_TYPE = slice
+fate-dirac-thread: REF = $(SRC_PATH)/tests/ref/fate/dirac
 
 FATE_TRUEMOTION1 += fate-truemotion1-15
 fate-truemotion1-15: CMD = framecrc -i $(TARGET_SAMPLES)/duck/phant2-940.duk -pix_fmt rgb24 -an
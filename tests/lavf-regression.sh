@@ -113,6 +113,7 @@ fi
 if [ -n "$do_mov" ] ; then
 mov_common_opt="-acodec pcm_alaw -vcodec mpeg4"
 do_lavf mov "" "-movflags +rtphint $mov_common_opt"
+do_lavf mov "" "-movflags +faststart+reserve_moov $mov_common_opt"
 do_lavf_timecode mov "-movflags +faststart $mov_common_opt"
 fi
 